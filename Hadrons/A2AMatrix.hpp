@@ -30,11 +30,17 @@
 #define A2A_Matrix_hpp_
 
 #include <Hadrons/Global.hpp>
+#include <Hadrons/Database.hpp>
 #include <Hadrons/TimerArray.hpp>
 #include <Grid/Eigen/unsupported/CXX11/Tensor>
+#include <mutex>
 #ifdef USE_MKL
 #include "mkl.h"
 #include "mkl_cblas.h"
+#define HADRONS_A2A_BLAS
+#elif defined(USE_CBLAS)
+#include <cblas.h>
+#define HADRONS_A2A_BLAS
 #endif
 
 #ifndef HADRONS_A2AM_NAME 
@@ -45,6 +51,24 @@
 #define HADRONS_A2AM_IO_TYPE ComplexF
 #endif
 
+#ifndef HADRONS_A2AM_TUNE_MEM
+#define HADRONS_A2AM_TUNE_MEM (4ul*1024ul*1024ul*1024ul)
+#endif
+
+// maximum size (in bytes) of the HDF5 chunk cache of a timeslice reader
+#ifndef HADRONS_A2AM_CHUNK_CACHE_MEM
+#define HADRONS_A2AM_CHUNK_CACHE_MEM (1024ul*1024ul*1024ul)
+#endif
+
+#ifndef HADRONS_A2AM_TUNE_TABLE
+#define HADRONS_A2AM_TUNE_TABLE "a2aBlockTuning"
+#endif
+
+// relative rate loss accepted by the block calibration for a larger block
+#ifndef HADRONS_A2AM_TUNE_BLOCK_TOL
+#define HADRONS_A2AM_TUNE_BLOCK_TOL 0.05
+#endif
+
 #define HADRONS_A2AM_PARALLEL_IO
 
 BEGIN_HADRONS_NAMESPACE
@@ -76,6 +100,22 @@ public:
     virtual ~A2AKernel(void) = default;
     virtual void operator()(A2AMatrixSet<T> &m, const Field *left, const Field *right,
                           const unsigned int orthogDim, double &time) = 0;
+    // one left block against several right blocks, m[r] is the result for
+    // right[r], kernels able to do it in a single pass over the left block 
+    // override this, by default the kernel is called once per right block
+    virtual void multiRight(std::vector<A2AMatrixSet<T>> &m, const Field *left,
+                            const std::vector<const Field *> &right,
+                            const unsigned int orthogDim, double &time)
+    {
+        double t;
+
+        time = 0.;
+        for (unsigned int r = 0; r < right.size(); ++r)
+        {
+            (*this)(m[r], left, right[r], orthogDim, t);
+            time += t;
+        }
+    }
     virtual double flops(const unsigned int blockSizei, const unsigned int blockSizej) = 0;
     virtual double bytes(const unsigned int blockSizei, const unsigned int blockSizej) = 0;
 };
@@ -102,18 +142,65 @@ public:
     // file allocation
     template <typename MetadataType>
     void initFile(const MetadataType &d, const unsigned int chunkSize);
-    // block I/O
-    void saveBlock(const T *data, const unsigned int i, const unsigned int j,
+    // block I/O, data in memory is converted to T if necessary
+    template <typename TMem>
+    void saveBlock(const TMem *data, const unsigned int i, const unsigned int j,
                    const unsigned int blockSizei, const unsigned int blockSizej);
-    void saveBlock(const A2AMatrixSet<T> &m, const unsigned int ext, const unsigned int str,
+    template <typename TMem>
+    void saveBlock(const A2AMatrixSet<TMem> &m, const unsigned int ext, const unsigned int str,
                    const unsigned int i, const unsigned int j);
+    // read the matrix dimensions only
+    void loadDimensions(void);
+    // load all timeslices, or only the ones selected by tSel
     template <template <class> class Vec, typename VecT>
     void load(Vec<VecT> &v, double *tRead = nullptr, GridBase *grid = nullptr);
+    template <template <class> class Vec, typename VecT>
+    void load(Vec<VecT> &v, const std::vector<bool> &tSel, double *tRead = nullptr,
+              GridBase *grid = nullptr);
+    // load a single timeslice
+    template <typename TMem>
+    void loadTimeslice(A2AMatrix<TMem> &m, const unsigned int t, 
+                       GridBase *grid = nullptr) const;
 private:
     std::string  filename_{""}, dataname_{""};
     unsigned int nt_{0}, ni_{0}, nj_{0};
 };
 
+/******************************************************************************
+ *          Random access to the timeslices of an A2A matrix file             *
+ ******************************************************************************/
+// the file and the dataset stay open between loads, and when the dataset is 
+// chunked over several timeslices the HDF5 chunk cache is sized to hold the
+// chunks of one timeslice (up to HADRONS_A2AM_CHUNK_CACHE_MEM), so that the 
+// following timeslices are read from the cache and not from the file again
+template <typename T>
+class A2AMatrixTimesliceReader
+{
+public:
+    // constructor
+    A2AMatrixTimesliceReader(const std::string filename, const std::string dataname);
+    // destructor
+    ~A2AMatrixTimesliceReader(void) = default;
+    // access
+    unsigned int getNt(void) const;
+    unsigned int getNi(void) const;
+    unsigned int getNj(void) const;
+    unsigned int getChunkNt(void) const;
+    double       getChunkCacheSize(void) const;
+    // load a single timeslice, the loads are serialised
+    template <typename TMem>
+    void load(A2AMatrix<TMem> &m, const unsigned int t);
+private:
+    std::string                 filename_;
+    unsigned int                nt_{0}, ni_{0}, nj_{0}, chunkNt_{1};
+    double                      cacheSize_{0.};
+    std::mutex                  mutex_;
+#ifdef HAVE_HDF5
+    std::unique_ptr<Hdf5Reader> reader_;
+    H5NS::DataSet               dataset_;
+#endif
+};
+
 /******************************************************************************
  *                  Wrapper for A2A matrix block computation                  *
  ******************************************************************************/
@@ -137,7 +224,12 @@ public:
                               const unsigned int nstr,
                               const unsigned int blockSize,
                               const unsigned int cacheBlockSize,
-                              TimerArray *tArray = nullptr);
+                              TimerArray *tArray = nullptr,
+                              const unsigned int nRight = 1);
+    // block sizes
+    void setBlockSize(const unsigned int blockSize, 
+                      const unsigned int cacheBlockSize);
+    bool isDirect(void) const;
     // execution
     void execute(const std::vector<Field> &left, 
                  const std::vector<Field> &right,
@@ -145,63 +237,208 @@ public:
                  const FilenameFn &ionameFn,
                  const FilenameFn &filenameFn,
                  const MetadataFn &metadataFn);
+    // execution for several right vector sets sharing the same left set,
+    // the blocks of all the right sets at the same position are computed by 
+    // a single kernel call (see A2AKernel::multiRight), nRight in the 
+    // constructor is the maximum number of right sets, the buffers are
+    // sized for it
+    void execute(const std::vector<Field> &left, 
+                 const std::vector<const std::vector<Field> *> &right,
+                 A2AKernel<T, Field> &kernel,
+                 const FilenameFn &ionameFn,
+                 const std::vector<FilenameFn> &filenameFn,
+                 const MetadataFn &metadataFn);
 private:
+    // block write
+    template <typename TMem>
+    void writeBlock(const A2AMatrixSet<TMem> &mBlock, const unsigned int i, 
+                    const unsigned int j, const unsigned int ni, const unsigned int nj,
+                    const FilenameFn &ionameFn, const FilenameFn &filenameFn,
+                    const MetadataFn &metadataFn);
     // I/O handler
-    void saveBlock(const A2AMatrixSet<TIo> &m, IoHelper &h);
+    template <typename TMem>
+    void saveBlock(const A2AMatrixSet<TMem> &m, IoHelper &h);
 private:
     TimerArray            *tArray_;
     GridBase              *grid_;
     unsigned int          orthogDim_, nt_, next_, nstr_, blockSize_, cacheBlockSize_;
+    unsigned int          nRight_;
     Vector<T>             mCache_;
     Vector<TIo>           mBuf_;
     std::vector<IoHelper> nodeIo_;
 };
 
+/******************************************************************************
+ *          Calibration of A2A matrix block and cache block sizes             *
+ ******************************************************************************/
+struct A2AMatrixBlockSize
+{
+    unsigned int block{0}, cacheBlock{0};
+};
+
+// block size resolution state of a module, kept between setup and execution
+struct A2AMatrixBlockTuneState
+{
+    bool               tuneBlock{false}, tuneCacheBlock{false}, tuned{false};
+    std::string        key;
+    A2AMatrixBlockSize size, tunedSize;
+};
+
+template <typename T, typename Field, typename TIo = T>
+class A2AMatrixBlockTuner
+{
+public:
+    // constructor
+    A2AMatrixBlockTuner(GridBase *grid,
+                        const unsigned int orthogDim,
+                        const unsigned int next,
+                        const unsigned int nstr,
+                        Database *db = nullptr,
+                        const size_t memBudget = HADRONS_A2AM_TUNE_MEM);
+    // parse a block size parameter, return true if it is 0 (auto)
+    static bool parseSize(unsigned int &size, const int param);
+    // database key from lattice geometry and vector counts
+    std::string makeKey(const std::string tag, const unsigned int ni,
+                        const unsigned int nj) const;
+    // memory footprint of block computation buffers
+    size_t memory(const A2AMatrixBlockSize &bs) const;
+    // largest block (multiple of the cache block) within the memory budget
+    unsigned int maxBlock(const unsigned int cacheBlock, const unsigned int n) const;
+    // cached result lookup
+    bool lookup(A2AMatrixBlockSize &bs, const std::string key);
+    // calibration on the actual vectors, a non-zero fixed size is not tuned:
+    // the cache block is timed first on single cache blocks, then the block
+    // on a few multiples of the cache block, computed as in the module loop
+    // (kernel on cache blocks and copy in the I/O buffer). The I/O time is 
+    // not measured and favours large blocks, so the largest block with a 
+    // rate within HADRONS_A2AM_TUNE_BLOCK_TOL of the best one is selected.
+    A2AMatrixBlockSize tune(const std::vector<Field> &left, 
+                            const std::vector<Field> &right,
+                            A2AKernel<T, Field> &kernel,
+                            const std::string key,
+                            const unsigned int fixedBlock = 0,
+                            const unsigned int fixedCacheBlock = 0);
+    // setup: sizes from the block/cacheBlock parameters, 0 (auto) ones are 
+    // taken from the database if already calibrated, otherwise they are set
+    // to the worst case for n vectors and the calibration is left for 
+    // execution
+    void resolve(A2AMatrixBlockTuneState &state, const int block,
+                 const int cacheBlock, const std::string tag,
+                 const unsigned int ni, const unsigned int nj, 
+                 const unsigned int n);
+    // execution: calibration if still needed, return true if it happened,
+    // there is no calibration on empty vector sets
+    bool resolve(A2AMatrixBlockTuneState &state, const std::vector<Field> &left,
+                 const std::vector<Field> &right, A2AKernel<T, Field> &kernel);
+private:
+    // time (in us) of the computation of one block without I/O
+    double blockTime(const std::vector<Field> &left, 
+                     const std::vector<Field> &right,
+                     A2AKernel<T, Field> &kernel, const A2AMatrixBlockSize &bs,
+                     Vector<T> &cache, Vector<TIo> &buf);
+    GridBase     *grid_;
+    Database     *db_;
+    unsigned int orthogDim_, nt_, next_, nstr_;
+    size_t       memBudget_;
+};
+
 /******************************************************************************
  *                       A2A matrix contraction kernels                       *
  ******************************************************************************/
 class A2AContraction
 {
 public:
-    // accTrMul(acc, a, b): acc += tr(a*b)
-    template <typename C, typename MatLeft, typename MatRight>
-    static inline void accTrMul(C &acc, const MatLeft &a, const MatRight &b)
+    // backend for products and dot products, BLAS is available if Hadrons is
+    // compiled with MKL (USE_MKL) or another CBLAS library (USE_CBLAS), the 
+    // default is BLAS if available and can be overridden at runtime with 
+    // setBackend or the HADRONS_A2A_BACKEND environment variable (blas|eigen)
+    enum class Backend {eigen, blas};
+public:
+    static inline bool hasBlas(void)
     {
-        const int RowMajor = Eigen::RowMajor;
-        const int ColMajor = Eigen::ColMajor;
-        if ((MatLeft::Options  == RowMajor) and
-            (MatRight::Options == ColMajor))
+#ifdef HADRONS_A2A_BLAS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static inline Backend getBackend(void)
+    {
+        return backend();
+    }
+
+    static inline void setBackend(const Backend b)
+    {
+        if ((b == Backend::blas) and !hasBlas())
+        {
+            HADRONS_ERROR(Implementation, "BLAS backend not available "
+                          "(compile with USE_MKL or USE_CBLAS)");
+        }
+        backend() = b;
+    }
+
+    static inline std::string getBackendName(const Backend b)
+    {
+        if (b == Backend::blas)
         {
-  	  thread_for(r,a.rows(),
-            {
-                C tmp;
 #ifdef USE_MKL
-                dotuRow(tmp, r, a, b);
+            return "MKL";
 #else
-                tmp = a.row(r).conjugate().dot(b.col(r));
+            return "CBLAS";
 #endif
-                thread_critical
-                {
-                    acc += tmp;
-                }
-            });
         }
         else
-	  {
-            thread_for(c,a.cols(),
+        {
+            return "Eigen";
+        }
+    }
+
+    // accTrMul(acc, a, b): acc += tr(a*b)
+    // the rows (or columns) are split in one contiguous chunk per thread, each
+    // thread accumulates in a private partial sum and the partial sums are
+    // combined pairwise, so there is no lock and the result does not depend
+    // on the thread scheduling; the row (or column) dot products are returned
+    // in double precision, so that single precision operands do not lose
+    // accuracy in the partial sums
+    template <typename C, typename MatLeft, typename MatRight>
+    static inline void accTrMul(C &acc, const MatLeft &a, const MatRight &b)
+    {
+        const int          RowMajor = Eigen::RowMajor;
+        const int          ColMajor = Eigen::ColMajor;
+        const bool         byRow    = ((MatLeft::Options  == RowMajor) and
+                                       (MatRight::Options == ColMajor));
+        const bool         blas     = (getBackend() == Backend::blas);
+        const unsigned int n        = byRow ? a.rows() : a.cols();
+        const unsigned int nThread  = std::max(1u, std::min(maxThreads(), n));
+        std::vector<C>     partial(nThread, C(0.));
+
+        thread_for(th, nThread,
+        {
+            unsigned int start = th*n/nThread, end = (th + 1)*n/nThread;
+            C            sum   = 0.;
+            ComplexD     tmp;
+
+            for (unsigned int k = start; k < end; ++k)
             {
-                C tmp;
-#ifdef USE_MKL 
-                dotuCol(tmp, c, a, b);
-#else
-                tmp = a.col(c).conjugate().dot(b.row(c));
-#endif
-                thread_critical
+                if (byRow)
                 {
-                    acc += tmp;
+                    dotuRow(tmp, k, a, b, blas);
                 }
-            });
+                else
+                {
+                    dotuCol(tmp, k, a, b, blas);
+                }
+                sum += tmp;
+            }
+            partial[th] = sum;
+        });
+        for (unsigned int stride = 1; stride < nThread; stride *= 2)
+        for (unsigned int th = 0; th + stride < nThread; th += 2*stride)
+        {
+            partial[th] += partial[th + stride];
         }
+        acc += partial[0];
     }
 
     template <typename MatLeft, typename MatRight>
@@ -212,76 +449,88 @@ public:
         return 8.*n;
     }
 
-    // mul(res, a, b): res = a*b
-#ifdef USE_MKL
-    template <template <class, int...> class Mat, int... Opts>
-    static inline void mul(Mat<ComplexD, Opts...> &res, 
-                           const Mat<ComplexD, Opts...> &a, 
-                           const Mat<ComplexD, Opts...> &b)
+    // mul(res, a, b): res = a*b, the operands can be maps (e.g. of memory-
+    // mapped matrices), the BLAS backend needs a common storage order
+    template <typename MatRes, typename MatLeft, typename MatRight>
+    static inline void mul(MatRes &res, const MatLeft &a, const MatRight &b)
     {
-        static const ComplexD one(1., 0.), zero(0., 0.);
-        const int RowMajor = Eigen::RowMajor;
-        const int ColMajor = Eigen::ColMajor;
+#ifdef HADRONS_A2A_BLAS
+        const bool sameOrder = (MatRes::IsRowMajor == MatLeft::IsRowMajor)
+                               and (MatRes::IsRowMajor == MatRight::IsRowMajor);
 
-        if ((res.rows() != a.rows()) or (res.cols() != b.cols()))
-        {
-            res.resize(a.rows(), b.cols());
-        }
-        if (Mat<ComplexD, Opts...>::Options == RowMajor)
+        if ((getBackend() == Backend::blas) and sameOrder)
         {
-            cblas_zgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, a.rows(), b.cols(),
-                        a.cols(), &one, a.data(), a.cols(), b.data(), b.cols(), &zero,
-                        res.data(), res.cols());
-        }
-        else if (Mat<ComplexD, Opts...>::Options == ColMajor)
-        {
-            cblas_zgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, a.rows(), b.cols(),
-                        a.cols(), &one, a.data(), a.rows(), b.data(), b.rows(), &zero,
-                        res.data(), res.rows());
+            if ((res.rows() != a.rows()) or (res.cols() != b.cols()))
+            {
+                res.resize(a.rows(), b.cols());
+            }
+            if (MatRes::IsRowMajor)
+            {
+                gemm(true, a.rows(), b.cols(), a.cols(), a.data(), a.cols(), 
+                     b.data(), b.cols(), res.data(), res.cols());
+            }
+            else
+            {
+                gemm(false, a.rows(), b.cols(), a.cols(), a.data(), a.rows(), 
+                     b.data(), b.rows(), res.data(), res.rows());
+            }
+
+            return;
         }
+#endif
+        res = a*b;
     }
 
-    template <template <class, int...> class Mat, int... Opts>
-    static inline void mul(Mat<ComplexF, Opts...> &res, 
-                           const Mat<ComplexF, Opts...> &a, 
-                           const Mat<ComplexF, Opts...> &b)
+    template <typename MatLeft, typename MatRight>
+    static inline double mulFlops(const MatLeft &a, const MatRight &b)
     {
-        static const ComplexF one(1., 0.), zero(0., 0.);
-        const int RowMajor = Eigen::RowMajor;
-        const int ColMajor = Eigen::ColMajor;
+        double nr = a.rows(), nc = a.cols();
 
-        if ((res.rows() != a.rows()) or (res.cols() != b.cols()))
-        {
-            res.resize(a.rows(), b.cols());
-        }
-        if (Mat<ComplexF, Opts...>::Options == RowMajor)
-        {
-            cblas_cgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, a.rows(), b.cols(),
-                        a.cols(), &one, a.data(), a.cols(), b.data(), b.cols(), &zero,
-                        res.data(), res.cols());
-        }
-        else if (Mat<ComplexF, Opts...>::Options == ColMajor)
-        {
-            cblas_cgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, a.rows(), b.cols(),
-                        a.cols(), &one, a.data(), a.rows(), b.data(), b.rows(), &zero,
-                        res.data(), res.rows());
-        }
+        return nr*nr*(6.*nc + 2.*(nc - 1.));
     }
-#else
-    template <typename Mat>
-    static inline void mul(Mat &res, const Mat &a, const Mat &b)
+private:
+    static inline Backend & backend(void)
     {
-        res = a*b;
+        static Backend b = defaultBackend();
+
+        return b;
     }
-#endif
-    template <typename Mat>
-    static inline double mulFlops(const Mat &a, const Mat &b)
+
+    static inline Backend defaultBackend(void)
     {
-        double nr = a.rows(), nc = a.cols();
+        const char *env = std::getenv("HADRONS_A2A_BACKEND");
 
-        return nr*nr*(6.*nc + 2.*(nc - 1.));
+        if (env != nullptr)
+        {
+            std::string name(env);
+
+            if (name == "eigen")
+            {
+                return Backend::eigen;
+            }
+            else if ((name == "blas") and hasBlas())
+            {
+                return Backend::blas;
+            }
+            else
+            {
+                HADRONS_ERROR(Argument, "invalid or unavailable A2A backend '"
+                              + name + "' in HADRONS_A2A_BACKEND");
+            }
+        }
+
+        return hasBlas() ? Backend::blas : Backend::eigen;
     }
-private:
+
+    static inline unsigned int maxThreads(void)
+    {
+#ifdef GRID_OMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
     template <typename C, typename MatLeft, typename MatRight>
     static inline void makeDotRowPt(C * &aPt, unsigned int &aInc, C * &bPt, 
                                     unsigned int &bInc, const unsigned int aRow, 
@@ -312,7 +561,6 @@ private:
         }
     }
 
-#ifdef USE_MKL
     template <typename C, typename MatLeft, typename MatRight>
     static inline void makeDotColPt(C * &aPt, unsigned int &aInc, C * &bPt, 
                                     unsigned int &bInc, const unsigned int aCol, 
@@ -343,47 +591,159 @@ private:
     }
 
     template <typename MatLeft, typename MatRight>
-    static inline void dotuRow(ComplexF &res, const unsigned int aRow,
-                               const MatLeft &a, const MatRight &b)
+    static inline void dotuRow(ComplexD &res, const unsigned int aRow,
+                               const MatLeft &a, const MatRight &b,
+                               const bool blas)
     {
-        const ComplexF *aPt, *bPt;
-        unsigned int   aInc, bInc;
+        typedef typename MatLeft::Scalar C;
+        const C      *aPt, *bPt;
+        unsigned int aInc, bInc;
 
         makeDotRowPt(aPt, aInc, bPt, bInc, aRow, a, b);
-        cblas_cdotu_sub(a.cols(), aPt, aInc, bPt, bInc, &res);
+#ifdef HADRONS_A2A_BLAS
+        if (blas)
+        {
+            C tmp;
+
+            dotuSub(tmp, a.cols(), aPt, aInc, bPt, bInc);
+            res = tmp;
+
+            return;
+        }
+#endif
+        res = dotu(a.cols(), aPt, aInc, bPt, bInc);
     }
 
     template <typename MatLeft, typename MatRight>
-    static inline void dotuCol(ComplexF &res, const unsigned int aCol,
-                               const MatLeft &a, const MatRight &b)
+    static inline void dotuCol(ComplexD &res, const unsigned int aCol,
+                               const MatLeft &a, const MatRight &b,
+                               const bool blas)
     {
-        const ComplexF *aPt, *bPt;
-        unsigned int   aInc, bInc;
+        typedef typename MatLeft::Scalar C;
+        const C      *aPt, *bPt;
+        unsigned int aInc, bInc;
 
         makeDotColPt(aPt, aInc, bPt, bInc, aCol, a, b);
-        cblas_cdotu_sub(a.rows(), aPt, aInc, bPt, bInc, &res);
+#ifdef HADRONS_A2A_BLAS
+        if (blas)
+        {
+            C tmp;
+
+            dotuSub(tmp, a.rows(), aPt, aInc, bPt, bInc);
+            res = tmp;
+
+            return;
+        }
+#endif
+        res = dotu(a.rows(), aPt, aInc, bPt, bInc);
     }
 
-    template <typename MatLeft, typename MatRight>
-    static inline void dotuRow(ComplexD &res, const unsigned int aRow,
-                               const MatLeft &a, const MatRight &b)
+    // unconjugated complex dot product sum_k a_k*b_k, the contiguous case
+    // uses independent accumulators for the 4 real products of each lane so
+    // that the compiler can keep them in SIMD registers (no shuffle and no 
+    // conjugation to undo as with Eigen's dot); the accumulators are in
+    // double precision for both operand precisions, in single precision the
+    // products are promoted before being added, so that a long row does not
+    // lose the low-order bits of the small terms
+    template <typename C>
+    static inline ComplexD dotu(const unsigned int n, const C *aPt, 
+                                const unsigned int aInc, const C *bPt, 
+                                const unsigned int bInc)
     {
-        const ComplexD *aPt, *bPt;
-        unsigned int   aInc, bInc;
+        typedef typename C::value_type R;
+        constexpr unsigned int nLane = 32/sizeof(R);
+        double                 rr[nLane] = {0.}, ii[nLane] = {0.};
+        double                 ri[nLane] = {0.}, ir[nLane] = {0.};
+        double                 re = 0., im = 0.;
+        unsigned int           k = 0;
 
-        makeDotRowPt(aPt, aInc, bPt, bInc, aRow, a, b);
-        cblas_zdotu_sub(a.cols(), aPt, aInc, bPt, bInc, &res);
+        if ((aInc == 1) and (bInc == 1))
+        {
+            const R *ap = reinterpret_cast<const R *>(aPt);
+            const R *bp = reinterpret_cast<const R *>(bPt);
+
+            for (; k + nLane <= n; k += nLane)
+            {
+                for (unsigned int l = 0; l < nLane; ++l)
+                {
+                    const double ar = ap[2*(k + l)], ai = ap[2*(k + l) + 1];
+                    const double br = bp[2*(k + l)], bi = bp[2*(k + l) + 1];
+
+                    rr[l] += ar*br;
+                    ii[l] += ai*bi;
+                    ri[l] += ar*bi;
+                    ir[l] += ai*br;
+                }
+            }
+            for (unsigned int l = 0; l < nLane; ++l)
+            {
+                re += rr[l] - ii[l];
+                im += ri[l] + ir[l];
+            }
+        }
+        for (; k < n; ++k)
+        {
+            const C      &x = aPt[k*aInc], &y = bPt[k*bInc];
+            const double xr = x.real(), xi = x.imag();
+            const double yr = y.real(), yi = y.imag();
+
+            re += xr*yr - xi*yi;
+            im += xr*yi + xi*yr;
+        }
+
+        return ComplexD(re, im);
     }
 
-    template <typename MatLeft, typename MatRight>
-    static inline void dotuCol(ComplexD &res, const unsigned int aCol,
-                               const MatLeft &a, const MatRight &b)
+#ifdef HADRONS_A2A_BLAS
+    // CBLAS wrappers, complex numbers are passed as pointers to their real
+    // part, which is accepted by both the void * (MKL, BLIS, recent OpenBLAS) 
+    // and the real * (older OpenBLAS) prototypes
+    template <typename C>
+    static inline const typename C::value_type * blasPt(const C *p)
     {
-        const ComplexD *aPt, *bPt;
-        unsigned int   aInc, bInc;
+        return reinterpret_cast<const typename C::value_type *>(p);
+    }
 
-        makeDotColPt(aPt, aInc, bPt, bInc, aCol, a, b);
-        cblas_zdotu_sub(a.rows(), aPt, aInc, bPt, bInc, &res);
+    template <typename C>
+    static inline typename C::value_type * blasPt(C *p)
+    {
+        return reinterpret_cast<typename C::value_type *>(p);
+    }
+
+    static inline void gemm(const bool rowMajor, const int m, const int n, 
+                            const int k, const ComplexD *a, const int lda,
+                            const ComplexD *b, const int ldb, ComplexD *c,
+                            const int ldc)
+    {
+        static const ComplexD one(1., 0.), zero(0., 0.);
+
+        cblas_zgemm(rowMajor ? CblasRowMajor : CblasColMajor, CblasNoTrans, 
+                    CblasNoTrans, m, n, k, blasPt(&one), blasPt(a), lda, 
+                    blasPt(b), ldb, blasPt(&zero), blasPt(c), ldc);
+    }
+
+    static inline void gemm(const bool rowMajor, const int m, const int n, 
+                            const int k, const ComplexF *a, const int lda,
+                            const ComplexF *b, const int ldb, ComplexF *c,
+                            const int ldc)
+    {
+        static const ComplexF one(1., 0.), zero(0., 0.);
+
+        cblas_cgemm(rowMajor ? CblasRowMajor : CblasColMajor, CblasNoTrans, 
+                    CblasNoTrans, m, n, k, blasPt(&one), blasPt(a), lda, 
+                    blasPt(b), ldb, blasPt(&zero), blasPt(c), ldc);
+    }
+
+    static inline void dotuSub(ComplexD &res, const int n, const ComplexD *aPt, 
+                               const int aInc, const ComplexD *bPt, const int bInc)
+    {
+        cblas_zdotu_sub(n, blasPt(aPt), aInc, blasPt(bPt), bInc, blasPt(&res));
+    }
+
+    static inline void dotuSub(ComplexF &res, const int n, const ComplexF *aPt, 
+                               const int aInc, const ComplexF *bPt, const int bInc)
+    {
+        cblas_cdotu_sub(n, blasPt(aPt), aInc, blasPt(bPt), bInc, blasPt(&res));
     }
 #endif
 };
@@ -462,7 +822,8 @@ void A2AMatrixIo<T>::initFile(const MetadataType &d, const unsigned int chunkSiz
 
 // block I/O ///////////////////////////////////////////////////////////////////
 template <typename T>
-void A2AMatrixIo<T>::saveBlock(const T *data, 
+template <typename TMem>
+void A2AMatrixIo<T>::saveBlock(const TMem *data, 
                                const unsigned int i, 
                                const unsigned int j,
                                const unsigned int blockSizei,
@@ -485,14 +846,15 @@ void A2AMatrixIo<T>::saveBlock(const T *data,
     dataspace   = dataset.getSpace();
     dataspace.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data(),
                               stride.data(), block.data());
-    dataset.write(data, Hdf5Type<T>::type(), memspace, dataspace);
+    dataset.write(data, Hdf5Type<TMem>::type(), memspace, dataspace);
 #else
     HADRONS_ERROR(Implementation, "all-to-all matrix I/O needs HDF5 library");
 #endif
 }
 
 template <typename T>
-void A2AMatrixIo<T>::saveBlock(const A2AMatrixSet<T> &m,
+template <typename TMem>
+void A2AMatrixIo<T>::saveBlock(const A2AMatrixSet<TMem> &m,
                                const unsigned int ext, const unsigned int str,
                                const unsigned int i, const unsigned int j)
 {
@@ -504,9 +866,97 @@ void A2AMatrixIo<T>::saveBlock(const A2AMatrixSet<T> &m,
     saveBlock(m.data() + offset, i, j, blockSizei, blockSizej);
 }
 
+template <typename T>
+void A2AMatrixIo<T>::loadDimensions(void)
+{
+#ifdef HAVE_HDF5
+    std::vector<hsize_t> hdim;
+    H5NS::DataSpace      dataspace;
+    Hdf5Reader           reader(filename_);
+
+    push(reader, dataname_);
+    auto &group = reader.getGroup();
+    dataspace = group.openDataSet(HADRONS_A2AM_NAME).getSpace();
+    hdim.resize(dataspace.getSimpleExtentNdims());
+    dataspace.getSimpleExtentDims(hdim.data());
+    if (hdim[0] != nt_)
+    {
+        HADRONS_ERROR(Size, "all-to-all time size mismatch (got "
+            + std::to_string(hdim[0]) + ", expected "
+            + std::to_string(nt_) + ")");
+    }
+    ni_ = hdim[1];
+    nj_ = hdim[2];
+#else
+    HADRONS_ERROR(Implementation, "all-to-all matrix I/O needs HDF5 library");
+#endif
+}
+
+template <typename T>
+template <typename TMem>
+void A2AMatrixIo<T>::loadTimeslice(A2AMatrix<TMem> &m, const unsigned int t,
+                                   GridBase *grid) const
+{
+#ifdef HAVE_HDF5
+    unsigned int dim[2] = {0, 0};
+    A2AMatrix<T> buf;
+
+    if (!(grid) || grid->IsBoss())
+    {
+        std::vector<hsize_t> hdim;
+        H5NS::DataSet        dataset;
+        H5NS::DataSpace      dataspace;
+        Hdf5Reader           reader(filename_);
+
+        push(reader, dataname_);
+        auto &group = reader.getGroup();
+        dataset   = group.openDataSet(HADRONS_A2AM_NAME);
+        dataspace = dataset.getSpace();
+        hdim.resize(dataspace.getSimpleExtentNdims());
+        dataspace.getSimpleExtentDims(hdim.data());
+        if (t >= hdim[0])
+        {
+            HADRONS_ERROR(Size, "timeslice " + std::to_string(t) 
+                          + " out of range (time size " + std::to_string(hdim[0]) + ")");
+        }
+        dim[0] = hdim[1];
+        dim[1] = hdim[2];
+
+        std::vector<hsize_t> count    = {1, hdim[1], hdim[2]},
+                             offset   = {static_cast<hsize_t>(t), 0, 0},
+                             stride   = {1, 1, 1},
+                             block    = {1, 1, 1},
+                             memCount = {hdim[1], hdim[2]};
+        H5NS::DataSpace      memspace(memCount.size(), memCount.data());
+
+        buf.resize(dim[0], dim[1]);
+        dataspace.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data(),
+                                  stride.data(), block.data());
+        dataset.read(buf.data(), dataset.getCompType(), memspace, dataspace);
+    }
+    if (grid)
+    {
+        grid->Broadcast(grid->BossRank(), dim, sizeof(dim));
+        buf.resize(dim[0], dim[1]);
+        grid->Broadcast(grid->BossRank(), buf.data(), sizeof(T)*buf.size());
+    }
+    m = buf.template cast<TMem>();
+#else
+    HADRONS_ERROR(Implementation, "all-to-all matrix I/O needs HDF5 library");
+#endif
+}
+
 template <typename T>
 template <template <class> class Vec, typename VecT>
 void A2AMatrixIo<T>::load(Vec<VecT> &v, double *tRead, GridBase *grid)
+{
+    load(v, std::vector<bool>(nt_, true), tRead, grid);
+}
+
+template <typename T>
+template <template <class> class Vec, typename VecT>
+void A2AMatrixIo<T>::load(Vec<VecT> &v, const std::vector<bool> &tSel, 
+                          double *tRead, GridBase *grid)
 {
 #ifdef HAVE_HDF5
     std::vector<hsize_t> hdim;
@@ -561,14 +1011,24 @@ void A2AMatrixIo<T>::load(Vec<VecT> &v, double *tRead, GridBase *grid)
                                      static_cast<hsize_t>(nj_)};
     H5NS::DataSpace      memspace(memCount.size(), memCount.data());
 
+    if (tSel.size() != nt_)
+    {
+        HADRONS_ERROR(Size, "timeslice selection size mismatch (got "
+            + std::to_string(tSel.size()) + ", expected "
+            + std::to_string(nt_) + ")");
+    }
     std::cout << "Loading timeslice";
     std::cout.flush();
-    *tRead = 0.;
+    if (tRead) *tRead = 0.;
     for (unsigned int tp1 = nt_; tp1 > 0; --tp1)
     {
         unsigned int         t      = tp1 - 1;
         std::vector<hsize_t> offset = {static_cast<hsize_t>(t), 0, 0};
         
+        if (!tSel[t])
+        {
+            continue;
+        }
         if (t % 10 == 0)
         {
             std::cout << " " << t;
@@ -598,25 +1058,173 @@ void A2AMatrixIo<T>::load(Vec<VecT> &v, double *tRead, GridBase *grid)
 }
 
 /******************************************************************************
- *               A2AMatrixBlockComputation template implementation            *
+ *              A2AMatrixTimesliceReader template implementation              *
  ******************************************************************************/
 // constructor /////////////////////////////////////////////////////////////////
-template <typename T, typename Field, typename MetadataType, typename TIo>
-A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
-::A2AMatrixBlockComputation(GridBase *grid,
-                            const unsigned int orthogDim,
-                            const unsigned int next, 
-                            const unsigned int nstr,
-                            const unsigned int blockSize, 
-                            const unsigned int cacheBlockSize,
-                            TimerArray *tArray)
-: grid_(grid), nt_(grid->GlobalDimensions()[orthogDim]), orthogDim_(orthogDim)
-, next_(next), nstr_(nstr), blockSize_(blockSize), cacheBlockSize_(cacheBlockSize)
-, tArray_(tArray)
+template <typename T>
+A2AMatrixTimesliceReader<T>::A2AMatrixTimesliceReader(const std::string filename, 
+                                                      const std::string dataname)
+: filename_(filename)
 {
-    mCache_.resize(nt_*next_*nstr_*cacheBlockSize_*cacheBlockSize_);
-    mBuf_.resize(nt_*next_*nstr_*blockSize_*blockSize_);
-}
+#ifdef HAVE_HDF5
+    std::vector<hsize_t>    hdim;
+    hsize_t                 chunk[3] = {1, 1, 1};
+    H5NS::DSetCreatPropList plist;
+    H5NS::DSetAccPropList   alist;
+
+    reader_.reset(new Hdf5Reader(filename_));
+    push(*reader_, dataname);
+    auto &group = reader_->getGroup();
+    dataset_    = group.openDataSet(HADRONS_A2AM_NAME);
+    hdim.resize(dataset_.getSpace().getSimpleExtentNdims());
+    dataset_.getSpace().getSimpleExtentDims(hdim.data());
+    if (hdim.size() != 3)
+    {
+        HADRONS_ERROR(Size, "all-to-all matrix dataset in '" + filename_ 
+                      + "' has " + std::to_string(hdim.size()) 
+                      + " dimension(s) (expected 3)");
+    }
+    nt_    = hdim[0];
+    ni_    = hdim[1];
+    nj_    = hdim[2];
+    plist  = dataset_.getCreatePlist();
+    if (plist.getLayout() == H5D_CHUNKED)
+    {
+        plist.getChunk(3, chunk);
+        chunkNt_ = chunk[0];
+    }
+    if (chunkNt_ > 1)
+    {
+        size_t nChunk     = ((ni_ + chunk[1] - 1)/chunk[1])*((nj_ + chunk[2] - 1)/chunk[2]);
+        size_t chunkBytes = chunk[0]*chunk[1]*chunk[2]*sizeof(T);
+
+        if (nChunk*chunkBytes <= HADRONS_A2AM_CHUNK_CACHE_MEM)
+        {
+            cacheSize_ = nChunk*chunkBytes;
+            alist.setChunkCache(101*nChunk, nChunk*chunkBytes, 0.75);
+            dataset_ = group.openDataSet(HADRONS_A2AM_NAME, alist);
+        }
+        else
+        {
+            LOG(Warning) << "'" << filename_ << "' is chunked by " << chunkNt_
+                         << " timeslices and the chunks of a timeslice do not "
+                         << "fit in the chunk cache, each load will read them all"
+                         << std::endl;
+        }
+    }
+#else
+    HADRONS_ERROR(Implementation, "all-to-all matrix I/O needs HDF5 library");
+#endif
+}
+
+// access //////////////////////////////////////////////////////////////////////
+template <typename T>
+unsigned int A2AMatrixTimesliceReader<T>::getNt(void) const
+{
+    return nt_;
+}
+
+template <typename T>
+unsigned int A2AMatrixTimesliceReader<T>::getNi(void) const
+{
+    return ni_;
+}
+
+template <typename T>
+unsigned int A2AMatrixTimesliceReader<T>::getNj(void) const
+{
+    return nj_;
+}
+
+template <typename T>
+unsigned int A2AMatrixTimesliceReader<T>::getChunkNt(void) const
+{
+    return chunkNt_;
+}
+
+template <typename T>
+double A2AMatrixTimesliceReader<T>::getChunkCacheSize(void) const
+{
+    return cacheSize_;
+}
+
+// timeslice I/O ///////////////////////////////////////////////////////////////
+template <typename T>
+template <typename TMem>
+void A2AMatrixTimesliceReader<T>::load(A2AMatrix<TMem> &m, const unsigned int t)
+{
+#ifdef HAVE_HDF5
+    std::lock_guard<std::mutex> guard(mutex_);
+    A2AMatrix<T>                buf(ni_, nj_);
+    std::vector<hsize_t>        count    = {1, ni_, nj_},
+                                offset   = {static_cast<hsize_t>(t), 0, 0},
+                                stride   = {1, 1, 1},
+                                block    = {1, 1, 1},
+                                memCount = {ni_, nj_};
+    H5NS::DataSpace             memspace(memCount.size(), memCount.data());
+    H5NS::DataSpace             dataspace = dataset_.getSpace();
+
+    if (t >= nt_)
+    {
+        HADRONS_ERROR(Size, "timeslice " + std::to_string(t) 
+                      + " out of range (time size " + std::to_string(nt_) + ")");
+    }
+    dataspace.selectHyperslab(H5S_SELECT_SET, count.data(), offset.data(),
+                              stride.data(), block.data());
+    dataset_.read(buf.data(), dataset_.getCompType(), memspace, dataspace);
+    m = buf.template cast<TMem>();
+#else
+    HADRONS_ERROR(Implementation, "all-to-all matrix I/O needs HDF5 library");
+#endif
+}
+
+/******************************************************************************
+ *               A2AMatrixBlockComputation template implementation            *
+ ******************************************************************************/
+// constructor /////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename MetadataType, typename TIo>
+A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
+::A2AMatrixBlockComputation(GridBase *grid,
+                            const unsigned int orthogDim,
+                            const unsigned int next, 
+                            const unsigned int nstr,
+                            const unsigned int blockSize, 
+                            const unsigned int cacheBlockSize,
+                            TimerArray *tArray,
+                            const unsigned int nRight)
+: grid_(grid), nt_(grid->GlobalDimensions()[orthogDim]), orthogDim_(orthogDim)
+, next_(next), nstr_(nstr), nRight_(std::max(nRight, 1u)), tArray_(tArray)
+{
+    setBlockSize(blockSize, cacheBlockSize);
+}
+
+// block sizes /////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename MetadataType, typename TIo>
+void A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
+::setBlockSize(const unsigned int blockSize, const unsigned int cacheBlockSize)
+{
+    blockSize_      = blockSize;
+    cacheBlockSize_ = cacheBlockSize;
+    // if a single cache block covers a whole block, the kernel writes directly
+    // in the block buffer and the precision conversion is done by the I/O
+    if (isDirect())
+    {
+        mCache_.resize(nRight_*nt_*next_*nstr_*blockSize_*blockSize_);
+        mBuf_.clear();
+        mBuf_.shrink_to_fit();
+    }
+    else
+    {
+        mCache_.resize(nRight_*nt_*next_*nstr_*cacheBlockSize_*cacheBlockSize_);
+        mBuf_.resize(nRight_*nt_*next_*nstr_*blockSize_*blockSize_);
+    }
+}
+
+template <typename T, typename Field, typename MetadataType, typename TIo>
+bool A2AMatrixBlockComputation<T, Field, MetadataType, TIo>::isDirect(void) const
+{
+    return (cacheBlockSize_ >= blockSize_);
+}
 
 #define START_TIMER(name) if (tArray_) tArray_->startTimer(name)
 #define STOP_TIMER(name)  if (tArray_) tArray_->stopTimer(name)
@@ -628,134 +1236,259 @@ void A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
 ::execute(const std::vector<Field> &left, const std::vector<Field> &right,
           A2AKernel<T, Field> &kernel, const FilenameFn &ionameFn,
           const FilenameFn &filenameFn, const MetadataFn &metadataFn)
+{
+    std::vector<const std::vector<Field> *> rightSet   = {&right};
+    std::vector<FilenameFn>                 filenameSet = {filenameFn};
+
+    execute(left, rightSet, kernel, ionameFn, filenameSet, metadataFn);
+}
+
+template <typename T, typename Field, typename MetadataType, typename TIo>
+void A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
+::execute(const std::vector<Field> &left, 
+          const std::vector<const std::vector<Field> *> &right,
+          A2AKernel<T, Field> &kernel, const FilenameFn &ionameFn,
+          const std::vector<FilenameFn> &filenameFn, 
+          const MetadataFn &metadataFn)
 {
     //////////////////////////////////////////////////////////////////////////
     // i,j   is first  loop over blockSize_ factors
     // ii,jj is second loop over cacheBlockSize_ factors for high perf contractions
     // iii,jjj are loops within cacheBlock
     // Total index is sum of these  i+ii+iii etc...
+    // r is the right vector set index, the (i, j) blocks of all the right
+    // sets are computed together, so that the left block is read once
     //////////////////////////////////////////////////////////////////////////
     int    N_i = left.size();
-    int    N_j = right.size();
+    int    N_r = right.size(), N_jmax = 0;
     double flops, bytes, t_kernel;
     double nodes = grid_->NodeCount();
     
-    int NBlock_i = N_i/blockSize_ + (((N_i % blockSize_) != 0) ? 1 : 0);
-    int NBlock_j = N_j/blockSize_ + (((N_j % blockSize_) != 0) ? 1 : 0);
+    if (filenameFn.size() != right.size())
+    {
+        HADRONS_ERROR(Size, "number of file name functions (" 
+                      + std::to_string(filenameFn.size()) 
+                      + ") does not match the number of right vector sets ("
+                      + std::to_string(N_r) + ")");
+    }
+    if (N_r > static_cast<int>(nRight_))
+    {
+        HADRONS_ERROR(Size, "number of right vector sets (" + std::to_string(N_r)
+                      + ") larger than the computation capacity (" 
+                      + std::to_string(nRight_) + ")");
+    }
+    for(int r=0;r<N_r;r++)
+    {
+        N_jmax = std::max(N_jmax, static_cast<int>(right[r]->size()));
+    }
+
+    int    NBlock_i  = N_i/blockSize_ + (((N_i % blockSize_) != 0) ? 1 : 0);
+    int    NBlock_j  = N_jmax/blockSize_ + (((N_jmax % blockSize_) != 0) ? 1 : 0);
+    int    NBlock    = NBlock_i*NBlock_j, iBlock = 0;
+    size_t blockElem = nt_*next_*nstr_*blockSize_*blockSize_;
+    size_t cacheElem = nt_*next_*nstr_*cacheBlockSize_*cacheBlockSize_;
 
     for(int i=0;i<N_i;i+=blockSize_)
-    for(int j=0;j<N_j;j+=blockSize_)
-    {
-        // Get the W and V vectors for this block^2 set of terms
-        int N_ii = MIN(N_i-i,blockSize_);
-        int N_jj = MIN(N_j-j,blockSize_);
-        A2AMatrixSet<TIo> mBlock(mBuf_.data(), next_, nstr_, nt_, N_ii, N_jj);
-
-        LOG(Message) << "All-to-all matrix block " 
-                     << j/blockSize_ + NBlock_j*i/blockSize_ + 1 
-                     << "/" << NBlock_i*NBlock_j << " [" << i <<" .. " 
-                     << i+N_ii-1 << ", " << j <<" .. " << j+N_jj-1 << "]" 
-                     << std::endl;
-        // Series of cache blocked chunks of the contractions within this block
+    for(int j=0;j<N_jmax;j+=blockSize_)
+    {
+        // right sets having a block at j, and their block sizes
+        int              N_ii = MIN(N_i-i,blockSize_), N_jjmax = 0;
+        std::vector<int> rs, N_jj;
+
+        for(int r=0;r<N_r;r++)
+        {
+            int N_j = right[r]->size();
+
+            if (j < N_j)
+            {
+                rs.push_back(r);
+                N_jj.push_back(MIN(N_j-j,blockSize_));
+                N_jjmax = std::max(N_jjmax, N_jj.back());
+            }
+        }
+
+        iBlock++;
+        LOG(Message) << "All-to-all matrix block " << iBlock << "/" << NBlock
+                     << ((N_r > 1) ? " (" + std::to_string(rs.size()) + " right set(s))" : "")
+                     << " [" << i <<" .. " << i+N_ii-1 << ", " << j <<" .. " 
+                     << j+N_jjmax-1 << "]" << std::endl;
         flops    = 0.0;
         bytes    = 0.0;
         t_kernel = 0.0;
-        for(int ii=0;ii<N_ii;ii+=cacheBlockSize_)
-        for(int jj=0;jj<N_jj;jj+=cacheBlockSize_)
+        if (isDirect())
         {
-            double t;
-            int N_iii = MIN(N_ii-ii,cacheBlockSize_);
-            int N_jjj = MIN(N_jj-jj,cacheBlockSize_);
-            A2AMatrixSet<T> mCacheBlock(mCache_.data(), next_, nstr_, nt_, N_iii, N_jjj);
+            // Single contraction written straight into the block buffers
+            double                       t;
+            std::vector<A2AMatrixSet<T>> mBlock;
+            std::vector<const Field *>   rightPt;
 
+            for(int k=0;k<rs.size();k++)
+            {
+                mBlock.emplace_back(mCache_.data() + k*blockElem, next_, nstr_, 
+                                    nt_, N_ii, N_jj[k]);
+                rightPt.push_back(&(*right[rs[k]])[j]);
+                flops += kernel.flops(N_ii, N_jj[k]);
+                bytes += kernel.bytes(N_ii, N_jj[k]);
+            }
             START_TIMER("kernel");
-            kernel(mCacheBlock, &left[i+ii], &right[j+jj], orthogDim_, t);
+            kernel.multiRight(mBlock, &left[i], rightPt, orthogDim_, t);
             STOP_TIMER("kernel");
             t_kernel += t;
-            flops    += kernel.flops(N_iii, N_jjj);
-            bytes    += kernel.bytes(N_iii, N_jjj);
-
-            START_TIMER("cache copy");
-            thread_for_collapse( 5,e,next_,{
-              for(int s =0;s< nstr_;s++)
-              for(int t =0;t< nt_;t++)
-              for(int iii=0;iii< N_iii;iii++)
-              for(int jjj=0;jjj< N_jjj;jjj++)
-              {
-                mBlock(e,s,t,ii+iii,jj+jjj) = mCacheBlock(e,s,t,iii,jjj);
-              }
-            });
-            STOP_TIMER("cache copy");
+            LOG(Message) << "Kernel perf " << flops/t_kernel/1.0e3/nodes 
+                         << " Gflop/s/node " << std::endl;
+            LOG(Message) << "Kernel perf " << bytes/t_kernel*1.0e6/1024/1024/1024/nodes 
+                         << " GB/s/node "  << std::endl;
+            for(int k=0;k<rs.size();k++)
+            {
+                writeBlock(mBlock[k], i, j, N_i, right[rs[k]]->size(), ionameFn, 
+                           filenameFn[rs[k]], metadataFn);
+            }
         }
+        else
+        {
+            // Series of cache blocked chunks of the contractions within this block
+            std::vector<A2AMatrixSet<TIo>> mBlock;
 
-        // perf
-        LOG(Message) << "Kernel perf " << flops/t_kernel/1.0e3/nodes 
-                     << " Gflop/s/node " << std::endl;
-        LOG(Message) << "Kernel perf " << bytes/t_kernel*1.0e6/1024/1024/1024/nodes 
-                     << " GB/s/node "  << std::endl;
+            for(int k=0;k<rs.size();k++)
+            {
+                mBlock.emplace_back(mBuf_.data() + k*blockElem, next_, nstr_, 
+                                    nt_, N_ii, N_jj[k]);
+            }
+            for(int ii=0;ii<N_ii;ii+=cacheBlockSize_)
+            for(int jj=0;jj<N_jjmax;jj+=cacheBlockSize_)
+            {
+                double                       t;
+                int                          N_iii = MIN(N_ii-ii,cacheBlockSize_);
+                std::vector<int>             ks, N_jjj;
+                std::vector<A2AMatrixSet<T>> mCacheBlock;
+                std::vector<const Field *>   rightPt;
 
-        // IO
-        double       blockSize, ioTime;
-        unsigned int myRank = grid_->ThisRank(), nRank  = grid_->RankCount();
-    
-        LOG(Message) << "Writing block to disk" << std::endl;
-        ioTime = -GET_TIMER("IO: write block");
-        START_TIMER("IO: total");
-        makeFileDir(filenameFn(0, 0), grid_);
-#ifdef HADRONS_A2AM_PARALLEL_IO
-        grid_->Barrier();
-        // make task list for current node
-        nodeIo_.clear();
-        for(int f = myRank; f < next_*nstr_; f += nRank)
-        {
-            IoHelper h;
+                for(int k=0;k<rs.size();k++)
+                {
+                    if (jj < N_jj[k])
+                    {
+                        ks.push_back(k);
+                        N_jjj.push_back(MIN(N_jj[k]-jj,cacheBlockSize_));
+                        mCacheBlock.emplace_back(mCache_.data() + (ks.size() - 1)*cacheElem, 
+                                                 next_, nstr_, nt_, N_iii, N_jjj.back());
+                        rightPt.push_back(&(*right[rs[k]])[j+jj]);
+                        flops += kernel.flops(N_iii, N_jjj.back());
+                        bytes += kernel.bytes(N_iii, N_jjj.back());
+                    }
+                }
+                START_TIMER("kernel");
+                kernel.multiRight(mCacheBlock, &left[i+ii], rightPt, orthogDim_, t);
+                STOP_TIMER("kernel");
+                t_kernel += t;
 
-            h.i  = i;
-            h.j  = j;
-            h.e  = f/nstr_;
-            h.s  = f % nstr_;
-            h.io = A2AMatrixIo<TIo>(filenameFn(h.e, h.s), 
-                                    ionameFn(h.e, h.s), nt_, N_i, N_j);
-            h.md = metadataFn(h.e, h.s);
-            nodeIo_.push_back(h);
-        }
-        // parallel IO
-        for (auto &h: nodeIo_)
-        {
-            saveBlock(mBlock, h);
+                // copy rows of the cache blocks with contiguous inner loop
+                // and fused precision conversion
+                START_TIMER("cache copy");
+                for(int c=0;c<ks.size();c++)
+                {
+                    int          nRow = next_*nstr_*nt_*N_iii, N_jjjc = N_jjj[c];
+                    int          N_jjc = N_jj[ks[c]];
+                    const T      *srcBase = mCacheBlock[c].data();
+                    TIo          *dstBase = mBlock[ks[c]].data();
+
+                    thread_for(r, nRow,
+                    {
+                        int      iii = r % N_iii, est = r/N_iii;
+                        const T  *src = srcBase + r*N_jjjc;
+                        TIo      *dst = dstBase + (est*N_ii + ii + iii)*N_jjc + jj;
+
+                        for(int jjj=0;jjj<N_jjjc;jjj++)
+                        {
+                            dst[jjj] = src[jjj];
+                        }
+                    });
+                }
+                STOP_TIMER("cache copy");
+            }
+            LOG(Message) << "Kernel perf " << flops/t_kernel/1.0e3/nodes 
+                         << " Gflop/s/node " << std::endl;
+            LOG(Message) << "Kernel perf " << bytes/t_kernel*1.0e6/1024/1024/1024/nodes 
+                         << " GB/s/node "  << std::endl;
+            for(int k=0;k<rs.size();k++)
+            {
+                writeBlock(mBlock[k], i, j, N_i, right[rs[k]]->size(), ionameFn, 
+                           filenameFn[rs[k]], metadataFn);
+            }
         }
-        grid_->Barrier();
+    }
+}
+
+// block write /////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename MetadataType, typename TIo>
+template <typename TMem>
+void A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
+::writeBlock(const A2AMatrixSet<TMem> &mBlock, const unsigned int i, 
+             const unsigned int j, const unsigned int ni, const unsigned int nj,
+             const FilenameFn &ionameFn, const FilenameFn &filenameFn,
+             const MetadataFn &metadataFn)
+{
+    double       blockSize, ioTime;
+    unsigned int myRank = grid_->ThisRank(), nRank  = grid_->RankCount();
+
+    LOG(Message) << "Writing block to disk" << std::endl;
+    ioTime = -GET_TIMER("IO: write block");
+    START_TIMER("IO: total");
+    makeFileDir(filenameFn(0, 0), grid_);
+#ifdef HADRONS_A2AM_PARALLEL_IO
+    grid_->Barrier();
+    // make task list for current node
+    nodeIo_.clear();
+    for(int f = myRank; f < next_*nstr_; f += nRank)
+    {
+        IoHelper h;
+
+        h.i  = i;
+        h.j  = j;
+        h.e  = f/nstr_;
+        h.s  = f % nstr_;
+        h.io = A2AMatrixIo<TIo>(filenameFn(h.e, h.s), 
+                                ionameFn(h.e, h.s), nt_, ni, nj);
+        h.md = metadataFn(h.e, h.s);
+        nodeIo_.push_back(h);
+    }
+    // parallel IO
+    for (auto &h: nodeIo_)
+    {
+        saveBlock(mBlock, h);
+    }
+    grid_->Barrier();
 #else
-        // serial IO, for testing purposes only
-        for(int e = 0; e < next_; e++)
-        for(int s = 0; s < nstr_; s++)
-        {
-            IoHelper h;
+    // serial IO, for testing purposes only
+    for(int e = 0; e < next_; e++)
+    for(int s = 0; s < nstr_; s++)
+    {
+        IoHelper h;
 
-            h.i  = i;
-            h.j  = j;
-            h.e  = e;
-            h.s  = s;
-            h.io = A2AMatrixIo<TIo>(filenameFn(h.e, h.s), 
-                                    ionameFn(h.e, h.s), nt_, N_i, N_j);
-            h.md = metadataFn(h.e, h.s);
-            saveBlock(mfBlock, h);
-        }
-#endif
-        STOP_TIMER("IO: total");
-        blockSize  = static_cast<double>(next_*nstr_*nt_*N_ii*N_jj*sizeof(TIo));
-        ioTime    += GET_TIMER("IO: write block");
-        LOG(Message) << "HDF5 IO done " << sizeString(blockSize) << " in "
-                     << ioTime  << " us (" 
-                     << blockSize/ioTime*1.0e6/1024/1024
-                     << " MB/s)" << std::endl;
+        h.i  = i;
+        h.j  = j;
+        h.e  = e;
+        h.s  = s;
+        h.io = A2AMatrixIo<TIo>(filenameFn(h.e, h.s), 
+                                ionameFn(h.e, h.s), nt_, ni, nj);
+        h.md = metadataFn(h.e, h.s);
+        saveBlock(mBlock, h);
     }
+#endif
+    STOP_TIMER("IO: total");
+    blockSize  = static_cast<double>(next_*nstr_*nt_*mBlock.dimension(3)
+                                     *mBlock.dimension(4)*sizeof(TIo));
+    ioTime    += GET_TIMER("IO: write block");
+    LOG(Message) << "HDF5 IO done " << sizeString(blockSize) << " in "
+                 << ioTime  << " us (" 
+                 << blockSize/ioTime*1.0e6/1024/1024
+                 << " MB/s)" << std::endl;
 }
 
 // I/O handler /////////////////////////////////////////////////////////////////
 template <typename T, typename Field, typename MetadataType, typename TIo>
+template <typename TMem>
 void A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
-::saveBlock(const A2AMatrixSet<TIo> &m, IoHelper &h)
+::saveBlock(const A2AMatrixSet<TMem> &m, IoHelper &h)
 {
     if ((h.i == 0) and (h.j == 0))
     {
@@ -772,6 +1505,394 @@ void A2AMatrixBlockComputation<T, Field, MetadataType, TIo>
 #undef STOP_TIMER
 #undef GET_TIMER
 
+/******************************************************************************
+ *                 A2AMatrixBlockTuner template implementation                *
+ ******************************************************************************/
+// constructor /////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+A2AMatrixBlockTuner<T, Field, TIo>::A2AMatrixBlockTuner(GridBase *grid,
+                                                        const unsigned int orthogDim,
+                                                        const unsigned int next,
+                                                        const unsigned int nstr,
+                                                        Database *db,
+                                                        const size_t memBudget)
+: grid_(grid), db_(db), orthogDim_(orthogDim)
+, nt_(grid->GlobalDimensions()[orthogDim]), next_(next), nstr_(nstr)
+, memBudget_(memBudget)
+{}
+
+// parameter parsing ///////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+bool A2AMatrixBlockTuner<T, Field, TIo>::parseSize(unsigned int &size, 
+                                                   const int param)
+{
+    if (param < 0)
+    {
+        HADRONS_ERROR(Range, "block size must be positive or 0 (auto)");
+    }
+    size = param;
+
+    return (size == 0);
+}
+
+// database key ////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+std::string A2AMatrixBlockTuner<T, Field, TIo>::makeKey(const std::string tag,
+                                                        const unsigned int ni,
+                                                        const unsigned int nj) const
+{
+    std::string key = tag + "_";
+    auto        dim = grid_->GlobalDimensions();
+    auto        mpi = grid_->ProcessorGrid();
+
+    for (unsigned int mu = 0; mu < dim.size(); ++mu)
+    {
+        key += std::to_string(dim[mu]) + ((mu == dim.size() - 1) ? "_" : "x");
+    }
+    for (unsigned int mu = 0; mu < mpi.size(); ++mu)
+    {
+        key += std::to_string(mpi[mu]) + ((mu == mpi.size() - 1) ? "_" : "x");
+    }
+    key += std::to_string(ni) + "x" + std::to_string(nj) + "_" 
+           + std::to_string(next_) + "x" + std::to_string(nstr_);
+
+    return key;
+}
+
+// memory footprint ////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+size_t A2AMatrixBlockTuner<T, Field, TIo>::memory(const A2AMatrixBlockSize &bs) const
+{
+    size_t n = nt_*next_*nstr_;
+
+    if (bs.cacheBlock >= bs.block)
+    {
+        return n*bs.block*bs.block*sizeof(T);
+    }
+    else
+    {
+        return n*(bs.block*bs.block*sizeof(TIo) + bs.cacheBlock*bs.cacheBlock*sizeof(T));
+    }
+}
+
+template <typename T, typename Field, typename TIo>
+unsigned int A2AMatrixBlockTuner<T, Field, TIo>::maxBlock(const unsigned int cacheBlock,
+                                                          const unsigned int n) const
+{
+    A2AMatrixBlockSize bs;
+
+    bs.cacheBlock = cacheBlock;
+    bs.block      = cacheBlock;
+    while ((bs.block + cacheBlock <= n) and (memory(bs) <= memBudget_))
+    {
+        bs.block += cacheBlock;
+    }
+    if ((memory(bs) > memBudget_) and (bs.block > cacheBlock))
+    {
+        bs.block -= cacheBlock;
+    }
+
+    return bs.block;
+}
+
+// cached result lookup ////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+bool A2AMatrixBlockTuner<T, Field, TIo>::lookup(A2AMatrixBlockSize &bs, 
+                                                const std::string key)
+{
+    if (db_ and db_->isConnected() and db_->tableExists(HADRONS_A2AM_TUNE_TABLE))
+    {
+        auto table = db_->getKeyValueTable(HADRONS_A2AM_TUNE_TABLE);
+        auto it    = table.find(key);
+
+        if (it != table.end())
+        {
+            auto v = strToVec<unsigned int>(it->second);
+
+            if (v.size() == 2)
+            {
+                bs.block      = v[0];
+                bs.cacheBlock = v[1];
+
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// module block size resolution ///////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+void A2AMatrixBlockTuner<T, Field, TIo>::resolve(A2AMatrixBlockTuneState &state,
+                                                 const int block,
+                                                 const int cacheBlock,
+                                                 const std::string tag,
+                                                 const unsigned int ni,
+                                                 const unsigned int nj,
+                                                 const unsigned int n)
+{
+    A2AMatrixBlockSize &bs = state.size;
+
+    state.tuneBlock      = parseSize(bs.block, block);
+    state.tuneCacheBlock = parseSize(bs.cacheBlock, cacheBlock);
+    if (state.tuneBlock or state.tuneCacheBlock)
+    {
+        std::string key = makeKey(tag + "_" 
+                                  + (state.tuneBlock ? "auto" : std::to_string(block)) + "_"
+                                  + (state.tuneCacheBlock ? "auto" : std::to_string(cacheBlock)),
+                                  ni, nj);
+
+        if (state.tuned and (key == state.key))
+        {
+            bs = state.tunedSize;
+        }
+        else if (lookup(state.tunedSize, key))
+        {
+            bs          = state.tunedSize;
+            state.tuned = true;
+        }
+        else
+        {
+            unsigned int nv = std::max(n, 1u);
+
+            if (state.tuneCacheBlock)
+            {
+                bs.cacheBlock = std::min(state.tuneBlock ? nv : bs.block, 64u);
+            }
+            if (state.tuneBlock)
+            {
+                bs.block = maxBlock(bs.cacheBlock, nv);
+            }
+            state.tuned = false;
+        }
+        state.key = key;
+    }
+}
+
+template <typename T, typename Field, typename TIo>
+bool A2AMatrixBlockTuner<T, Field, TIo>::resolve(A2AMatrixBlockTuneState &state,
+                                                 const std::vector<Field> &left,
+                                                 const std::vector<Field> &right,
+                                                 A2AKernel<T, Field> &kernel)
+{
+    if ((state.tuneBlock or state.tuneCacheBlock) and !state.tuned
+        and !left.empty() and !right.empty())
+    {
+        state.tunedSize = tune(left, right, kernel, state.key,
+                               state.tuneBlock ? 0 : state.size.block,
+                               state.tuneCacheBlock ? 0 : state.size.cacheBlock);
+        state.size      = state.tunedSize;
+        state.tuned     = true;
+
+        return true;
+    }
+
+    return false;
+}
+
+// block timing //////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+double A2AMatrixBlockTuner<T, Field, TIo>
+::blockTime(const std::vector<Field> &left, const std::vector<Field> &right,
+            A2AKernel<T, Field> &kernel, const A2AMatrixBlockSize &bs,
+            Vector<T> &cache, Vector<TIo> &buf)
+{
+    int    N_ii = std::min(static_cast<size_t>(bs.block), left.size());
+    int    N_jj = std::min(static_cast<size_t>(bs.block), right.size());
+    int    cb   = bs.cacheBlock;
+    double t, tk;
+
+    t = -usecond();
+    if (cb >= N_ii and cb >= N_jj)
+    {
+        A2AMatrixSet<T> m(cache.data(), next_, nstr_, nt_, N_ii, N_jj);
+
+        kernel(m, &left[0], &right[0], orthogDim_, tk);
+    }
+    else
+    {
+        // same cache blocking and copy as A2AMatrixBlockComputation::execute
+        for (int ii = 0; ii < N_ii; ii += cb)
+        for (int jj = 0; jj < N_jj; jj += cb)
+        {
+            int             N_iii = std::min(N_ii - ii, cb);
+            int             N_jjj = std::min(N_jj - jj, cb);
+            int             nRow  = next_*nstr_*nt_*N_iii;
+            A2AMatrixSet<T> m(cache.data(), next_, nstr_, nt_, N_iii, N_jjj);
+            const T         *srcBase = cache.data();
+            TIo             *dstBase = buf.data();
+
+            kernel(m, &left[ii], &right[jj], orthogDim_, tk);
+            thread_for(r, nRow,
+            {
+                int     iii = r % N_iii, est = r/N_iii;
+                const T *src = srcBase + r*N_jjj;
+                TIo     *dst = dstBase + (est*N_ii + ii + iii)*N_jj + jj;
+
+                for (int jjj = 0; jjj < N_jjj; jjj++)
+                {
+                    dst[jjj] = src[jjj];
+                }
+            });
+        }
+    }
+    t += usecond();
+
+    return t;
+}
+
+// calibration /////////////////////////////////////////////////////////////////
+template <typename T, typename Field, typename TIo>
+A2AMatrixBlockSize A2AMatrixBlockTuner<T, Field, TIo>
+::tune(const std::vector<Field> &left, const std::vector<Field> &right,
+       A2AKernel<T, Field> &kernel, const std::string key,
+       const unsigned int fixedBlock, const unsigned int fixedCacheBlock)
+{
+    const std::vector<unsigned int> candidate = {4, 8, 12, 16, 24, 32, 48, 64};
+    const unsigned int              nRep      = 2;
+    A2AMatrixBlockSize              best;
+    unsigned int                    n = std::min(left.size(), right.size());
+    double                          bestRate = 0.;
+
+    if (n == 0)
+    {
+        HADRONS_ERROR(Size, "cannot calibrate block sizes on empty vector sets");
+    }
+    if (fixedBlock > 0)
+    {
+        n = std::min(n, fixedBlock);
+    }
+    if (fixedCacheBlock > 0)
+    {
+        best.cacheBlock = fixedCacheBlock;
+    }
+    else
+    {
+        std::vector<unsigned int> cb;
+        Vector<T>                 buf;
+
+        for (auto c: candidate)
+        {
+            A2AMatrixBlockSize bs;
+
+            bs.cacheBlock = c;
+            bs.block      = (fixedBlock > 0) ? fixedBlock : c;
+            if ((c <= n) and (memory(bs) <= memBudget_))
+            {
+                cb.push_back(c);
+            }
+        }
+        if (cb.empty())
+        {
+            cb.push_back(std::min(n, candidate.front()));
+        }
+        buf.resize(nt_*next_*nstr_*cb.back()*cb.back());
+        LOG(Message) << "Calibrating cache block size (" << cb.size() 
+                     << " candidates)" << std::endl;
+        for (auto c: cb)
+        {
+            A2AMatrixSet<T> m(buf.data(), next_, nstr_, nt_, c, c);
+            double          t, rate;
+
+            // warm-up
+            kernel(m, &left[0], &right[0], orthogDim_, t);
+            t = -usecond();
+            for (unsigned int r = 0; r < nRep; ++r)
+            {
+                double tk;
+
+                kernel(m, &left[0], &right[0], orthogDim_, tk);
+            }
+            t   += usecond();
+            rate = nRep*c*c/t;
+            // timings can differ slightly between ranks, use the boss decision
+            grid_->Broadcast(grid_->BossRank(), &rate, sizeof(double));
+            LOG(Message) << "  cache block " << std::setw(3) << c << ": " 
+                         << rate*1.0e6 << " elements/s" << std::endl;
+            if (rate > bestRate)
+            {
+                bestRate        = rate;
+                best.cacheBlock = c;
+            }
+        }
+    }
+    if (fixedBlock > 0)
+    {
+        best.block = fixedBlock;
+    }
+    else
+    {
+        std::vector<unsigned int> bc;
+        std::vector<double>       rate;
+        unsigned int              bMax = maxBlock(best.cacheBlock, n);
+        Vector<T>                 cache(nt_*next_*nstr_*best.cacheBlock*best.cacheBlock);
+        Vector<TIo>               buf;
+        double                    tk;
+
+        for (unsigned int b = best.cacheBlock; b < bMax; b *= 2)
+        {
+            bc.push_back(b);
+        }
+        bc.push_back(bMax);
+        if (bc.size() > 1)
+        {
+            A2AMatrixSet<T> m(cache.data(), next_, nstr_, nt_, 
+                              best.cacheBlock, best.cacheBlock);
+
+            buf.resize(nt_*next_*nstr_*bMax*bMax);
+            LOG(Message) << "Calibrating block size (" << bc.size() 
+                         << " candidates)" << std::endl;
+            // warm-up
+            kernel(m, &left[0], &right[0], orthogDim_, tk);
+            for (auto b: bc)
+            {
+                A2AMatrixBlockSize bs;
+                unsigned int       nb;
+                double             r;
+
+                bs.block      = b;
+                bs.cacheBlock = best.cacheBlock;
+                nb            = std::min(b, n);
+                r             = nb*nb/blockTime(left, right, kernel, bs, cache, buf);
+                grid_->Broadcast(grid_->BossRank(), &r, sizeof(double));
+                LOG(Message) << "  block " << std::setw(4) << b << ": " 
+                             << r*1.0e6 << " elements/s" << std::endl;
+                rate.push_back(r);
+            }
+        }
+        else
+        {
+            rate.push_back(1.);
+        }
+        best.block = bc.back();
+        for (unsigned int k = bc.size(); k-- > 0;)
+        {
+            if (rate[k] >= (1. - HADRONS_A2AM_TUNE_BLOCK_TOL)
+                           *(*std::max_element(rate.begin(), rate.end())))
+            {
+                best.block = bc[k];
+                break;
+            }
+        }
+    }
+    LOG(Message) << "Selected block " << best.block << ", cache block " 
+                 << best.cacheBlock << " (buffers " << sizeString(memory(best)) 
+                 << ")" << std::endl;
+    if (db_ and db_->isConnected() and !key.empty())
+    {
+        if (!db_->tableExists(HADRONS_A2AM_TUNE_TABLE))
+        {
+            db_->createKeyValueTable(HADRONS_A2AM_TUNE_TABLE);
+        }
+        db_->insertValue(HADRONS_A2AM_TUNE_TABLE, key, 
+                         std::to_string(best.block) + " " 
+                         + std::to_string(best.cacheBlock), true);
+    }
+
+    return best;
+}
+
 END_HADRONS_NAMESPACE
 
 #endif // A2A_Matrix_hpp_
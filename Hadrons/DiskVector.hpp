@@ -29,10 +29,22 @@
 
 #include <Hadrons/Global.hpp>
 #include <Hadrons/A2AMatrix.hpp>
+#include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <ftw.h>
 #include <unistd.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 #ifdef DV_DEBUG
 #define DV_DEBUG_MSG(dv, stream) LOG(Debug) << "diskvector " << (dv) << ": " << stream << std::endl
@@ -42,233 +54,2713 @@
 
 BEGIN_HADRONS_NAMESPACE
 
+// remove a disk vector directory and its content
+inline void diskVectorRemoveDir(const std::string &dirname, GridBase *grid)
+{
+    if (!(grid) || grid->IsBoss())
+    {
+        auto unlink = [](const char *fpath, const struct stat *sb,
+                         int typeflag, struct FTW *ftwbuf) {
+            int rv = remove(fpath);
+
+            if (rv)
+            {
+                HADRONS_ERROR(Io, "cannot remove '" + std::string(fpath) + "': " + std::string(std::strerror(errno)));
+            }
+
+            return rv;
+        };
+
+        nftw(dirname.c_str(), unlink, 64, FTW_DEPTH | FTW_PHYS);
+    }
+    if (grid)   grid->Barrier();
+}
+
+// remove an incomplete persistent store (directory without manifest), the 
+// store lock is taken exclusively first, and a store locked by another job
+// (a writer still converting it, or readers) is not removed, which is an 
+// error
+inline void diskVectorRemoveStore(const std::string &dirname, GridBase *grid)
+{
+    int inUse = 0;
+
+    if (!(grid) || grid->IsBoss())
+    {
+        std::string filename = dirname + "/lock";
+        int         fd       = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+
+        if (fd < 0)
+        {
+            HADRONS_ERROR(Io, "cannot open '" + filename + "': " 
+                          + std::string(std::strerror(errno)));
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+        {
+            inUse = 1;
+        }
+        else
+        {
+            diskVectorRemoveDir(dirname, nullptr);
+        }
+        ::close(fd);
+    }
+    if (grid)
+    {
+        grid->Broadcast(grid->BossRank(), &inUse, sizeof(inUse));
+    }
+    if (inUse)
+    {
+        HADRONS_ERROR(Io, "disk vector store '" + dirname + "' has no manifest"
+                      " and is in use, it is probably being written by another job");
+    }
+    if (grid)   grid->Barrier();
+}
+
 /******************************************************************************
- *                           Abstract base class                              *
+ *                          Cache LRU bookkeeping                             *
  ******************************************************************************/
-template <typename T>
-class DiskVectorBase
+// maps vector elements to cache slots and keeps the occupied slots in least
+// recently used order with an intrusive doubly-linked list over the slots,
+// all operations are O(1)
+class DiskVectorLru
 {
 public:
-    typedef T ObjectType;
+    enum: unsigned int {none = std::numeric_limits<unsigned int>::max()};
+public:
+    DiskVectorLru(const unsigned int size, const unsigned int cacheSize)
+    : slot_(size, none), elem_(cacheSize, none), prev_(cacheSize, none)
+    , next_(cacheSize, none)
+    {
+        for (unsigned int s = cacheSize; s > 0; --s)
+        {
+            free_.push_back(s - 1);
+        }
+    }
 
-    // helper for read/write vector access
-    class RwAccessHelper
+    // cache slot of element i, none if not cached
+    unsigned int slot(const unsigned int i) const
     {
-    public:
-        RwAccessHelper(DiskVectorBase<T> &master, const unsigned int i)
-        : master_(master), cmaster_(master), i_(i) {}
+        return slot_[i];
+    }
 
-        // operator=: somebody is trying to store a vector element
-        // write to cache and tag as modified
-        T &operator=(const T &obj) const
-        {
-            auto &cache    = *master_.cachePtr_;
-            auto &modified = *master_.modifiedPtr_;
-            auto &index    = *master_.indexPtr_;
+    // element stored in slot s
+    unsigned int element(const unsigned int s) const
+    {
+        return elem_[s];
+    }
 
-            DV_DEBUG_MSG(&master_, "writing to " << i_);
-            master_.cacheInsert(i_, obj);
-            modified[index.at(i_)] = true;
-            
-            return cache[index.at(i_)];
+    bool full(void) const
+    {
+        return free_.empty();
+    }
+
+    // number of occupied slots
+    unsigned int count(void) const
+    {
+        return elem_.size() - free_.size();
+    }
+
+    // least recently used slot
+    unsigned int lru(void) const
+    {
+        return head_;
+    }
+
+    // mark slot s as most recently used
+    void touch(const unsigned int s)
+    {
+        if (s != tail_)
+        {
+            unlink(s);
+            pushBack(s);
         }
+    }
 
-        // implicit cast to const object reference and redirection
-        // to the const operator[] for read-only operations
-        operator const T&() const
+    // assign a free slot to element i as most recently used, the cache must
+    // not be full
+    unsigned int insert(const unsigned int i)
+    {
+        unsigned int s = free_.back();
+
+        free_.pop_back();
+        slot_[i] = s;
+        elem_[s] = i;
+        pushBack(s);
+
+        return s;
+    }
+
+    // release slot s
+    void erase(const unsigned int s)
+    {
+        unlink(s);
+        slot_[elem_[s]] = none;
+        elem_[s]        = none;
+        free_.push_back(s);
+    }
+
+    // iterate over the cached elements from least to most recently used
+    template <typename Function>
+    void forEach(Function fn) const
+    {
+        for (unsigned int s = head_; s != none; s = next_[s])
         {
-            return cmaster_[i_];
+            fn(elem_[s], s);
         }
-    private:
-        DiskVectorBase<T>       &master_;
-        const DiskVectorBase<T> &cmaster_;
-        const unsigned int      i_;
-    };
-public:
-    DiskVectorBase(const std::string dirname, const unsigned int size = 0,
-                   const unsigned int cacheSize = 1, const bool clean = true,
-                   GridBase *grid = nullptr);
-    DiskVectorBase(DiskVectorBase<T> &&v) = default;
-    virtual ~DiskVectorBase(void);
-    const T & operator[](const unsigned int i) const;
-    RwAccessHelper operator[](const unsigned int i);
-    double hitRatio(void) const;
-    void resetStat(void);
-    void setSize(unsigned int size_);
-    unsigned int getSize() const;
-    unsigned int dvSize;
-    void setGrid(GridBase *grid_);
-    GridBase *getGrid() const;
-    GridBase *dvGrid;
+    }
 private:
-    virtual void load(T &obj, const std::string filename) const = 0;
-    virtual void save(const std::string filename, const T &obj) const = 0;
-    virtual std::string filename(const unsigned int i) const;
-    void evict(void) const;
-    void fetch(const unsigned int i) const;
-    void cacheInsert(const unsigned int i, const T &obj) const;
-    void clean(void);
+    void unlink(const unsigned int s)
+    {
+        ((prev_[s] != none) ? next_[prev_[s]] : head_) = next_[s];
+        ((next_[s] != none) ? prev_[next_[s]] : tail_) = prev_[s];
+        prev_[s] = none;
+        next_[s] = none;
+    }
+
+    void pushBack(const unsigned int s)
+    {
+        prev_[s] = tail_;
+        next_[s] = none;
+        ((tail_ != none) ? next_[tail_] : head_) = s;
+        tail_ = s;
+    }
 private:
-    std::string                                           dirname_;
-    unsigned int                                          size_, cacheSize_;
-    double                                                access_{0.}, hit_{0.};
-    bool                                                  clean_;
-    GridBase                                              *grid_;
-    // using pointers to allow modifications when class is const
-    // semantic: const means data unmodified, but cache modification allowed
-    std::unique_ptr<std::vector<T>>                       cachePtr_;
-    std::unique_ptr<std::vector<bool>>                    modifiedPtr_;
-    std::unique_ptr<std::map<unsigned int, unsigned int>> indexPtr_;
-    std::unique_ptr<std::stack<unsigned int>>             freePtr_;
-    std::unique_ptr<std::deque<unsigned int>>             loadsPtr_;                
+    std::vector<unsigned int> slot_, elem_, prev_, next_, free_;
+    unsigned int              head_{none}, tail_{none};
 };
 
 /******************************************************************************
- *                   Specialisation for serialisable classes                  *
+ *                     Process-wide cache byte budget                         *
  ******************************************************************************/
-template <typename T, typename Reader, typename Writer>
-class SerializableDiskVector: public DiskVectorBase<T>
+// interface of the disk vector caches to the cache manager
+class DiskVectorCacheClient
 {
 public:
-    using DiskVectorBase<T>::DiskVectorBase;
-private:
-    virtual void load(T &obj, const std::string filename) const
+    virtual ~DiskVectorCacheClient(void) = default;
+    virtual std::string cacheName(void) const = 0;
+    virtual unsigned int cacheCount(void) const = 0;
+    virtual double cacheBytes(void) const = 0;
+    virtual double hitCount(void) const = 0;
+    virtual double missCount(void) const = 0;
+    // access stamp of the least recently used element which can be evicted,
+    // false if there is none
+    virtual bool cacheLruStamp(uint64_t &stamp) const = 0;
+    virtual void cacheEvictLru(void) const = 0;
+};
+
+// when a budget is set, the disk vector caches are evicted in global least
+// recently used order until the memory they use fits in the budget, their 
+// cache size becomes an upper bound on the number of elements. The two most
+// recently used elements of each vector are never evicted, references to them
+// stay valid. The budget is enforced on cache misses and writes from the 
+// thread using the vectors, background loads are accounted when accessed.
+// Vectors distributed over a grid (boss or sharded mode) are counted in the
+// total but never evicted by the manager, their processes must keep the same
+// cache content, they are bounded by their own cache size only.
+class DiskVectorCacheManager
+{
+    SINGLETON_DEFCTOR(DiskVectorCacheManager);
+public:
+    // budget in bytes, 0 disables the manager
+    void setBudget(const double bytes)
     {
-        Reader reader(filename);
+        budget_ = bytes;
+        reserve();
+    }
 
-        read(reader, basename(filename), obj);
+    double getBudget(void) const
+    {
+        return budget_;
     }
 
-    virtual void save(const std::string filename, const T &obj) const
+    bool enabled(void) const
     {
-        Writer writer(filename);
+        return (budget_ > 0.);
+    }
 
-        write(writer, basename(filename), obj);
+    uint64_t tick(void)
+    {
+        return ++clock_;
+    }
+
+    void registerClient(DiskVectorCacheClient *client)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        client_.push_back(client);
+    }
+
+    void unregisterClient(DiskVectorCacheClient *client)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        client_.erase(std::remove(client_.begin(), client_.end(), client), 
+                      client_.end());
+    }
+
+    double bytes(void) const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        double                      total = 0.;
+
+        for (auto c: client_)
+        {
+            total += c->cacheBytes();
+        }
+
+        return total;
+    }
+
+    // evict until the budget is met or nothing can be evicted, O(number of
+    // vectors) per eviction
+    void reserve(void)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        while (true)
+        {
+            DiskVectorCacheClient *victim = nullptr;
+            uint64_t              oldest  = std::numeric_limits<uint64_t>::max(), stamp;
+            double                total   = 0.;
+
+            for (auto c: client_)
+            {
+                total += c->cacheBytes();
+                if (c->cacheLruStamp(stamp) and (stamp < oldest))
+                {
+                    oldest = stamp;
+                    victim = c;
+                }
+            }
+            if ((total <= budget_) or !victim)
+            {
+                break;
+            }
+            victim->cacheEvictLru();
+        }
+    }
+
+    void printStat(std::ostream &out) const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        double                      total = 0.;
+
+        for (auto c: client_)
+        {
+            double hit = c->hitCount(), miss = c->missCount();
+
+            out << c->cacheName() << ": " << c->cacheCount() << " element(s), " 
+                << sizeString(c->cacheBytes()) << ", " << hit << " hit(s), " 
+                << miss << " miss(es), hit ratio " 
+                << ((hit + miss > 0.) ? hit/(hit + miss) : 0.) << std::endl;
+            total += c->cacheBytes();
+        }
+        out << "total " << sizeString(total) << " / budget " 
+            << (enabled() ? sizeString(budget_) : std::string("none")) << std::endl;
     }
+private:
+    mutable std::mutex                   mutex_;
+    std::vector<DiskVectorCacheClient *> client_;
+    std::atomic<double>                  budget_{0.};
+    std::atomic<uint64_t>                clock_{0};
 };
 
 /******************************************************************************
- *                      Specialisation for Eigen matrices                     *
+ *                          Element storage codecs                            *
  ******************************************************************************/
-template <typename T>
-using EigenDiskVectorMat = A2AMatrix<T>;
+// encoded block size in bytes, a multiple of the word size
+#ifndef HADRONS_DV_CODEC_BLOCK
+#define HADRONS_DV_CODEC_BLOCK (1024*1024)
+#endif
 
-template <typename T>
-class EigenDiskVector: public DiskVectorBase<EigenDiskVectorMat<T>>
+// a codec transforms the data of a binary disk vector element, seen as an
+// array of floating-point words of wordSize bytes. The data are split in 
+// blocks encoded and decoded independently by several threads. The encoded
+// stream is made of a header (codec identifier, word size, decoded size and
+// the encoded size of each block) followed by the blocks.
+class DiskVectorCodec
 {
 public:
-    using DiskVectorBase<EigenDiskVectorMat<T>>::DiskVectorBase;
-    typedef EigenDiskVectorMat<T> Matrix;
+    virtual ~DiskVectorCodec(void) = default;
+    // identifier stored in the encoded stream
+    virtual uint32_t id(void) const = 0;
+    virtual std::string name(void) const = 0;
+    virtual bool lossless(void) const = 0;
+
+    void encode(std::vector<char> &out, const void *in, const size_t size,
+                const unsigned int wordSize) const
+    {
+        const char               *data   = static_cast<const char *>(in);
+        const size_t             nBlock  = (size + HADRONS_DV_CODEC_BLOCK - 1)/HADRONS_DV_CODEC_BLOCK;
+        std::vector<std::vector<char>> block(nBlock);
+        std::vector<std::string> error(nBlock);
+        std::vector<uint64_t>    header = {id(), wordSize, size, nBlock};
+        std::vector<size_t>      offset(nBlock + 1);
+
+        checkWordSize(size, wordSize);
+        thread_for(b, nBlock,
+        {
+            size_t start = b*HADRONS_DV_CODEC_BLOCK;
+
+            try
+            {
+                encodeBlock(block[b], data + start, 
+                            std::min<size_t>(HADRONS_DV_CODEC_BLOCK, size - start), 
+                            wordSize);
+            }
+            catch (std::exception &e)
+            {
+                error[b] = e.what();
+            }
+        });
+        raise(error);
+        offset[0] = (header.size() + nBlock)*sizeof(uint64_t);
+        for (size_t b = 0; b < nBlock; ++b)
+        {
+            header.push_back(block[b].size());
+            offset[b + 1] = offset[b] + block[b].size();
+        }
+        out.resize(offset[nBlock]);
+        std::memcpy(out.data(), header.data(), offset[0]);
+        thread_for(b, nBlock,
+        {
+            std::memcpy(out.data() + offset[b], block[b].data(), block[b].size());
+        });
+    }
+
+    void decode(void *out, const size_t size, const std::vector<char> &in,
+                const unsigned int wordSize) const
+    {
+        char                     *data = static_cast<char *>(out);
+        uint64_t                 header[4];
+        size_t                   nBlock;
+        std::vector<size_t>      offset;
+        std::vector<std::string> error;
+
+        if (in.size() < sizeof(header))
+        {
+            HADRONS_ERROR(Io, "truncated encoded disk vector element");
+        }
+        std::memcpy(header, in.data(), sizeof(header));
+        if (header[0] != id())
+        {
+            HADRONS_ERROR(Io, "disk vector element was not encoded with the '"
+                          + name() + "' codec");
+        }
+        nBlock = (size + HADRONS_DV_CODEC_BLOCK - 1)/HADRONS_DV_CODEC_BLOCK;
+        if ((header[1] != wordSize) or (header[2] != size) or (header[3] != nBlock)
+            or (in.size() < (4 + nBlock)*sizeof(uint64_t)))
+        {
+            HADRONS_ERROR(Io, "encoded disk vector element does not match its dimensions");
+        }
+        offset.resize(nBlock + 1);
+        offset[0] = (4 + nBlock)*sizeof(uint64_t);
+        for (size_t b = 0; b < nBlock; ++b)
+        {
+            uint64_t blockSize;
+
+            std::memcpy(&blockSize, in.data() + (4 + b)*sizeof(uint64_t), sizeof(uint64_t));
+            offset[b + 1] = offset[b] + blockSize;
+        }
+        if (offset[nBlock] != in.size())
+        {
+            HADRONS_ERROR(Io, "truncated encoded disk vector element");
+        }
+        error.resize(nBlock);
+        thread_for(b, nBlock,
+        {
+            size_t start = b*HADRONS_DV_CODEC_BLOCK;
+
+            try
+            {
+                decodeBlock(data + start, 
+                            std::min<size_t>(HADRONS_DV_CODEC_BLOCK, size - start),
+                            in.data() + offset[b], offset[b + 1] - offset[b], wordSize);
+            }
+            catch (std::exception &e)
+            {
+                error[b] = e.what();
+            }
+        });
+        raise(error);
+    }
+protected:
+    // out is resized to the encoded size of the block
+    virtual void encodeBlock(std::vector<char> &out, const char *in, 
+                             const size_t size, const unsigned int wordSize) const = 0;
+    // out holds the size decoded bytes of the block
+    virtual void decodeBlock(char *out, const size_t size, const char *in,
+                             const size_t inSize, const unsigned int wordSize) const = 0;
+
+    // byte k of the words stored contiguously for k = first..wordSize - 1,
+    // which groups the exponent and the leading mantissa bytes
+    static void shuffle(char *out, const char *in, const size_t size, 
+                        const unsigned int wordSize, const unsigned int first = 0)
+    {
+        const size_t n = size/wordSize;
+
+        for (unsigned int k = first; k < wordSize; ++k)
+        for (size_t j = 0; j < n; ++j)
+        {
+            out[(k - first)*n + j] = in[j*wordSize + k];
+        }
+    }
+
+    // inverse of shuffle, the bytes k < first are set to 0
+    static void unshuffle(char *out, const char *in, const size_t size, 
+                          const unsigned int wordSize, const unsigned int first = 0)
+    {
+        const size_t n = size/wordSize;
+
+        for (size_t j = 0; j < n; ++j)
+        {
+            for (unsigned int k = 0; k < first; ++k)
+            {
+                out[j*wordSize + k] = 0;
+            }
+            for (unsigned int k = first; k < wordSize; ++k)
+            {
+                out[j*wordSize + k] = in[(k - first)*n + j];
+            }
+        }
+    }
+private:
+    void checkWordSize(const size_t size, const unsigned int wordSize) const
+    {
+        if ((wordSize == 0) or (size % wordSize) or (HADRONS_DV_CODEC_BLOCK % wordSize))
+        {
+            HADRONS_ERROR(Size, "'" + name() + "' codec: data size " 
+                          + std::to_string(size) + " is not a multiple of the word size " 
+                          + std::to_string(wordSize));
+        }
+    }
+
+    // exceptions cannot leave the threaded loops
+    static void raise(const std::vector<std::string> &error)
+    {
+        for (auto &e: error)
+        {
+            if (!e.empty())
+            {
+                HADRONS_ERROR(Io, e);
+            }
+        }
+    }
+};
+
+// precision truncation (lossy): the mantissa of each word is rounded to 
+// mantissaBits bits and the low bytes which are then zero are not stored,
+// e.g. 28 or 20 bits for 8-byte words store 5 or 4 bytes per word
+class DiskVectorTruncateCodec: public DiskVectorCodec
+{
 public:
-    T operator()(const unsigned int i, const Eigen::Index j,
-                 const Eigen::Index k) const
+    DiskVectorTruncateCodec(const unsigned int mantissaBits)
+    : bits_(mantissaBits)
+    {}
+
+    virtual uint32_t id(void) const
     {
-        return (*this)[i](j, k);
+        return 0x100 + bits_;
     }
-    std::vector<int> dimensions() const
+
+    virtual std::string name(void) const
     {
-        std::vector<int> dims(3);
-        dims[0] = (*this).getSize();
+        return "truncate:" + std::to_string(bits_);
+    }
+
+    virtual bool lossless(void) const
+    {
+        return false;
+    }
+protected:
+    virtual void encodeBlock(std::vector<char> &out, const char *in,
+                             const size_t size, const unsigned int wordSize) const
+    {
+        std::vector<char> buf(in, in + size);
+        unsigned int      drop;
+
+        if (wordSize == sizeof(double))
+        {
+            drop = roundMantissa<uint64_t, 52>(buf.data(), size);
+        }
+        else if (wordSize == sizeof(float))
+        {
+            drop = roundMantissa<uint32_t, 23>(buf.data(), size);
+        }
+        else
+        {
+            HADRONS_ERROR(Size, "'" + name() + "' codec needs 4 or 8-byte words");
+        }
+        out.resize(size/wordSize*(wordSize - drop));
+        shuffle(out.data(), buf.data(), size, wordSize, drop);
+    }
+
+    virtual void decodeBlock(char *out, const size_t size, const char *in,
+                             const size_t inSize, const unsigned int wordSize) const
+    {
+        unsigned int drop = dropBytes(wordSize);
+
+        if (inSize != size/wordSize*(wordSize - drop))
+        {
+            HADRONS_ERROR(Io, "'" + name() + "' codec: invalid block size");
+        }
+        unshuffle(out, in, size, wordSize, drop);
+    }
+private:
+    unsigned int dropBytes(const unsigned int wordSize) const
+    {
+        unsigned int mantissa = (wordSize == sizeof(double)) ? 52 : 23;
+
+        return (bits_ < mantissa) ? (mantissa - bits_)/8 : 0;
+    }
+
+    // round to nearest on the magnitude, infinities and NaNs are unchanged,
+    // returns the number of low bytes which are zero
+    template <typename Word, unsigned int mantissa>
+    unsigned int roundMantissa(char *data, const size_t size) const
+    {
+        const unsigned int drop    = (bits_ < mantissa) ? mantissa - bits_ : 0;
+        const Word         expMask = ((~Word(0)) >> 1) & ~((Word(1) << mantissa) - 1);
+        Word               w;
+
+        if (drop > 0)
+        {
+            for (size_t j = 0; j < size; j += sizeof(Word))
+            {
+                std::memcpy(&w, data + j, sizeof(Word));
+                if ((w & expMask) != expMask)
+                {
+                    w = (w + (Word(1) << (drop - 1))) & ~((Word(1) << drop) - 1);
+                    std::memcpy(data + j, &w, sizeof(Word));
+                }
+            }
+        }
+
+        return drop/8;
+    }
+private:
+    unsigned int bits_;
+};
+
+#ifdef USE_ZSTD
+// fast lossless compression with zstd, after grouping the bytes of the words
+class DiskVectorZstdCodec: public DiskVectorCodec
+{
+public:
+    DiskVectorZstdCodec(const int level = 1)
+    : level_(level)
+    {}
+
+    virtual uint32_t id(void) const
+    {
+        return 0x200;
+    }
+
+    virtual std::string name(void) const
+    {
+        return "zstd:" + std::to_string(level_);
+    }
+
+    virtual bool lossless(void) const
+    {
+        return true;
+    }
+protected:
+    virtual void encodeBlock(std::vector<char> &out, const char *in,
+                             const size_t size, const unsigned int wordSize) const
+    {
+        std::vector<char> buf(size);
+        size_t            n;
+
+        shuffle(buf.data(), in, size, wordSize);
+        out.resize(ZSTD_compressBound(size));
+        n = ZSTD_compress(out.data(), out.size(), buf.data(), size, level_);
+        if (ZSTD_isError(n))
+        {
+            HADRONS_ERROR(Io, "zstd compression failed: " + std::string(ZSTD_getErrorName(n)));
+        }
+        out.resize(n);
+    }
+
+    virtual void decodeBlock(char *out, const size_t size, const char *in,
+                             const size_t inSize, const unsigned int wordSize) const
+    {
+        std::vector<char> buf(size);
+        size_t            n;
+
+        n = ZSTD_decompress(buf.data(), size, in, inSize);
+        if (ZSTD_isError(n) or (n != size))
+        {
+            HADRONS_ERROR(Io, "zstd decompression failed: " 
+                          + std::string(ZSTD_isError(n) ? ZSTD_getErrorName(n) : "wrong size"));
+        }
+        unshuffle(out, buf.data(), size, wordSize);
+    }
+private:
+    int level_;
+};
+#endif
+
+// codec from its name: "none" (or empty), "zstd[:level]" or 
+// "truncate:<mantissa bits>"
+inline std::shared_ptr<DiskVectorCodec> makeDiskVectorCodec(const std::string &spec)
+{
+    std::string name = spec.substr(0, spec.find(':'));
+    std::string arg  = (spec.find(':') != std::string::npos) ? spec.substr(spec.find(':') + 1) : "";
+
+    if (name.empty() or (name == "none"))
+    {
+        return nullptr;
+    }
+    else if (name == "zstd")
+    {
+#ifdef USE_ZSTD
+        return std::make_shared<DiskVectorZstdCodec>(arg.empty() ? 1 : std::stoi(arg));
+#else
+        HADRONS_ERROR(Implementation, "Hadrons was compiled without zstd (use --with-zstd)");
+#endif
+    }
+    else if ((name == "truncate") and !arg.empty())
+    {
+        return std::make_shared<DiskVectorTruncateCodec>(std::stoi(arg));
+    }
+    else
+    {
+        HADRONS_ERROR(Argument, "unknown disk vector codec '" + spec 
+                      + "' (expected none, zstd[:level] or truncate:<bits>)");
+    }
+}
+
+/******************************************************************************
+ *                           Abstract base class                              *
+ ******************************************************************************/
+// create a new store, or reopen a persistent one
+enum class DiskVectorMode {create, read, readWrite};
+
+template <typename T>
+class DiskVectorBase: public DiskVectorCacheClient
+{
+public:
+    typedef T ObjectType;
+
+    // helper for read/write vector access
+    class RwAccessHelper
+    {
+    public:
+        RwAccessHelper(DiskVectorBase<T> &master, const unsigned int i)
+        : master_(master), cmaster_(master), i_(i) {}
+
+        // operator=: somebody is trying to store a vector element
+        // write to cache and tag as modified
+        T &operator=(const T &obj) const
+        {
+            auto         &cache    = *master_.cachePtr_;
+            unsigned int s;
+
+            DV_DEBUG_MSG(&master_, "writing to " << i_);
+            s = master_.cacheInsert(i_, obj);
+            
+            return cache[s];
+        }
+
+        // implicit cast to const object reference and redirection
+        // to the const operator[] for read-only operations
+        operator const T&() const
+        {
+            return cmaster_[i_];
+        }
+    private:
+        DiskVectorBase<T>       &master_;
+        const DiskVectorBase<T> &cmaster_;
+        const unsigned int      i_;
+    };
+public:
+    // sharded: the elements are distributed over the processes of the grid,
+    // element i is stored by process i % nProc in dirname/rank_<rank>, which
+    // can be on node-local storage. Sharding spreads the storage and the 
+    // writes, which need no communication, it does NOT make reads local:
+    // every cache miss is a collective operation, the owner reads the 
+    // element and broadcasts it to all the processes of the grid, there is
+    // no point-to-point transfer to the requesting process only. All the 
+    // processes must therefore access the elements in the same order, with
+    // the same cache size, so that they miss on the same elements, as in the 
+    // SPMD loops of the contraction modules. Out-of-step misses raise an 
+    // error (see EigenDiskVector::loadElement).
+    // persistent: with clean = false the directory is kept, and a manifest 
+    // (element type, size, and dimensions and checksum of each element) is
+    // written on flush() and close(). The store can then be reopened in read
+    // or readWrite mode, with the size read from the manifest if 0. Writers
+    // lock the store exclusively and readers shared, so several jobs can 
+    // read it at once.
+    DiskVectorBase(const std::string dirname, const unsigned int size = 0,
+                   const unsigned int cacheSize = 1, const bool clean = true,
+                   GridBase *grid = nullptr, const bool sharded = false,
+                   const DiskVectorMode mode = DiskVectorMode::create);
+    DiskVectorBase(DiskVectorBase<T> &&v);
+    virtual ~DiskVectorBase(void);
+    const T & operator[](const unsigned int i) const;
+    RwAccessHelper operator[](const unsigned int i);
+    double hitRatio(void) const;
+    double prefetchHitRatio(void) const;
+    void resetStat(void);
+    // cache manager interface
+    virtual std::string cacheName(void) const;
+    virtual unsigned int cacheCount(void) const;
+    virtual double cacheBytes(void) const;
+    virtual double hitCount(void) const;
+    virtual double missCount(void) const;
+    virtual bool cacheLruStamp(uint64_t &stamp) const;
+    virtual void cacheEvictLru(void) const;
+    // prefetching: prefetch(i) loads element i ahead of its access, in the
+    // background if the loader thread is enabled and synchronously otherwise;
+    // the loader also detects strided access patterns (modulo the vector size)
+    // and loads the next depth elements of the pattern ahead of time. It never
+    // evicts one of the last cacheSize - depth - 1 elements accessed, so the
+    // references to them stay valid. Derived classes must disable the loader
+    // in their destructor, as it calls their load functions.
+    void prefetch(const unsigned int i) const;
+    void enablePrefetch(const unsigned int depth = 2);
+    void disablePrefetch(void);
+    bool prefetchEnabled(void) const;
+    // write-behind: modified elements evicted from the cache are queued and
+    // saved by a background thread, the writer only blocks when more than 
+    // queueSize elements are waiting. Reads of a queued element are served
+    // from the queue. flush() saves all the modified elements, queued or 
+    // cached, and raises the errors of background writes. Derived classes 
+    // must disable it in their destructor, as it calls their save functions.
+    void enableWriteBehind(const unsigned int queueSize = 2);
+    void disableWriteBehind(void);
+    bool writeBehindEnabled(void) const;
+    void flush(void);
+    // disables prefetching and write-behind, and flushes persistent stores,
+    // derived classes must call it in their destructor
+    void close(void);
+    bool isSharded(void) const;
+    bool isPersistent(void) const;
+    DiskVectorMode getMode(void) const;
+    // codec of the stored elements, none by default, it must be set before
+    // the first element is saved, reopened stores use the one of their 
+    // manifest
+    void setCodec(std::shared_ptr<DiskVectorCodec> codec);
+    std::shared_ptr<DiskVectorCodec> getCodec(void) const;
+    void setSize(unsigned int size_);
+    unsigned int getSize() const;
+    unsigned int dvSize;
+    void setGrid(GridBase *grid_);
+    GridBase *getGrid() const;
+    GridBase *dvGrid;
+protected:
+    virtual std::string filename(const unsigned int i) const;
+    virtual void loadElement(T &obj, const unsigned int i) const;
+    virtual void saveElement(const unsigned int i, const T &obj) const;
+    // memory used by a cached element, for the cache manager
+    virtual double elementBytes(const T &obj) const;
+    int owner(const unsigned int i) const;
+    // manifest entry of element i, set when it is saved
+    void setElementInfo(const unsigned int i, const std::string &info) const;
+    // element formats which can be encoded by a codec
+    virtual bool codecSupported(void) const;
+private:
+    virtual void load(T &obj, const std::string filename) const = 0;
+    virtual void save(const std::string filename, const T &obj) const = 0;
+    std::unique_lock<std::mutex> lockCache(void) const;
+    void evict(std::unique_lock<std::mutex> &lock) const;
+    void evictSlot(const unsigned int s) const;
+    unsigned int evictableLru(void) const;
+    bool updateUsage(const unsigned int s) const;
+    unsigned int fetch(const unsigned int i, std::unique_lock<std::mutex> &lock) const;
+    unsigned int cacheInsert(const unsigned int i, const T &obj) const;
+    void predict(const unsigned int i, std::unique_lock<std::mutex> &lock) const;
+    void schedule(const unsigned int i, std::unique_lock<std::mutex> &lock) const;
+    void loaderLoop(void) const;
+    void readElement(T &obj, const unsigned int i) const;
+    void enqueue(const unsigned int i, T &obj) const;
+    void waitWriter(std::unique_lock<std::mutex> &lock) const;
+    void writerLoop(void) const;
+    void debugCache(void) const;
+    bool manifestRank(void) const;
+    void openStore(void);
+    unsigned int readManifest(void);
+    void writeManifest(void) const;
+    void lockStore(void);
+    void unlockStore(void);
+    void clean(void);
+private:
+    // background loader, all the fields are protected by the mutex, loading 
+    // and prefetched are indexed by cache slot
+    struct Loader
+    {
+        std::mutex                                        mutex;
+        std::condition_variable                           wake, done;
+        std::thread                                       thread;
+        std::deque<std::pair<unsigned int, unsigned int>> queue;
+        std::vector<bool>                                 loading, prefetched;
+        std::deque<unsigned int>                          history;
+        unsigned int                                      depth{0}, nPrefetched{0};
+        bool                                              async{false}, stop{false};
+    };
+    // background writer, all the fields are protected by the mutex, the 
+    // front of the queue is being saved, spare recycles the buffers of the 
+    // saved elements
+    struct Writer
+    {
+        std::mutex                                        mutex;
+        std::condition_variable                           wake, done;
+        std::thread                                       thread;
+        std::deque<std::pair<unsigned int, T>>            queue;
+        std::vector<T>                                    spare;
+        std::exception_ptr                                error;
+        unsigned int                                      queueSize{0};
+        bool                                              active{false}, stop{false};
+    };
+    // cache manager bookkeeping, indexed by cache slot
+    struct Usage
+    {
+        std::vector<uint64_t>                             stamp;
+        std::vector<double>                               bytes;
+        double                                            total{0.};
+    };
+    // persistent store manifest, present and info are indexed by element and
+    // protected by the mutex (the writer thread saves elements)
+    struct Manifest
+    {
+        std::mutex                                        mutex;
+        std::vector<bool>                                 present;
+        std::vector<std::string>                          info;
+        int                                               lockFd{-1};
+    };
+private:
+    std::string                                           dirname_;
+    unsigned int                                          size_, cacheSize_;
+    double                                                access_{0.}, hit_{0.};
+    double                                                prefetchHit_{0.};
+    bool                                                  clean_, sharded_;
+    bool                                                  persistent_{false};
+    DiskVectorMode                                        mode_;
+    GridBase                                              *grid_;
+    // using pointers to allow modifications when class is const
+    // semantic: const means data unmodified, but cache modification allowed
+    std::unique_ptr<std::vector<T>>                       cachePtr_;
+    std::unique_ptr<std::vector<bool>>                    modifiedPtr_;
+    std::unique_ptr<DiskVectorLru>                        lruPtr_;
+    std::unique_ptr<Loader>                               loaderPtr_;
+    std::unique_ptr<Writer>                               writerPtr_;
+    std::unique_ptr<Usage>                                usagePtr_;
+    std::unique_ptr<Manifest>                             manifestPtr_;
+    std::shared_ptr<DiskVectorCodec>                      codec_;
+};
+
+/******************************************************************************
+ *                   Specialisation for serialisable classes                  *
+ ******************************************************************************/
+template <typename T, typename Reader, typename Writer>
+class SerializableDiskVector: public DiskVectorBase<T>
+{
+public:
+    using DiskVectorBase<T>::DiskVectorBase;
+    SerializableDiskVector(SerializableDiskVector<T, Reader, Writer> &&v) = default;
+    virtual ~SerializableDiskVector(void)
+    {
+        this->close();
+    }
+private:
+    virtual void load(T &obj, const std::string filename) const
+    {
+        Reader reader(filename);
+
+        read(reader, basename(filename), obj);
+    }
+
+    virtual void save(const std::string filename, const T &obj) const
+    {
+        Writer writer(filename);
+
+        write(writer, basename(filename), obj);
+    }
+};
+
+/******************************************************************************
+ *                      Specialisation for Eigen matrices                     *
+ ******************************************************************************/
+// payload chunk size of the element files, each chunk has its own checksum
+#ifndef HADRONS_DV_CRC_CHUNK
+#define HADRONS_DV_CRC_CHUNK (4*1024*1024)
+#endif
+
+template <typename T>
+using EigenDiskVectorMat = A2AMatrix<T>;
+
+template <typename T>
+class EigenDiskVector: public DiskVectorBase<EigenDiskVectorMat<T>>
+{
+public:
+    using DiskVectorBase<EigenDiskVectorMat<T>>::DiskVectorBase;
+    typedef EigenDiskVectorMat<T> Matrix;
+    typedef typename Eigen::NumTraits<T>::Real Real;
+public:
+    EigenDiskVector(EigenDiskVector<T> &&v) = default;
+    virtual ~EigenDiskVector(void)
+    {
+        this->close();
+    }
+
+    T operator()(const unsigned int i, const Eigen::Index j,
+                 const Eigen::Index k) const
+    {
+        return (*this)[i](j, k);
+    }
+    std::vector<int> dimensions() const
+    {
+        std::vector<int> dims(3);
+        dims[0] = (*this).getSize();
         dims[1] = (*this)[0].rows();
         dims[2] = (*this)[0].cols();
         return dims;
     }
-private:
-    virtual void load(EigenDiskVectorMat<T> &obj, const std::string filename) const
+private:
+    virtual void load(EigenDiskVectorMat<T> &obj, const std::string filename) const
+    {
+        GridBase *loadGrid;
+        loadGrid = (*this).getGrid();
+        if (!(loadGrid) || loadGrid->IsBoss())
+        {
+            read(obj, filename);
+        }
+        if (loadGrid)
+        {
+            broadcast(obj, loadGrid->BossRank());
+            loadGrid->Barrier();
+        }
+    }
+
+    virtual void save(const std::string filename, const EigenDiskVectorMat<T> &obj) const
+    {
+        GridBase *saveGrid;
+        saveGrid = (*this).getGrid();
+        if (!(saveGrid) || saveGrid->IsBoss())
+        {
+            write(filename, obj);
+        }
+        if (saveGrid)   saveGrid->Barrier();
+    }
+
+    virtual double elementBytes(const EigenDiskVectorMat<T> &obj) const
+    {
+        return static_cast<double>(obj.size())*sizeof(T);
+    }
+
+    virtual bool codecSupported(void) const
+    {
+        return true;
+    }
+
+    // sharded mode: only the owner of the element reads or writes its file,
+    // a miss is collective: the owner broadcasts the element to all the 
+    // processes, which must all be loading the same element. This is checked
+    // with a sum of i and i^2 over the processes (zero variance), so that
+    // out-of-step accesses fail instead of mixing elements or hanging.
+    virtual void loadElement(EigenDiskVectorMat<T> &obj, const unsigned int i) const
+    {
+        if (!this->isSharded())
+        {
+            DiskVectorBase<EigenDiskVectorMat<T>>::loadElement(obj, i);
+
+            return;
+        }
+
+        GridBase *loadGrid = (*this).getGrid();
+        int      root      = this->owner(i);
+        double   nProc     = loadGrid->RankCount();
+        double   step[2]   = {static_cast<double>(i), 
+                              static_cast<double>(i)*static_cast<double>(i)};
+
+        loadGrid->GlobalSumVector(step, 2);
+        if ((step[0] != nProc*i) or (step[1] != nProc*i*static_cast<double>(i)))
+        {
+            HADRONS_ERROR(Io, "sharded disk vector accessed out of step: process " 
+                          + std::to_string(loadGrid->ThisRank()) + " misses on '"
+                          + this->filename(i) + "' but not all the processes do");
+        }
+        if (loadGrid->ThisRank() == root)
+        {
+            read(obj, this->filename(i));
+        }
+        broadcast(obj, root);
+    }
+
+    // the manifest entry is "rows cols crc", it is written by the process
+    // saving the file
+    virtual void saveElement(const unsigned int i, const EigenDiskVectorMat<T> &obj) const
+    {
+        GridBase           *saveGrid = (*this).getGrid();
+        uint32_t           crc       = 0;
+        std::ostringstream info;
+
+        if (!this->isSharded())
+        {
+            if (!(saveGrid) || saveGrid->IsBoss())
+            {
+                crc = write(this->filename(i), obj);
+            }
+            if (saveGrid)   saveGrid->Barrier();
+        }
+        else if (saveGrid->ThisRank() == this->owner(i))
+        {
+            crc = write(this->filename(i), obj);
+        }
+        info << obj.rows() << " " << obj.cols() << " " << std::hex << crc;
+        this->setElementInfo(i, info.str());
+    }
+
+    // file format version 2: header (magic, dimensions, payload size, chunk
+    // size, flags and combined checksum), the checksum of each payload chunk
+    // and the payload, which is the matrix data or their encoded stream. The 
+    // combined checksum is the one of the chunk checksums. Version 1 files 
+    // (checksum, dimensions, encoded size with a codec, and payload) are 
+    // still read.
+    struct FileHeader
+    {
+        char     magic[8];
+        uint64_t nRow, nCol, payloadSize, chunkSize;
+        uint32_t flags, crc;
+    };
+    enum: uint32_t {encodedFlag = 1};
+
+    static const char *fileMagic(void)
+    {
+        return "HADDV002";
+    }
+
+    void read(EigenDiskVectorMat<T> &obj, const std::string filename) const
+    {
+        std::ifstream f(filename, std::ios::binary);
+        FileHeader    header;
+
+        if (!f.good())
+        {
+            HADRONS_ERROR(Io, "cannot open '" + filename + "'");
+        }
+        f.read(header.magic, sizeof(header.magic));
+        if (f.good() and (std::memcmp(header.magic, fileMagic(), sizeof(header.magic)) == 0))
+        {
+            f.read(reinterpret_cast<char *>(&header) + sizeof(header.magic),
+                   sizeof(header) - sizeof(header.magic));
+            read(obj, f, header, filename);
+        }
+        else
+        {
+            f.clear();
+            f.seekg(0);
+            readVersion1(obj, f, filename);
+        }
+    }
+
+    // the chunks are read and verified in overlapping batches (see readChunks)
+    void read(EigenDiskVectorMat<T> &obj, std::ifstream &f, 
+              const FileHeader &header, const std::string filename) const
+    {
+        auto                  codec   = this->getCodec();
+        bool                  encoded = (header.flags & encodedFlag);
+        size_t                matSize, nChunk;
+        std::vector<uint32_t> chunkCrc;
+        std::vector<char>     buf;
+        char                  *payload;
+        double                tRead, tCodec;
+
+        if (!f.good() or (header.chunkSize == 0))
+        {
+            HADRONS_ERROR(Io, "invalid header in '" + filename + "'");
+        }
+        if (encoded and !codec)
+        {
+            HADRONS_ERROR(Io, "'" + filename + "' is encoded and no codec is set");
+        }
+        nChunk = (header.payloadSize + header.chunkSize - 1)/header.chunkSize;
+        chunkCrc.resize(nChunk);
+        f.read(reinterpret_cast<char *>(chunkCrc.data()), nChunk*sizeof(uint32_t));
+        if (!f.good() or (combineChecksum(chunkCrc) != header.crc))
+        {
+            HADRONS_ERROR(Io, "checksum failed (chunk table of '" + filename + "')");
+        }
+        obj.resize(header.nRow, header.nCol);
+        matSize = obj.size()*sizeof(T);
+        if (encoded)
+        {
+            buf.resize(header.payloadSize);
+            payload = buf.data();
+        }
+        else if (header.payloadSize != matSize)
+        {
+            HADRONS_ERROR(Io, "payload of '" + filename + "' does not match its dimensions");
+        }
+        else
+        {
+            payload = reinterpret_cast<char *>(obj.data());
+        }
+        tRead  = -usecond();
+        readChunks(f, payload, header.payloadSize, header.chunkSize, chunkCrc, filename);
+        tRead += usecond();
+        DV_DEBUG_MSG(this, "Eigen read and crc32 " << tRead/1.0e6 << " sec " 
+                     << header.payloadSize/tRead*1.0e6/1024/1024 << " MB/s");
+        if (encoded)
+        {
+            tCodec  = -usecond();
+            codec->decode(obj.data(), matSize, buf, sizeof(Real));
+            tCodec += usecond();
+            LOG(Debug) << "'" << filename << "': " << codec->name() << " decoded "
+                       << sizeString(buf.size()) << " to " << sizeString(matSize) 
+                       << " in " << tCodec/1.0e6 << " s" << std::endl;
+        }
+    }
+
+    void readVersion1(EigenDiskVectorMat<T> &obj, std::ifstream &f, 
+                      const std::string filename) const
+    {
+        auto              codec = this->getCodec();
+        uint32_t          crc, check;
+        Eigen::Index      nRow, nCol;
+        size_t            matSize;
+        uint64_t          encSize;
+        std::vector<char> buf;
+        double            tRead, tHash, tCodec;
+
+        f.read(reinterpret_cast<char *>(&crc), sizeof(crc));
+        f.read(reinterpret_cast<char *>(&nRow), sizeof(nRow));
+        f.read(reinterpret_cast<char *>(&nCol), sizeof(nCol));
+        obj.resize(nRow, nCol);
+        matSize = nRow*nCol*sizeof(T);
+        if (!codec)
+        {
+            tRead  = -usecond();
+            f.read(reinterpret_cast<char *>(obj.data()), matSize);
+            tRead += usecond();
+            tHash  = -usecond();
+            check  = checksum(obj.data(), matSize);
+            tHash += usecond();
+        }
+        else
+        {
+            f.read(reinterpret_cast<char *>(&encSize), sizeof(encSize));
+            buf.resize(f.good() ? encSize : 0);
+            tRead  = -usecond();
+            f.read(buf.data(), buf.size());
+            tRead += usecond();
+            tHash  = -usecond();
+            check  = checksum(buf.data(), buf.size());
+            tHash += usecond();
+        }
+        DV_DEBUG_MSG(this, "Eigen read " << tRead/1.0e6 << " sec " << matSize/tRead*1.0e6/1024/1024 << " MB/s");
+        DV_DEBUG_MSG(this, "Eigen crc32 " << std::hex << check << std::dec 
+                     << " " << tHash/1.0e6 << " sec " << matSize/tHash*1.0e6/1024/1024 << " MB/s");
+        if (crc != check)
+        {
+            HADRONS_ERROR(Io, "checksum failed")
+        }
+        if (codec)
+        {
+            tCodec  = -usecond();
+            codec->decode(obj.data(), matSize, buf, sizeof(Real));
+            tCodec += usecond();
+            LOG(Debug) << "'" << filename << "': " << codec->name() << " decoded "
+                       << sizeString(buf.size()) << " to " << sizeString(matSize) 
+                       << " in " << tCodec/1.0e6 << " s" << std::endl;
+        }
+    }
+
+    // returns the combined checksum
+    uint32_t write(const std::string filename, const EigenDiskVectorMat<T> &obj) const
+    {
+        std::ofstream         f(filename, std::ios::binary);
+        auto                  codec = this->getCodec();
+        FileHeader            header;
+        std::vector<uint32_t> chunkCrc;
+        std::vector<char>     buf;
+        const char            *payload;
+        size_t                matSize;
+        double                tWrite, tHash, tCodec;
+        
+        matSize = obj.size()*sizeof(T);
+        payload = reinterpret_cast<const char *>(obj.data());
+        if (codec)
+        {
+            tCodec  = -usecond();
+            codec->encode(buf, obj.data(), matSize, sizeof(Real));
+            tCodec += usecond();
+            payload = buf.data();
+            LOG(Debug) << "'" << filename << "': " << codec->name() << " encoded "
+                       << sizeString(matSize) << " to " << sizeString(buf.size()) 
+                       << " (ratio " << static_cast<double>(matSize)/buf.size() 
+                       << ") in " << tCodec/1.0e6 << " s" << std::endl;
+        }
+        std::memcpy(header.magic, fileMagic(), sizeof(header.magic));
+        header.nRow        = obj.rows();
+        header.nCol        = obj.cols();
+        header.payloadSize = codec ? buf.size() : matSize;
+        header.chunkSize   = HADRONS_DV_CRC_CHUNK;
+        header.flags       = codec ? encodedFlag : 0;
+        tHash       = -usecond();
+        chunkCrc    = chunkChecksum(payload, header.payloadSize, header.chunkSize);
+        header.crc  = combineChecksum(chunkCrc);
+        tHash      += usecond();
+        tWrite      = -usecond();
+        f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        f.write(reinterpret_cast<const char *>(chunkCrc.data()), chunkCrc.size()*sizeof(uint32_t));
+        f.write(payload, header.payloadSize);
+        tWrite     += usecond();
+        if (!f.good())
+        {
+            HADRONS_ERROR(Io, "cannot write '" + filename + "'");
+        }
+        DV_DEBUG_MSG(this, "Eigen write " << tWrite/1.0e6 << " sec " << matSize/tWrite*1.0e6/1024/1024 << " MB/s");
+        DV_DEBUG_MSG(this, "Eigen crc32 " << std::hex << header.crc << std::dec
+                     << " " << tHash/1.0e6 << " sec " << matSize/tHash*1.0e6/1024/1024 << " MB/s");
+
+        return header.crc;
+    }
+
+    static uint32_t checksum(const void *data, const size_t size)
+    {
+#ifdef USE_IPP
+        return GridChecksum::crc32c(data, size);
+#else
+        return GridChecksum::crc32(data, size);
+#endif
+    }
+
+    static std::vector<uint32_t> chunkChecksum(const char *data, const size_t size,
+                                               const size_t chunkSize)
+    {
+        std::vector<uint32_t> crc((size + chunkSize - 1)/chunkSize);
+
+        thread_for(k, crc.size(),
+        {
+            crc[k] = checksum(data + k*chunkSize, std::min(chunkSize, size - k*chunkSize));
+        });
+
+        return crc;
+    }
+
+    static uint32_t combineChecksum(const std::vector<uint32_t> &crc)
+    {
+        return checksum(crc.data(), crc.size()*sizeof(uint32_t));
+    }
+
+    // the chunks are read in batches of one chunk per thread by a helper 
+    // thread, at most one batch ahead of the verification: batch b + 1 is 
+    // read while the thread pool checks batch b. Reading stops at the first
+    // bad batch, the first bad chunk is reported before a truncation found
+    // further in the file.
+    static void readChunks(std::ifstream &f, char *data, const size_t size,
+                           const size_t chunkSize, const std::vector<uint32_t> &crc,
+                           const std::string &filename)
+    {
+        size_t                  nBatch, nBatchTotal, nRead = 0, nChecked = 0;
+        size_t                  bad = crc.size();
+        bool                    stop = false, truncated = false;
+        std::mutex              mutex;
+        std::condition_variable cv;
+        std::thread             reader;
+
+#ifdef GRID_OMP
+        nBatch = std::max(omp_get_max_threads(), 1);
+#else
+        nBatch = 1;
+#endif
+        nBatchTotal = (crc.size() + nBatch - 1)/nBatch;
+
+        auto readBatch = [&](const size_t b)
+        {
+            for (size_t k = b*nBatch; k < std::min((b + 1)*nBatch, crc.size()); ++k)
+            {
+                f.read(data + k*chunkSize, std::min(chunkSize, size - k*chunkSize));
+                if (!f.good())
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        };
+        auto checkBatch = [&](const size_t b)
+        {
+            size_t           k0 = b*nBatch, k1 = std::min(k0 + nBatch, crc.size());
+            std::vector<int> ok(k1 - k0);
+
+            thread_for(i, k1 - k0,
+            {
+                size_t k = k0 + i;
+
+                ok[i] = (checksum(data + k*chunkSize, 
+                                  std::min(chunkSize, size - k*chunkSize)) == crc[k]);
+            });
+            for (size_t k = k0; (k < k1) and (bad == crc.size()); ++k)
+            {
+                if (!ok[k - k0])
+                {
+                    bad = k;
+                }
+            }
+        };
+
+        // a single batch has nothing to overlap with
+        if (nBatchTotal <= 1)
+        {
+            truncated = !readBatch(0);
+            if (!truncated)
+            {
+                checkBatch(0);
+            }
+        }
+        else
+        {
+            reader = std::thread([&](void)
+            {
+                for (size_t b = 0; b < nBatchTotal; ++b)
+                {
+                    bool good;
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+
+                        cv.wait(lock, [&](void)
+                        {
+                            return stop or (nChecked + 1 >= b);
+                        });
+                        if (stop)
+                        {
+                            return;
+                        }
+                    }
+                    good = readBatch(b);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        if (good)
+                        {
+                            nRead = b + 1;
+                        }
+                        else
+                        {
+                            truncated = true;
+                        }
+                    }
+                    cv.notify_all();
+                    if (!good)
+                    {
+                        return;
+                    }
+                }
+            });
+            for (size_t b = 0; b < nBatchTotal; ++b)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+
+                    cv.wait(lock, [&](void)
+                    {
+                        return (nRead > b) or truncated;
+                    });
+                    if (nRead <= b)
+                    {
+                        break;
+                    }
+                }
+                checkBatch(b);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+
+                    nChecked = b + 1;
+                    stop     = (bad < crc.size());
+                }
+                cv.notify_all();
+                if (bad < crc.size())
+                {
+                    break;
+                }
+            }
+            reader.join();
+        }
+        if (bad < crc.size())
+        {
+            HADRONS_ERROR(Io, "checksum failed (chunk " + std::to_string(bad) 
+                          + " of '" + filename + "')");
+        }
+        if (truncated)
+        {
+            HADRONS_ERROR(Io, "'" + filename + "' is truncated");
+        }
+    }
+
+protected:
+    // the dimensions are sent first, the receiving cache slot may hold an 
+    // element of a different size
+    void broadcast(EigenDiskVectorMat<T> &obj, const int root) const
+    {
+        GridBase     *grid = (*this).getGrid();
+        Eigen::Index dim[2] = {obj.rows(), obj.cols()};
+
+        grid->Broadcast(root, dim, sizeof(dim));
+        if ((obj.rows() != dim[0]) or (obj.cols() != dim[1]))
+        {
+            obj.resize(dim[0], dim[1]);
+        }
+        grid->Broadcast(root, obj.data(), sizeof(T)*obj.size());
+    }
+};
+
+/******************************************************************************
+ *           Read-only Eigen disk vector backed by an A2A matrix file         *
+ ******************************************************************************/
+// timeslices are read from the HDF5 all-to-all matrix file on cache miss, 
+// without staging them in a disk vector directory, the file and the dataset 
+// stay open (on the boss process with a grid, the timeslices are then 
+// broadcast), a file chunked over several timeslices is read through an HDF5
+// chunk cache holding the chunks of a timeslice (see A2AMatrixTimesliceReader)
+template <typename T>
+class A2AMatrixDiskVector: public EigenDiskVector<T>
+{
+public:
+    typedef EigenDiskVectorMat<T>                          Matrix;
+    typedef A2AMatrixTimesliceReader<HADRONS_A2AM_IO_TYPE> Reader;
+public:
+    A2AMatrixDiskVector(const std::string filename, const std::string dataname,
+                        const unsigned int nt, const unsigned int cacheSize = 1,
+                        GridBase *grid = nullptr)
+    : EigenDiskVector<T>("", nt, cacheSize, false, grid)
+    {
+        if (!(grid) || grid->IsBoss())
+        {
+            reader_.reset(new Reader(filename, dataname));
+            if (reader_->getNt() != nt)
+            {
+                HADRONS_ERROR(Size, "all-to-all time size mismatch in '" + filename
+                              + "' (got " + std::to_string(reader_->getNt()) 
+                              + ", expected " + std::to_string(nt) + ")");
+            }
+            if (reader_->getChunkCacheSize() > 0.)
+            {
+                LOG(Message) << "'" << filename << "' is chunked by " 
+                             << reader_->getChunkNt() << " timeslices, using a "
+                             << sizeString(reader_->getChunkCacheSize()) 
+                             << " chunk cache" << std::endl;
+            }
+        }
+    }
+
+    A2AMatrixDiskVector(A2AMatrixDiskVector<T> &&v) = default;
+    virtual ~A2AMatrixDiskVector(void)
+    {
+        this->close();
+    }
+private:
+    virtual void loadElement(Matrix &obj, const unsigned int i) const
+    {
+        GridBase *grid = this->getGrid();
+
+        if (reader_)
+        {
+            reader_->load(obj, i);
+        }
+        if (grid)
+        {
+            this->broadcast(obj, grid->BossRank());
+        }
+    }
+
+    virtual void save(const std::string filename, const Matrix &obj) const
+    {
+        HADRONS_ERROR(Implementation, "all-to-all matrix disk vector is read-only");
+    }
+
+    virtual bool codecSupported(void) const
+    {
+        return false;
+    }
+private:
+    std::unique_ptr<Reader> reader_;
+};
+
+/******************************************************************************
+ *               Memory-mapped Eigen disk vector (read-mostly)                *
+ ******************************************************************************/
+// elements are stored one per file as in EigenDiskVector, but read through
+// Eigen::Map views over memory-mapped files instead of being copied to a 
+// cache: residency is left to the OS page cache. The checksum of a file is 
+// verified once, when it is first mapped after being written, instead of on
+// each cache miss. A map of an element stays valid until the element is 
+// written again or the vector is destroyed. With a grid the boss writes the files and
+// every process maps them, so the directory must be on a shared filesystem.
+// Concurrent first accesses to an element are not thread-safe.
+template <typename T>
+class MappedEigenDiskVector
+{
+public:
+    typedef EigenDiskVectorMat<T>    Matrix;
+    typedef Eigen::Map<const Matrix> ConstMap;
+
+    // helper for read/write vector access
+    class RwAccessHelper
+    {
+    public:
+        RwAccessHelper(MappedEigenDiskVector<T> &master, const unsigned int i)
+        : master_(master), i_(i) {}
+
+        // operator=: write the element file and drop its previous map
+        void operator=(const Matrix &obj) const
+        {
+            master_.write(i_, obj);
+        }
+
+        // implicit cast to a read-only map
+        operator ConstMap() const
+        {
+            const MappedEigenDiskVector<T> &cmaster = master_;
+
+            return cmaster[i_];
+        }
+    private:
+        MappedEigenDiskVector<T> &master_;
+        const unsigned int       i_;
+    };
+public:
+    MappedEigenDiskVector(const std::string dirname, const unsigned int size = 0,
+                          const bool clean = true, GridBase *grid = nullptr,
+                          const bool verify = true);
+    MappedEigenDiskVector(MappedEigenDiskVector<T> &&v);
+    virtual ~MappedEigenDiskVector(void);
+    ConstMap operator[](const unsigned int i) const;
+    RwAccessHelper operator[](const unsigned int i);
+    T operator()(const unsigned int i, const Eigen::Index j,
+                 const Eigen::Index k) const;
+    std::vector<int> dimensions(void) const;
+    // unmap element i, its maps become invalid
+    void release(const unsigned int i) const;
+    double mappedBytes(void) const;
+    unsigned int getSize(void) const;
+    GridBase *getGrid(void) const;
+private:
+    // file layout: crc32 of the data, row and column counts, data at a
+    // fixed offset aligned for vectorised access
+    enum: size_t {headerSize = 64};
+    struct Mapping
+    {
+        void         *addr{nullptr};
+        size_t       length{0};
+        Eigen::Index nRow{0}, nCol{0};
+        bool         verified{false};
+    };
+private:
+    std::string filename(const unsigned int i) const;
+    void map(const unsigned int i) const;
+    void write(const unsigned int i, const Matrix &obj);
+private:
+    std::string                           dirname_;
+    unsigned int                          size_;
+    bool                                  clean_, verify_;
+    GridBase                              *grid_;
+    // pointer to allow mapping when the vector is const
+    std::unique_ptr<std::vector<Mapping>> mapPtr_;
+};
+
+/******************************************************************************
+ *                       DiskVectorBase implementation                         *
+ ******************************************************************************/
+template <typename T>
+DiskVectorBase<T>::DiskVectorBase(const std::string dirname, 
+                                  const unsigned int size,
+                                  const unsigned int cacheSize,
+                                  const bool clean,
+                                  GridBase *grid, const bool sharded,
+                                  const DiskVectorMode mode)
+: dirname_(dirname), size_(size), cacheSize_(cacheSize), clean_(clean)
+, sharded_(sharded), mode_(mode), grid_(grid)
+, cachePtr_(new std::vector<T>(cacheSize))
+, modifiedPtr_(new std::vector<bool>(cacheSize, false))
+, lruPtr_(new DiskVectorLru(size, cacheSize))
+, loaderPtr_(new Loader)
+, writerPtr_(new Writer)
+, usagePtr_(new Usage)
+, manifestPtr_(new Manifest)
+{
+    struct stat s;
+
+    if (cacheSize_ == 0)
+    {
+        HADRONS_ERROR(Size, "disk vector cache size must be at least 1");
+    }
+    if (sharded_)
+    {
+        if (!grid_)
+        {
+            HADRONS_ERROR(Argument, "sharded disk vector needs a grid");
+        }
+        if (dirname.empty())
+        {
+            HADRONS_ERROR(Argument, "sharded disk vector needs a directory");
+        }
+        dirname_ += "/rank_" + std::to_string(grid_->ThisRank());
+    }
+
+    // an empty directory name is used by backends not storing elements
+    if (mode_ != DiskVectorMode::create)
+    {
+        openStore();
+    }
+    else
+    {
+        if (!dirname_.empty() and manifestRank())
+        {
+            if(stat(dirname_.c_str(), &s) == 0)
+            {
+                HADRONS_ERROR(Io, "directory '" + dirname_ + "' already exists")
+            }
+            mkdir(dirname_);
+            if (!clean_)
+            {
+                lockStore();
+            }
+        }
+        manifestPtr_->present.assign(size_, false);
+        manifestPtr_->info.assign(size_, "");
+    }
+    persistent_ = !clean_ and !dirname_.empty();
+    if (grid_)  grid_->Barrier();
+    setSize(size_);
+    setGrid(grid_);
+    usagePtr_->stamp.assign(cacheSize_, 0);
+    usagePtr_->bytes.assign(cacheSize_, 0.);
+    DiskVectorCacheManager::getInstance().registerClient(this);
+}
+
+// the loader thread of v refers to v, it is stopped before the move
+template <typename T>
+DiskVectorBase<T>::DiskVectorBase(DiskVectorBase<T> &&v)
+{
+    v.disablePrefetch();
+    v.disableWriteBehind();
+    dvSize       = v.dvSize;
+    dvGrid       = v.dvGrid;
+    dirname_     = std::move(v.dirname_);
+    size_        = v.size_;
+    cacheSize_   = v.cacheSize_;
+    access_      = v.access_;
+    hit_         = v.hit_;
+    prefetchHit_ = v.prefetchHit_;
+    clean_       = v.clean_;
+    sharded_     = v.sharded_;
+    persistent_  = v.persistent_;
+    mode_        = v.mode_;
+    grid_        = v.grid_;
+    cachePtr_    = std::move(v.cachePtr_);
+    modifiedPtr_ = std::move(v.modifiedPtr_);
+    lruPtr_      = std::move(v.lruPtr_);
+    loaderPtr_   = std::move(v.loaderPtr_);
+    writerPtr_   = std::move(v.writerPtr_);
+    usagePtr_    = std::move(v.usagePtr_);
+    manifestPtr_ = std::move(v.manifestPtr_);
+    codec_       = std::move(v.codec_);
+    DiskVectorCacheManager::getInstance().registerClient(this);
+    // the moved-from vector must not remove the directory
+    v.clean_     = false;
+}
+
+template <typename T>
+DiskVectorBase<T>::~DiskVectorBase(void)
+{
+    DiskVectorCacheManager::getInstance().unregisterClient(this);
+    disablePrefetch();
+    disableWriteBehind();
+    unlockStore();
+    if (clean_ and !dirname_.empty())
+    {
+        clean();
+    }
+}
+
+template <typename T>
+void DiskVectorBase<T>::setSize(unsigned int size_)
+{
+    dvSize = size_;
+}
+
+template <typename T>
+unsigned int DiskVectorBase<T>::getSize() const
+{
+    return dvSize;
+}
+
+template <typename T>
+void DiskVectorBase<T>::setGrid(GridBase *grid_)
+{
+    dvGrid = grid_;
+}
+
+template <typename T>
+GridBase *DiskVectorBase<T>::getGrid() const
+{
+    return dvGrid;
+}
+
+template <typename T>
+const T & DiskVectorBase<T>::operator[](const unsigned int i) const
+{
+    auto         &cache  = *cachePtr_;
+    auto         &lru    = *lruPtr_;
+    auto         &loader = *loaderPtr_;
+    unsigned int s;
+    bool         grown;
+
+    DV_DEBUG_MSG(this, "accessing " << i << " (RO)");
+
+    if (i >= size_)
+    {
+        HADRONS_ERROR(Size, "index out of range");
+    }
+
+    auto lock = lockCache();
+
+    const_cast<double &>(access_)++;
+    s = lru.slot(i);
+    if ((s != DiskVectorLru::none) and loader.async and loader.loading[s])
+    {
+        // background load in progress, the slot is released if it fails
+        DV_DEBUG_MSG(this, "waiting for prefetch of " << i);
+        loader.done.wait(lock, [&lru, &loader, s, i](void)
+        {
+            return (lru.slot(i) != s) or !loader.loading[s];
+        });
+        s = lru.slot(i);
+    }
+    if (s == DiskVectorLru::none)
+    {
+        // cache miss
+        DV_DEBUG_MSG(this, "cache miss");
+        s = fetch(i, lock);
+    }
+    else
+    {
+        DV_DEBUG_MSG(this, "cache hit");
+        const_cast<double &>(hit_)++;
+        if (loader.async and loader.prefetched[s])
+        {
+            const_cast<double &>(prefetchHit_)++;
+            loader.prefetched[s] = false;
+            loader.nPrefetched--;
+        }
+        lru.touch(s);
+    }
+    grown = updateUsage(s);
+    if (loader.async)
+    {
+        predict(i, lock);
+    }
+#ifdef DV_DEBUG
+    debugCache();
+#endif
+    // the cache manager locks the vectors it evicts from
+    if (grown)
+    {
+        if (lock.owns_lock())
+        {
+            lock.unlock();
+        }
+        DiskVectorCacheManager::getInstance().reserve();
+    }
+    if (grid_ and !sharded_)
+    {
+        grid_->Barrier();
+    }
+    return cache[s];
+}
+
+template <typename T>
+typename DiskVectorBase<T>::RwAccessHelper DiskVectorBase<T>::operator[](const unsigned int i)
+{
+    DV_DEBUG_MSG(this, "accessing " << i << " (RW)");
+
+    if (i >= size_)
+    {
+        HADRONS_ERROR(Size, "index out of range");
+    }
+
+    return RwAccessHelper(*this, i);
+}
+
+template <typename T>
+double DiskVectorBase<T>::hitRatio(void) const
+{
+    return hit_/access_;
+}
+
+template <typename T>
+double DiskVectorBase<T>::prefetchHitRatio(void) const
+{
+    return prefetchHit_/access_;
+}
+
+template <typename T>
+void DiskVectorBase<T>::resetStat(void)
+{
+    access_      = 0.;
+    hit_         = 0.;
+    prefetchHit_ = 0.;
+}
+
+template <typename T>
+void DiskVectorBase<T>::prefetch(const unsigned int i) const
+{
+    if (i >= size_)
+    {
+        HADRONS_ERROR(Size, "index out of range");
+    }
+
+    auto lock = lockCache();
+
+    if (loaderPtr_->async)
+    {
+        schedule(i, lock);
+    }
+    else if (lruPtr_->slot(i) == DiskVectorLru::none)
+    {
+        fetch(i, lock);
+    }
+}
+
+template <typename T>
+void DiskVectorBase<T>::enablePrefetch(const unsigned int depth)
+{
+    auto &loader = *loaderPtr_;
+
+    if (loader.async)
+    {
+        disablePrefetch();
+    }
+    if ((depth == 0) or (depth + 2 > cacheSize_))
+    {
+        HADRONS_ERROR(Size, "prefetch depth " + std::to_string(depth) 
+                      + " needs a cache size between 1 and " 
+                      + std::to_string(cacheSize_ - 2) + " (cache size " 
+                      + std::to_string(cacheSize_) + ")");
+    }
+    if (grid_ or getGrid())
+    {
+        HADRONS_ERROR(Implementation, "background loading is not supported for"
+                      " disk vectors distributed over a grid");
+    }
+    loader.depth       = depth;
+    loader.nPrefetched = 0;
+    loader.stop        = false;
+    loader.history.clear();
+    loader.loading.assign(cacheSize_, false);
+    loader.prefetched.assign(cacheSize_, false);
+    loader.async       = true;
+    loader.thread      = std::thread(&DiskVectorBase<T>::loaderLoop, this);
+}
+
+template <typename T>
+void DiskVectorBase<T>::disablePrefetch(void)
+{
+    // loaderPtr_ is null in a moved-from vector
+    if (!loaderPtr_ or !loaderPtr_->async)
+    {
+        return;
+    }
+
+    auto &loader = *loaderPtr_;
+    auto &lru    = *lruPtr_;
+
+    {
+        std::lock_guard<std::mutex> guard(loader.mutex);
+
+        loader.stop = true;
+    }
+    loader.wake.notify_all();
+    loader.thread.join();
+    // release the slots of the loads which did not start
+    for (auto &job: loader.queue)
+    {
+        lru.erase(job.second);
+    }
+    loader.queue.clear();
+    loader.async = false;
+}
+
+template <typename T>
+bool DiskVectorBase<T>::prefetchEnabled(void) const
+{
+    return loaderPtr_->async;
+}
+
+template <typename T>
+void DiskVectorBase<T>::enableWriteBehind(const unsigned int queueSize)
+{
+    auto &writer = *writerPtr_;
+
+    if (writer.active)
+    {
+        disableWriteBehind();
+    }
+    if (queueSize == 0)
+    {
+        HADRONS_ERROR(Size, "write-behind queue size must be at least 1");
+    }
+    // saves in the boss mode are collective
+    if ((grid_ or getGrid()) and !sharded_)
+    {
+        HADRONS_ERROR(Implementation, "background writing is only supported for"
+                      " sharded disk vectors when distributed over a grid");
+    }
+    writer.queueSize = queueSize;
+    writer.stop      = false;
+    writer.error     = nullptr;
+    writer.active    = true;
+    writer.thread    = std::thread(&DiskVectorBase<T>::writerLoop, this);
+}
+
+// the pending writes are completed before the writer stops, their errors are
+// lost, call flush() first to get them
+template <typename T>
+void DiskVectorBase<T>::disableWriteBehind(void)
+{
+    // writerPtr_ is null in a moved-from vector
+    if (!writerPtr_ or !writerPtr_->active)
+    {
+        return;
+    }
+
+    auto &writer = *writerPtr_;
+
+    {
+        std::lock_guard<std::mutex> guard(writer.mutex);
+
+        writer.stop = true;
+    }
+    writer.wake.notify_all();
+    writer.thread.join();
+    writer.spare.clear();
+    writer.active = false;
+}
+
+template <typename T>
+bool DiskVectorBase<T>::writeBehindEnabled(void) const
+{
+    return writerPtr_->active;
+}
+
+// the queue is drained first, so that an older queued version of a cached 
+// element cannot overwrite it
+template <typename T>
+void DiskVectorBase<T>::flush(void)
+{
+    auto &cache    = *cachePtr_;
+    auto &modified = *modifiedPtr_;
+    auto lock      = lockCache();
+
+    if (writerPtr_->active)
+    {
+        std::unique_lock<std::mutex> writerLock(writerPtr_->mutex);
+
+        waitWriter(writerLock);
+    }
+    lruPtr_->forEach([this, &cache, &modified](const unsigned int i, 
+                                               const unsigned int s)
+    {
+        if (modified[s])
+        {
+            DV_DEBUG_MSG(this, "flushing " << i);
+            saveElement(i, cache[s]);
+            modified[s] = false;
+        }
+    });
+    if (persistent_ and (mode_ != DiskVectorMode::read) and manifestRank())
+    {
+        writeManifest();
+    }
+    if (grid_ and !sharded_)
+    {
+        grid_->Barrier();
+    }
+}
+
+template <typename T>
+void DiskVectorBase<T>::close(void)
+{
+    // lruPtr_ is null in a moved-from vector
+    if (!lruPtr_)
+    {
+        return;
+    }
+    disablePrefetch();
+    if (persistent_ and (mode_ != DiskVectorMode::read))
+    {
+        flush();
+    }
+    disableWriteBehind();
+    unlockStore();
+}
+
+template <typename T>
+std::string DiskVectorBase<T>::cacheName(void) const
+{
+    return dirname_.empty() ? "(no directory)" : dirname_;
+}
+
+template <typename T>
+unsigned int DiskVectorBase<T>::cacheCount(void) const
+{
+    return lruPtr_ ? lruPtr_->count() : 0;
+}
+
+template <typename T>
+double DiskVectorBase<T>::cacheBytes(void) const
+{
+    return usagePtr_ ? usagePtr_->total : 0.;
+}
+
+template <typename T>
+double DiskVectorBase<T>::hitCount(void) const
+{
+    return hit_;
+}
+
+template <typename T>
+double DiskVectorBase<T>::missCount(void) const
+{
+    return access_ - hit_;
+}
+
+template <typename T>
+bool DiskVectorBase<T>::cacheLruStamp(uint64_t &stamp) const
+{
+    // lruPtr_ is null in a moved-from vector
+    if (!lruPtr_)
+    {
+        return false;
+    }
+    // the manager evicts per process, an eviction from a vector distributed 
+    // over a grid would make the processes miss on different elements and 
+    // hang in the collective save or broadcast
+    if (grid_ or getGrid())
+    {
+        return false;
+    }
+
+    auto         lock = lockCache();
+    unsigned int s    = evictableLru();
+
+    if (s == DiskVectorLru::none)
+    {
+        return false;
+    }
+    stamp = usagePtr_->stamp[s];
+
+    return true;
+}
+
+template <typename T>
+void DiskVectorBase<T>::cacheEvictLru(void) const
+{
+    if (!lruPtr_)
+    {
+        return;
+    }
+
+    auto         lock = lockCache();
+    unsigned int s    = evictableLru();
+
+    if (s != DiskVectorLru::none)
+    {
+        evictSlot(s);
+    }
+}
+
+// least recently used slot which the cache manager can evict, the two most
+// recently used elements are kept, so that references to them stay valid
+template <typename T>
+unsigned int DiskVectorBase<T>::evictableLru(void) const
+{
+    auto         &lru    = *lruPtr_;
+    auto         &loader = *loaderPtr_;
+    unsigned int s       = lru.lru();
+
+    if ((lru.count() <= 2) or (loader.async and loader.loading[s]))
+    {
+        return DiskVectorLru::none;
+    }
+
+    return s;
+}
+
+template <typename T>
+bool DiskVectorBase<T>::isSharded(void) const
+{
+    return sharded_;
+}
+
+template <typename T>
+bool DiskVectorBase<T>::isPersistent(void) const
+{
+    return persistent_;
+}
+
+template <typename T>
+DiskVectorMode DiskVectorBase<T>::getMode(void) const
+{
+    return mode_;
+}
+
+template <typename T>
+void DiskVectorBase<T>::setCodec(std::shared_ptr<DiskVectorCodec> codec)
+{
+    if (codec and !codecSupported())
+    {
+        HADRONS_ERROR(Implementation, "this disk vector type does not support codecs");
+    }
+    codec_ = codec;
+}
+
+template <typename T>
+std::shared_ptr<DiskVectorCodec> DiskVectorBase<T>::getCodec(void) const
+{
+    return codec_;
+}
+
+template <typename T>
+bool DiskVectorBase<T>::codecSupported(void) const
+{
+    return false;
+}
+
+template <typename T>
+std::string DiskVectorBase<T>::filename(const unsigned int i) const
+{
+    return dirname_ + "/elem_" + std::to_string(i);
+}
+
+// rank storing element i in sharded mode
+template <typename T>
+int DiskVectorBase<T>::owner(const unsigned int i) const
+{
+    return i % grid_->RankCount();
+}
+
+template <typename T>
+void DiskVectorBase<T>::loadElement(T &obj, const unsigned int i) const
+{
+    struct stat s;
+
+    if(stat(filename(i).c_str(), &s) != 0)
+    {
+        HADRONS_ERROR(Io, "disk vector element " + std::to_string(i) + " uninitialised");
+    }
+    load(obj, filename(i));
+}
+
+template <typename T>
+void DiskVectorBase<T>::saveElement(const unsigned int i, const T &obj) const
+{
+    save(filename(i), obj);
+    setElementInfo(i, "");
+}
+
+template <typename T>
+void DiskVectorBase<T>::setElementInfo(const unsigned int i, 
+                                       const std::string &info) const
+{
+    if (!persistent_)
+    {
+        return;
+    }
+
+    auto                        &manifest = *manifestPtr_;
+    std::lock_guard<std::mutex> guard(manifest.mutex);
+
+    manifest.present[i] = true;
+    manifest.info[i]    = info;
+}
+
+template <typename T>
+double DiskVectorBase<T>::elementBytes(const T &obj) const
+{
+    return sizeof(T);
+}
+
+// the cache lock is only taken when the loader thread is running
+template <typename T>
+std::unique_lock<std::mutex> DiskVectorBase<T>::lockCache(void) const
+{
+    if (loaderPtr_->async)
+    {
+        return std::unique_lock<std::mutex>(loaderPtr_->mutex);
+    }
+    else
+    {
+        return std::unique_lock<std::mutex>(loaderPtr_->mutex, std::defer_lock);
+    }
+}
+
+template <typename T>
+void DiskVectorBase<T>::evict(std::unique_lock<std::mutex> &lock) const
+{
+    auto &lru    = *lruPtr_;
+    auto &loader = *loaderPtr_;
+
+    if (lru.full())
+    {
+        unsigned int s = lru.lru();
+        
+        // the least recently used element can still be loading in the
+        // background, wait for it
+        if (loader.async)
+        {
+            loader.done.wait(lock, [&lru, &loader](void)
+            {
+                return !lru.full() or !loader.loading[lru.lru()];
+            });
+            if (!lru.full())
+            {
+                return;
+            }
+            s = lru.lru();
+        }
+        evictSlot(s);
+    }
+    if (grid_ and !sharded_)
+    {
+        grid_->Barrier();
+    }
+}
+
+// the slot must not be loading in the background
+template <typename T>
+void DiskVectorBase<T>::evictSlot(const unsigned int s) const
+{
+    auto         &cache    = *cachePtr_;
+    auto         &modified = *modifiedPtr_;
+    auto         &lru      = *lruPtr_;
+    auto         &loader   = *loaderPtr_;
+    auto         &usage    = *usagePtr_;
+    unsigned int i         = lru.element(s);
+
+    DV_DEBUG_MSG(this, "evicting " << i);
+    if (loader.async and loader.prefetched[s])
+    {
+        loader.prefetched[s] = false;
+        loader.nPrefetched--;
+    }
+    if (modified[s])
+    {
+        if (writerPtr_->active)
+        {
+            DV_DEBUG_MSG(this, "element " << i << " modified, queued for saving");
+            enqueue(i, cache[s]);
+        }
+        else
+        {
+            DV_DEBUG_MSG(this, "element " << i << " modified, saving to disk");
+            saveElement(i, cache[s]);
+        }
+    }
+    usage.total   -= usage.bytes[s];
+    usage.bytes[s] = 0.;
+    lru.erase(s);
+}
+
+// stamp slot s and update its memory when the cache manager is enabled, 
+// returns true if the memory grew
+template <typename T>
+bool DiskVectorBase<T>::updateUsage(const unsigned int s) const
+{
+    auto   &manager = DiskVectorCacheManager::getInstance();
+    auto   &usage   = *usagePtr_;
+    double bytes, old;
+
+    if (!manager.enabled())
+    {
+        return false;
+    }
+    usage.stamp[s] = manager.tick();
+    bytes          = elementBytes((*cachePtr_)[s]);
+    old            = usage.bytes[s];
+    usage.bytes[s] = bytes;
+    usage.total   += bytes - old;
+
+    return (bytes > old);
+}
+
+template <typename T>
+unsigned int DiskVectorBase<T>::fetch(const unsigned int i, 
+                                      std::unique_lock<std::mutex> &lock) const
+{
+    auto         &cache    = *cachePtr_;
+    auto         &modified = *modifiedPtr_;
+    auto         &lru      = *lruPtr_;
+    unsigned int s;
+
+    DV_DEBUG_MSG(this, "loading " << i << " from disk");
+
+    evict(lock);
+    s           = lru.insert(i);
+    modified[s] = false;
+    // the loader thread only works on its own slots, the cache is unlocked
+    // while reading
+    if (lock.owns_lock())
+    {
+        lock.unlock();
+    }
+    try
+    {
+        readElement(cache[s], i);
+    }
+    catch (...)
+    {
+        // do not leave a slot with invalid data in the cache
+        if (loaderPtr_->async)
+        {
+            lock.lock();
+        }
+        lru.erase(s);
+        throw;
+    }
+    if (loaderPtr_->async)
+    {
+        lock.lock();
+    }
+
+    return s;
+}
+
+template <typename T>
+unsigned int DiskVectorBase<T>::cacheInsert(const unsigned int i, const T &obj) const
+{
+    if (mode_ == DiskVectorMode::read)
+    {
+        HADRONS_ERROR(Io, "disk vector store '" + dirname_ + "' is opened read-only");
+    }
+
+    auto         &cache    = *cachePtr_;
+    auto         &modified = *modifiedPtr_;
+    auto         &lru      = *lruPtr_;
+    auto         &loader   = *loaderPtr_;
+    auto         lock      = lockCache();
+    unsigned int s         = lru.slot(i);
+
+    // an element already in cache is overwritten in place, after its
+    // background load if there is one
+    if ((s != DiskVectorLru::none) and loader.async)
+    {
+        loader.done.wait(lock, [&lru, &loader, s, i](void)
+        {
+            return (lru.slot(i) != s) or !loader.loading[s];
+        });
+        s = lru.slot(i);
+        if ((s != DiskVectorLru::none) and loader.prefetched[s])
+        {
+            loader.prefetched[s] = false;
+            loader.nPrefetched--;
+        }
+    }
+    if (s == DiskVectorLru::none)
+    {
+        evict(lock);
+        s = lru.insert(i);
+    }
+    else
+    {
+        lru.touch(s);
+    }
+    cache[s]    = obj;
+    modified[s] = true;
+    if (updateUsage(s))
+    {
+        if (lock.owns_lock())
+        {
+            lock.unlock();
+        }
+        DiskVectorCacheManager::getInstance().reserve();
+    }
+    if (grid_ and !sharded_)
+    {
+        grid_->Barrier();
+    }
+#ifdef DV_DEBUG
+    debugCache();
+#endif
+
+    return s;
+}
+
+// stride detection: element i continues a pattern of lag p if the stride 
+// (modulo the vector size) from the access p steps back is the same as the
+// previous one at that lag, the smallest such lag up to 4 is used, so that
+// interleaved sequences like (t, t + 1, t + 2, t + 3, ...) or (t, t + dt, 
+// t + 1, t + 1 + dt, ...) are recognised, repeated accesses are ignored
+template <typename T>
+void DiskVectorBase<T>::predict(const unsigned int i, 
+                                std::unique_lock<std::mutex> &lock) const
+{
+    const unsigned int maxLag  = 4;
+    auto               &loader = *loaderPtr_;
+    auto               &h      = loader.history;
+
+    if (!h.empty() and (h.front() == i))
+    {
+        return;
+    }
+    h.push_front(i);
+    if (h.size() > 2*maxLag + 1)
+    {
+        h.pop_back();
+    }
+    for (unsigned int p = 1; 2*p < h.size(); ++p)
+    {
+        unsigned int stride = (h[0] + size_ - h[p]) % size_;
+
+        if ((stride != 0) and (stride == (h[p] + size_ - h[2*p]) % size_))
+        {
+            for (unsigned int k = 1; k <= loader.depth; ++k)
+            {
+                schedule((i + static_cast<size_t>(k)*stride) % size_, lock);
+            }
+            break;
+        }
+    }
+}
+
+// queue the background load of element i in a free slot, or in the slot of 
+// the least recently used element if it is neither loading nor prefetched
+template <typename T>
+void DiskVectorBase<T>::schedule(const unsigned int i,
+                                 std::unique_lock<std::mutex> &lock) const
+{
+    auto         &modified = *modifiedPtr_;
+    auto         &lru      = *lruPtr_;
+    auto         &loader   = *loaderPtr_;
+    unsigned int s;
+
+    if ((lru.slot(i) != DiskVectorLru::none) 
+        or (loader.nPrefetched >= loader.depth))
+    {
+        return;
+    }
+    if (lru.full())
+    {
+        s = lru.lru();
+        if (loader.loading[s] or loader.prefetched[s])
+        {
+            return;
+        }
+        evict(lock);
+    }
+    DV_DEBUG_MSG(this, "prefetching " << i);
+    s                    = lru.insert(i);
+    modified[s]          = false;
+    loader.loading[s]    = true;
+    loader.prefetched[s] = true;
+    loader.nPrefetched++;
+    loader.queue.push_back(std::make_pair(i, s));
+    loader.wake.notify_one();
+}
+
+template <typename T>
+void DiskVectorBase<T>::loaderLoop(void) const
+{
+    auto                         &cache  = *cachePtr_;
+    auto                         &lru    = *lruPtr_;
+    auto                         &loader = *loaderPtr_;
+    std::unique_lock<std::mutex> lock(loader.mutex);
+
+    while (true)
+    {
+        loader.wake.wait(lock, [&loader](void)
+        {
+            return loader.stop or !loader.queue.empty();
+        });
+        if (loader.stop)
+        {
+            break;
+        }
+
+        auto job    = loader.queue.front();
+        bool failed = false;
+
+        loader.queue.pop_front();
+        lock.unlock();
+        try
+        {
+            readElement(cache[job.second], job.first);
+        }
+        catch (...)
+        {
+            // the element will be loaded again on access, and the error
+            // raised there
+            failed = true;
+        }
+        lock.lock();
+        loader.loading[job.second] = false;
+        if (failed)
+        {
+            loader.prefetched[job.second] = false;
+            loader.nPrefetched--;
+            lru.erase(job.second);
+        }
+        loader.done.notify_all();
+    }
+}
+
+// queued elements are more recent than their file, the last queued version
+// of an element is the most recent. In sharded mode a miss is collective: 
+// the owner alone cannot serve it from its queue while the other processes
+// wait in the broadcast, and the queues of the processes drain at different
+// rates, so the queue is drained first and the owner reads the saved file.
+template <typename T>
+void DiskVectorBase<T>::readElement(T &obj, const unsigned int i) const
+{
+    {
+        auto                         &writer = *writerPtr_;
+        std::unique_lock<std::mutex> lock(writer.mutex);
+
+        if (sharded_)
+        {
+            DV_DEBUG_MSG(this, "draining write queue before reading " << i);
+            waitWriter(lock);
+            lock.unlock();
+            loadElement(obj, i);
+
+            return;
+        }
+        for (auto it = writer.queue.rbegin(); it != writer.queue.rend(); ++it)
+        {
+            if (it->first == i)
+            {
+                DV_DEBUG_MSG(this, "element " << i << " read from write queue");
+                obj = it->second;
+
+                return;
+            }
+        }
+    }
+    loadElement(obj, i);
+}
+
+// obj is swapped with a recycled buffer, so that the cache slot keeps an 
+// allocation of the right size when possible
+template <typename T>
+void DiskVectorBase<T>::enqueue(const unsigned int i, T &obj) const
+{
+    auto                         &writer = *writerPtr_;
+    std::unique_lock<std::mutex> lock(writer.mutex);
+    T                            buf;
+
+    writer.done.wait(lock, [&writer](void)
+    {
+        return (writer.queue.size() < writer.queueSize) or writer.error;
+    });
+    if (writer.error)
+    {
+        waitWriter(lock);
+    }
+    if (!writer.spare.empty())
+    {
+        buf = std::move(writer.spare.back());
+        writer.spare.pop_back();
+    }
+    std::swap(buf, obj);
+    writer.queue.emplace_back(i, std::move(buf));
+    writer.wake.notify_all();
+}
+
+// wait for the queue to be empty and raise the first background error
+template <typename T>
+void DiskVectorBase<T>::waitWriter(std::unique_lock<std::mutex> &lock) const
+{
+    auto &writer = *writerPtr_;
+
+    writer.done.wait(lock, [&writer](void)
+    {
+        return writer.queue.empty();
+    });
+    if (writer.error)
+    {
+        std::exception_ptr error = writer.error;
+
+        writer.error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename T>
+void DiskVectorBase<T>::writerLoop(void) const
+{
+    auto                         &writer = *writerPtr_;
+    std::unique_lock<std::mutex> lock(writer.mutex);
+
+    while (true)
     {
-        GridBase *loadGrid;
-        loadGrid = (*this).getGrid();
-        if (!(loadGrid) || loadGrid->IsBoss())
+        writer.wake.wait(lock, [&writer](void)
         {
-            std::ifstream f(filename, std::ios::binary);
-            uint32_t      crc, check;
-            Eigen::Index  nRow, nCol;
-            size_t        matSize;
-            double        tRead, tHash;
-
-            f.read(reinterpret_cast<char *>(&crc), sizeof(crc));
-            f.read(reinterpret_cast<char *>(&nRow), sizeof(nRow));
-            f.read(reinterpret_cast<char *>(&nCol), sizeof(nCol));
-            obj.resize(nRow, nCol);
-            matSize = nRow*nCol*sizeof(T);
-            tRead  = -usecond();
-            f.read(reinterpret_cast<char *>(obj.data()), matSize);
-            tRead += usecond();
-            tHash  = -usecond();
-    #ifdef USE_IPP
-            check  = GridChecksum::crc32c(obj.data(), matSize);
-    #else
-            check  = GridChecksum::crc32(obj.data(), matSize);
-    #endif
-            tHash += usecond();
-            DV_DEBUG_MSG(this, "Eigen read " << tRead/1.0e6 << " sec " << matSize/tRead*1.0e6/1024/1024 << " MB/s");
-            DV_DEBUG_MSG(this, "Eigen crc32 " << std::hex << check << std::dec 
-                        << " " << tHash/1.0e6 << " sec " << matSize/tHash*1.0e6/1024/1024 << " MB/s");
-            if (crc != check)
+            return writer.stop or !writer.queue.empty();
+        });
+        // the queue is drained before stopping
+        if (writer.queue.empty())
+        {
+            break;
+        }
+
+        // references to the front are stable while other elements are queued
+        auto &job = writer.queue.front();
+
+        lock.unlock();
+        try
+        {
+            saveElement(job.first, job.second);
+        }
+        catch (...)
+        {
+            lock.lock();
+            if (!writer.error)
             {
-                HADRONS_ERROR(Io, "checksum failed")
+                writer.error = std::current_exception();
             }
+            lock.unlock();
         }
-        int broadcastSize;
-        broadcastSize = sizeof(T)*obj.size();
-        if (loadGrid)
+        lock.lock();
+        if (writer.spare.size() < writer.queueSize)
         {
-            loadGrid->Broadcast(loadGrid->BossRank(), obj.data(), broadcastSize);
-            loadGrid->Barrier();
+            writer.spare.push_back(std::move(job.second));
         }
+        writer.queue.pop_front();
+        writer.done.notify_all();
     }
+}
 
-    virtual void save(const std::string filename, const EigenDiskVectorMat<T> &obj) const
+template <typename T>
+void DiskVectorBase<T>::debugCache(void) const
+{
+    std::string msg;
+
+    lruPtr_->forEach([&msg](const unsigned int i, const unsigned int s)
     {
-        GridBase *saveGrid;
-        saveGrid = (*this).getGrid();
-        if (!(saveGrid) || saveGrid->IsBoss())
-        {
-            std::ofstream f(filename, std::ios::binary);
-            uint32_t      crc;
-            Eigen::Index  nRow, nCol;
-            size_t        matSize;
-            double        tWrite, tHash;
-            
-            nRow    = obj.rows();
-            nCol    = obj.cols();
-            matSize = nRow*nCol*sizeof(T);
-            tHash   = -usecond();
-    #ifdef USE_IPP
-            crc     = GridChecksum::crc32c(obj.data(), matSize);
-    #else
-            crc     = GridChecksum::crc32(obj.data(), matSize);
-    #endif
-            tHash  += usecond();
-            f.write(reinterpret_cast<char *>(&crc), sizeof(crc));
-            f.write(reinterpret_cast<char *>(&nRow), sizeof(nRow));
-            f.write(reinterpret_cast<char *>(&nCol), sizeof(nCol));
-            tWrite = -usecond();
-            f.write(reinterpret_cast<const char *>(obj.data()), matSize);
-            tWrite += usecond();
-            DV_DEBUG_MSG(this, "Eigen write " << tWrite/1.0e6 << " sec " << matSize/tWrite*1.0e6/1024/1024 << " MB/s");
-            DV_DEBUG_MSG(this, "Eigen crc32 " << std::hex << crc << std::dec
-                        << " " << tHash/1.0e6 << " sec " << matSize/tHash*1.0e6/1024/1024 << " MB/s");
-        }
-        if (saveGrid)   saveGrid->Barrier();
-    }
-};
+        msg += std::to_string(i) + " ";
+    });
+    DV_DEBUG_MSG(this, "in cache: " << msg);
+}
 
 /******************************************************************************
- *                       DiskVectorBase implementation                         *
+ *                   MappedEigenDiskVector implementation                     *
  ******************************************************************************/
 template <typename T>
-DiskVectorBase<T>::DiskVectorBase(const std::string dirname, 
-                                  const unsigned int size,
-                                  const unsigned int cacheSize,
-                                  const bool clean,
-                                  GridBase *grid)
-: dirname_(dirname), size_(size), cacheSize_(cacheSize), clean_(clean), grid_(grid)
-, cachePtr_(new std::vector<T>(size))
-, modifiedPtr_(new std::vector<bool>(size, false))
-, indexPtr_(new std::map<unsigned int, unsigned int>())
-, freePtr_(new std::stack<unsigned int>)
-, loadsPtr_(new std::deque<unsigned int>())
+MappedEigenDiskVector<T>::MappedEigenDiskVector(const std::string dirname,
+                                                const unsigned int size,
+                                                const bool clean, GridBase *grid,
+                                                const bool verify)
+: dirname_(dirname), size_(size), clean_(clean), verify_(verify), grid_(grid)
+, mapPtr_(new std::vector<Mapping>(size))
 {
     struct stat s;
 
@@ -281,228 +2773,460 @@ DiskVectorBase<T>::DiskVectorBase(const std::string dirname,
         mkdir(dirname);
     }
     if (grid_)  grid_->Barrier();
-    for (unsigned int i = 0; i < cacheSize_; ++i)
+}
+
+template <typename T>
+MappedEigenDiskVector<T>::MappedEigenDiskVector(MappedEigenDiskVector<T> &&v)
+: dirname_(std::move(v.dirname_)), size_(v.size_), clean_(v.clean_)
+, verify_(v.verify_), grid_(v.grid_), mapPtr_(std::move(v.mapPtr_))
+{
+    // the moved-from vector must not remove the directory
+    v.clean_ = false;
+}
+
+template <typename T>
+MappedEigenDiskVector<T>::~MappedEigenDiskVector(void)
+{
+    if (mapPtr_)
     {
-        freePtr_->push(i);
+        for (unsigned int i = 0; i < size_; ++i)
+        {
+            release(i);
+        }
+    }
+    if (clean_)
+    {
+        diskVectorRemoveDir(dirname_, grid_);
     }
-    setSize(size_);
-    setGrid(grid_);
 }
 
 template <typename T>
-DiskVectorBase<T>::~DiskVectorBase(void)
+typename MappedEigenDiskVector<T>::ConstMap 
+MappedEigenDiskVector<T>::operator[](const unsigned int i) const
 {
-    if (clean_)
+    DV_DEBUG_MSG(this, "accessing " << i << " (RO, mapped)");
+
+    if (i >= size_)
     {
-        clean();
+        HADRONS_ERROR(Size, "index out of range");
     }
+
+    auto &m = (*mapPtr_)[i];
+
+    if (m.addr == nullptr)
+    {
+        map(i);
+    }
+
+    return ConstMap(reinterpret_cast<const T *>(
+                        static_cast<const char *>(m.addr) + headerSize),
+                    m.nRow, m.nCol);
 }
 
 template <typename T>
-void DiskVectorBase<T>::setSize(unsigned int size_)
+typename MappedEigenDiskVector<T>::RwAccessHelper 
+MappedEigenDiskVector<T>::operator[](const unsigned int i)
 {
-    dvSize = size_;
+    DV_DEBUG_MSG(this, "accessing " << i << " (RW, mapped)");
+
+    if (i >= size_)
+    {
+        HADRONS_ERROR(Size, "index out of range");
+    }
+
+    return RwAccessHelper(*this, i);
 }
 
 template <typename T>
-unsigned int DiskVectorBase<T>::getSize() const
+T MappedEigenDiskVector<T>::operator()(const unsigned int i, const Eigen::Index j,
+                                       const Eigen::Index k) const
 {
-    return dvSize;
+    return (*this)[i](j, k);
 }
 
 template <typename T>
-void DiskVectorBase<T>::setGrid(GridBase *grid_)
+std::vector<int> MappedEigenDiskVector<T>::dimensions(void) const
 {
-    dvGrid = grid_;
+    std::vector<int> dims(3);
+
+    dims[0] = getSize();
+    dims[1] = (*this)[0].rows();
+    dims[2] = (*this)[0].cols();
+
+    return dims;
 }
 
 template <typename T>
-GridBase *DiskVectorBase<T>::getGrid() const
+void MappedEigenDiskVector<T>::release(const unsigned int i) const
 {
-    return dvGrid;
+    auto &m = (*mapPtr_)[i];
+
+    if (m.addr != nullptr)
+    {
+        DV_DEBUG_MSG(this, "unmapping " << i);
+        munmap(m.addr, m.length);
+        m.addr   = nullptr;
+        m.length = 0;
+    }
 }
 
 template <typename T>
-const T & DiskVectorBase<T>::operator[](const unsigned int i) const
+double MappedEigenDiskVector<T>::mappedBytes(void) const
 {
-    auto &cache   = *cachePtr_;
-    auto &index   = *indexPtr_;
-    auto &freeInd = *freePtr_;
-    auto &loads   = *loadsPtr_;
+    double bytes = 0.;
 
-    DV_DEBUG_MSG(this, "accessing " << i << " (RO)");
+    for (auto &m: *mapPtr_)
+    {
+        bytes += m.length;
+    }
 
-    if (i >= size_)
+    return bytes;
+}
+
+template <typename T>
+unsigned int MappedEigenDiskVector<T>::getSize(void) const
+{
+    return size_;
+}
+
+template <typename T>
+GridBase *MappedEigenDiskVector<T>::getGrid(void) const
+{
+    return grid_;
+}
+
+template <typename T>
+std::string MappedEigenDiskVector<T>::filename(const unsigned int i) const
+{
+    return dirname_ + "/elem_" + std::to_string(i);
+}
+
+template <typename T>
+void MappedEigenDiskVector<T>::map(const unsigned int i) const
+{
+    auto         &m   = (*mapPtr_)[i];
+    std::string  name = filename(i);
+    int          fd;
+    struct stat  s;
+    void         *addr;
+    uint32_t     crc;
+    Eigen::Index nRow, nCol;
+    size_t       matSize;
+
+    fd = open(name.c_str(), O_RDONLY);
+    if (fd < 0)
     {
-        HADRONS_ERROR(Size, "index out of range");
+        HADRONS_ERROR(Io, "cannot open '" + name + "': " + std::string(std::strerror(errno)));
     }
-    const_cast<double &>(access_)++;
-    if (index.find(i) == index.end())
+    if ((fstat(fd, &s) != 0) or (static_cast<size_t>(s.st_size) < headerSize))
     {
-        // cache miss
-        DV_DEBUG_MSG(this, "cache miss");
-        fetch(i);
+        close(fd);
+        HADRONS_ERROR(Io, "'" + name + "' is not a valid mapped disk vector element");
     }
-    else
+    addr = mmap(nullptr, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
     {
-        DV_DEBUG_MSG(this, "cache hit");
-
-        auto pos = std::find(loads.begin(), loads.end(), i);
-
-        const_cast<double &>(hit_)++;
-        loads.erase(pos);
-        loads.push_back(i);
+        HADRONS_ERROR(Io, "cannot map '" + name + "': " + std::string(std::strerror(errno)));
     }
 
-#ifdef DV_DEBUG
-    std::string msg;
+    const char *pt = static_cast<const char *>(addr);
 
-    for (auto &p: loads)
+    std::memcpy(&crc, pt, sizeof(crc));
+    std::memcpy(&nRow, pt + sizeof(uint64_t), sizeof(nRow));
+    std::memcpy(&nCol, pt + 2*sizeof(uint64_t), sizeof(nCol));
+    matSize = nRow*nCol*sizeof(T);
+    if (headerSize + matSize > static_cast<size_t>(s.st_size))
     {
-        msg += std::to_string(p) + " ";
+        munmap(addr, s.st_size);
+        HADRONS_ERROR(Io, "'" + name + "' is truncated");
     }
-    DV_DEBUG_MSG(this, "in cache: " << msg);
+    if (verify_ and !m.verified)
+    {
+        uint32_t check;
+        double   tHash;
+
+        tHash  = -usecond();
+#ifdef USE_IPP
+        check  = GridChecksum::crc32c(pt + headerSize, matSize);
+#else
+        check  = GridChecksum::crc32(pt + headerSize, matSize);
 #endif
-    if (grid_)  grid_->Barrier();
-    return cache[index.at(i)];
+        tHash += usecond();
+        DV_DEBUG_MSG(this, "Eigen crc32 " << std::hex << check << std::dec 
+                     << " " << tHash/1.0e6 << " sec " << matSize/tHash*1.0e6/1024/1024 << " MB/s");
+        if (crc != check)
+        {
+            munmap(addr, s.st_size);
+            HADRONS_ERROR(Io, "checksum failed")
+        }
+    }
+    DV_DEBUG_MSG(this, "mapped " << i << " (" << nRow << "x" << nCol << ")");
+    m.addr     = addr;
+    m.length   = s.st_size;
+    m.nRow     = nRow;
+    m.nCol     = nCol;
+    m.verified = true;
 }
 
+// the file is written under a temporary name and renamed, so that the maps
+// of the previous version held by other processes remain valid
 template <typename T>
-typename DiskVectorBase<T>::RwAccessHelper DiskVectorBase<T>::operator[](const unsigned int i)
+void MappedEigenDiskVector<T>::write(const unsigned int i, const Matrix &obj)
 {
-    DV_DEBUG_MSG(this, "accessing " << i << " (RW)");
+    std::string name = filename(i);
 
-    if (i >= size_)
+    if (!(grid_) || grid_->IsBoss())
     {
-        HADRONS_ERROR(Size, "index out of range");
-    }
+        std::string   tmpName = name + ".tmp";
+        std::ofstream f(tmpName, std::ios::binary);
+        char          header[headerSize] = {0};
+        uint32_t      crc;
+        Eigen::Index  nRow, nCol;
+        size_t        matSize;
+        double        tWrite;
 
-    return RwAccessHelper(*this, i);
+        nRow    = obj.rows();
+        nCol    = obj.cols();
+        matSize = nRow*nCol*sizeof(T);
+#ifdef USE_IPP
+        crc     = GridChecksum::crc32c(obj.data(), matSize);
+#else
+        crc     = GridChecksum::crc32(obj.data(), matSize);
+#endif
+        std::memcpy(header, &crc, sizeof(crc));
+        std::memcpy(header + sizeof(uint64_t), &nRow, sizeof(nRow));
+        std::memcpy(header + 2*sizeof(uint64_t), &nCol, sizeof(nCol));
+        tWrite  = -usecond();
+        f.write(header, headerSize);
+        f.write(reinterpret_cast<const char *>(obj.data()), matSize);
+        f.close();
+        tWrite += usecond();
+        if (!f)
+        {
+            HADRONS_ERROR(Io, "cannot write '" + tmpName + "'");
+        }
+        if (std::rename(tmpName.c_str(), name.c_str()) != 0)
+        {
+            HADRONS_ERROR(Io, "cannot rename '" + tmpName + "': " + std::string(std::strerror(errno)));
+        }
+        DV_DEBUG_MSG(this, "Eigen write " << tWrite/1.0e6 << " sec " << matSize/tWrite*1.0e6/1024/1024 << " MB/s");
+    }
+    if (grid_)  grid_->Barrier();
+    release(i);
+    (*mapPtr_)[i].verified = false;
 }
 
+#ifdef DV_DEBUG
+#undef DV_DEBUG_MSG
+#endif
+
+// process which owns the directory and its manifest
 template <typename T>
-double DiskVectorBase<T>::hitRatio(void) const
+bool DiskVectorBase<T>::manifestRank(void) const
 {
-    return hit_/access_;
+    return !(grid_) || sharded_ || grid_->IsBoss();
 }
 
+// the store is locked before reading its manifest, the size is read by the 
+// owning process and broadcast to the others when the directory is shared
 template <typename T>
-void DiskVectorBase<T>::resetStat(void)
+void DiskVectorBase<T>::openStore(void)
 {
-    access_ = 0.;
-    hit_    = 0.;
+    unsigned int size = 0;
+
+    if (dirname_.empty())
+    {
+        HADRONS_ERROR(Argument, "opening a disk vector store needs a directory");
+    }
+    if (manifestRank())
+    {
+        struct stat s;
+
+        if (stat(dirname_.c_str(), &s) != 0)
+        {
+            HADRONS_ERROR(Io, "disk vector store '" + dirname_ + "' does not exist");
+        }
+        // the destructor does not run if the constructor fails
+        lockStore();
+        try
+        {
+            size = readManifest();
+        }
+        catch (...)
+        {
+            unlockStore();
+            throw;
+        }
+    }
+    if (grid_ and !sharded_)
+    {
+        grid_->Broadcast(grid_->BossRank(), &size, sizeof(size));
+    }
+    if (size_ == 0)
+    {
+        size_ = size;
+        lruPtr_.reset(new DiskVectorLru(size_, cacheSize_));
+    }
+    else if (size_ != size)
+    {
+        unlockStore();
+        HADRONS_ERROR(Size, "disk vector store '" + dirname_ + "' has " 
+                      + std::to_string(size) + " element(s) (expected " 
+                      + std::to_string(size_) + ")");
+    }
+    if (!manifestRank())
+    {
+        manifestPtr_->present.assign(size_, false);
+        manifestPtr_->info.assign(size_, "");
+    }
+    clean_ = false;
 }
 
+// manifest format: a version line, then type, size, the codec if any and one
+// elem line per saved element, followed by its information
 template <typename T>
-std::string DiskVectorBase<T>::filename(const unsigned int i) const
+unsigned int DiskVectorBase<T>::readManifest(void)
 {
-    return dirname_ + "/elem_" + std::to_string(i);
+    auto          &manifest = *manifestPtr_;
+    std::string   filename  = dirname_ + "/manifest", line, key, type;
+    std::ifstream f(filename);
+    unsigned int  version = 0, size = 0, i;
+
+    if (!f.good())
+    {
+        HADRONS_ERROR(Io, "cannot open manifest '" + filename + "'");
+    }
+    std::getline(f, line);
+    std::istringstream(line) >> key >> version;
+    if ((key != "hadrons-diskvector") or (version != 1))
+    {
+        HADRONS_ERROR(Io, "'" + filename + "' is not a disk vector manifest (version 1)");
+    }
+    while (std::getline(f, line))
+    {
+        std::istringstream in(line);
+
+        in >> key;
+        if (key == "type")
+        {
+            std::getline(in >> std::ws, type);
+        }
+        else if (key == "size")
+        {
+            in >> size;
+            manifest.present.assign(size, false);
+            manifest.info.assign(size, "");
+        }
+        else if (key == "codec")
+        {
+            std::getline(in >> std::ws, line);
+            codec_ = makeDiskVectorCodec(line);
+        }
+        else if (key == "elem")
+        {
+            if (!(in >> i) or (i >= size))
+            {
+                HADRONS_ERROR(Io, "invalid element in manifest '" + filename 
+                              + "': '" + line + "'");
+            }
+            manifest.present[i] = true;
+            std::getline(in >> std::ws, manifest.info[i]);
+        }
+    }
+    if (type != typeName<T>())
+    {
+        HADRONS_ERROR(Argument, "disk vector store '" + dirname_ + "' contains '"
+                      + type + "' elements (expected '" + typeName<T>() + "')");
+    }
+
+    return size;
 }
 
+// the manifest is replaced atomically, readers never see a partial one
 template <typename T>
-void DiskVectorBase<T>::evict(void) const
+void DiskVectorBase<T>::writeManifest(void) const
 {
-    auto &cache    = *cachePtr_;
-    auto &modified = *modifiedPtr_;
-    auto &index    = *indexPtr_;
-    auto &freeInd  = *freePtr_;
-    auto &loads    = *loadsPtr_;
+    auto                        &manifest = *manifestPtr_;
+    std::string                 filename  = dirname_ + "/manifest";
+    std::ofstream               f(filename + ".tmp");
+    std::lock_guard<std::mutex> guard(manifest.mutex);
 
-    if (index.size() >= cacheSize_)
+    f << "hadrons-diskvector 1" << std::endl;
+    f << "type " << typeName<T>() << std::endl;
+    f << "size " << size_ << std::endl;
+    if (codec_)
     {
-        unsigned int i = loads.front();
-        
-        DV_DEBUG_MSG(this, "evicting " << i);
-        if (modified[index.at(i)])
+        f << "codec " << codec_->name() << std::endl;
+    }
+    for (unsigned int i = 0; i < size_; ++i)
+    {
+        if (manifest.present[i])
         {
-            DV_DEBUG_MSG(this, "element " << i << " modified, saving to disk");
-            save(filename(i), cache[index.at(i)]);
+            f << "elem " << i;
+            if (!manifest.info[i].empty())
+            {
+                f << " " << manifest.info[i];
+            }
+            f << std::endl;
         }
-        freeInd.push(index.at(i));
-        index.erase(i);
-        loads.pop_front();
     }
-    if (grid_)  grid_->Barrier();
+    f.close();
+    if (!f.good() or (rename((filename + ".tmp").c_str(), filename.c_str()) != 0))
+    {
+        HADRONS_ERROR(Io, "cannot write manifest '" + filename + "'");
+    }
 }
 
+// the lock is held until the vector is closed, it fails instead of waiting
+// if the store is used by a writer, or by anybody when writing
 template <typename T>
-void DiskVectorBase<T>::fetch(const unsigned int i) const
+void DiskVectorBase<T>::lockStore(void)
 {
-    auto &cache    = *cachePtr_;
-    auto &modified = *modifiedPtr_;
-    auto &index    = *indexPtr_;
-    auto &freeInd  = *freePtr_;
-    auto &loads    = *loadsPtr_;
-
-    struct stat s;
-
-    DV_DEBUG_MSG(this, "loading " << i << " from disk");
+    auto        &manifest = *manifestPtr_;
+    std::string filename  = dirname_ + "/lock";
+    bool        shared    = (mode_ == DiskVectorMode::read);
 
-    evict();
-    
-    if(stat(filename(i).c_str(), &s) != 0)
+    manifest.lockFd = shared ? open(filename.c_str(), O_RDONLY)
+                             : open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (manifest.lockFd < 0)
     {
-        HADRONS_ERROR(Io, "disk vector element " + std::to_string(i) + " uninitialised");
+        HADRONS_ERROR(Io, "cannot open '" + filename + "': " 
+                      + std::string(std::strerror(errno)));
+    }
+    if (flock(manifest.lockFd, (shared ? LOCK_SH : LOCK_EX) | LOCK_NB) != 0)
+    {
+        ::close(manifest.lockFd);
+        manifest.lockFd = -1;
+        HADRONS_ERROR(Io, "disk vector store '" + dirname_ + "' is in use");
     }
-    index[i] = freeInd.top();
-    freeInd.pop();
-    load(cache[index.at(i)], filename(i));
-    loads.push_back(i);
-    modified[index.at(i)] = false;
 }
 
 template <typename T>
-void DiskVectorBase<T>::cacheInsert(const unsigned int i, const T &obj) const
+void DiskVectorBase<T>::unlockStore(void)
 {
-    auto &cache    = *cachePtr_;
-    auto &modified = *modifiedPtr_;
-    auto &index    = *indexPtr_;
-    auto &freeInd  = *freePtr_;
-    auto &loads    = *loadsPtr_;
-
-    evict();
-    index[i] = freeInd.top();
-    freeInd.pop();
-    cache[index.at(i)] = obj;
-    loads.push_back(i);
-    modified[index.at(i)] = false;
-
-    if (grid_)  grid_->Barrier();
-#ifdef DV_DEBUG
-    std::string msg;
-
-    for (auto &p: loads)
+    // manifestPtr_ is null in a moved-from vector
+    if (manifestPtr_ and (manifestPtr_->lockFd >= 0))
     {
-        msg += std::to_string(p) + " ";
+        ::close(manifestPtr_->lockFd);
+        manifestPtr_->lockFd = -1;
     }
-    DV_DEBUG_MSG(this, "in cache: " << msg);
-#endif
 }
 
-#ifdef DV_DEBUG
-#undef DV_DEBUG_MSG
-#endif
-
+// in sharded mode each process removes its own directory, and the parent
+// directory once empty
 template <typename T>
 void DiskVectorBase<T>::clean(void)
 {
-    if (!(grid_) || grid_->IsBoss())
+    if (sharded_)
     {
-        auto unlink = [](const char *fpath, const struct stat *sb,
-                         int typeflag, struct FTW *ftwbuf) {
-            int rv = remove(fpath);
-
-            if (rv)
-            {
-                HADRONS_ERROR(Io, "cannot remove '" + std::string(fpath) + "': " + std::string(std::strerror(errno)));
-            }
-
-            return rv;
-        };
-
-        nftw(dirname_.c_str(), unlink, 64, FTW_DEPTH | FTW_PHYS);
+        diskVectorRemoveDir(dirname_, nullptr);
+        rmdir(dirname(dirname_).c_str());
+    }
+    else
+    {
+        diskVectorRemoveDir(dirname_, grid_);
     }
-    if (grid_)  grid_->Barrier();
 }
 
 END_HADRONS_NAMESPACE
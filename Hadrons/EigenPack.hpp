@@ -30,6 +30,7 @@
 #include <Hadrons/Global.hpp>
 #include <Grid/algorithms/iterative/Deflation.h>
 #include <Grid/algorithms/iterative/LocalCoherenceLanczos.h>
+#include <future>
 
 BEGIN_HADRONS_NAMESPACE
 
@@ -97,45 +98,314 @@ namespace EigenPackIo
         eval = vecRecord.eval;
     }
 
+    inline std::string vecFilename(const std::string &dirname, const unsigned int k)
+    {
+        return dirname + "/v" + std::to_string(k) + ".bin";
+    }
+
+    // conversion between the vector and I/O types
+    template <typename T>
+    void convert(T &out, const T &in)
+    {
+        out = in;
+    }
+
+    template <typename TOut, typename TIn>
+    void convert(TOut &out, const TIn &in)
+    {
+        precisionChange(out, in);
+    }
+
+    // I/O groups: the processor grid is divided in nGroup groups of processes,
+    // each group holding full fields on a sub-communicator (Grid split grids)
+    class IoGroups
+    {
+    public:
+        IoGroups(GridBase *grid, const unsigned int nGroup)
+        : nGroup_(nGroup)
+        {
+            Coordinate            split = grid->_processors;
+            unsigned int          n     = nGroup;
+            GridCartesian         *full = dynamic_cast<GridCartesian *>(grid);
+            GridRedBlackCartesian *rb   = dynamic_cast<GridRedBlackCartesian *>(grid);
+
+            // the factors of nGroup divide the dimensions with the most 
+            // processes, starting from the last ones
+            for (unsigned int p = 2; n > 1; )
+            {
+                int best = -1;
+
+                if (n % p)
+                {
+                    p++;
+                    continue;
+                }
+                for (int d = split.size() - 1; d >= 0; --d)
+                {
+                    if ((split[d] % p == 0) and ((best < 0) or (split[d] > split[best])))
+                    {
+                        best = d;
+                    }
+                }
+                if (best < 0)
+                {
+                    std::ostringstream procs;
+
+                    procs << grid->_processors;
+                    HADRONS_ERROR(Size, "cannot divide the processor grid " + procs.str()
+                                  + " in " + std::to_string(nGroup) + " I/O groups");
+                }
+                split[best] /= p;
+                n           /= p;
+            }
+            // a red-black grid does not give access to its full grid, which
+            // is rebuilt with the same processor layout
+            if (!full)
+            {
+                full_.reset(new GridCartesian(grid->FullDimensions(), grid->_simd_layout,
+                                              grid->_processors));
+                full = full_.get();
+            }
+            split_.reset(new GridCartesian(grid->FullDimensions(), grid->_simd_layout,
+                                           split, *full));
+            if (rb)
+            {
+                splitRb_.reset(new GridRedBlackCartesian(split_.get(), rb->_checker_dim_mask,
+                                                         rb->_checker_dim));
+            }
+        }
+
+        // grid of the fields held by a group
+        GridBase *grid(void) const
+        {
+            return splitRb_ ? static_cast<GridBase *>(splitRb_.get()) : split_.get();
+        }
+
+        unsigned int size(void) const
+        {
+            return nGroup_;
+        }
+
+        // index n of the group of this process, such that Grid_split sends
+        // it the field n, it is measured by splitting constant fields
+        template <typename Field>
+        unsigned int index(GridBase *fullGrid) const
+        {
+            typedef typename Field::vector_type                Vector;
+            typedef typename Field::scalar_type                Scalar;
+            typedef Lattice<iScalar<iScalar<iScalar<Vector>>>> Marker;
+
+            std::vector<Marker> marker(nGroup_, fullGrid);
+            Marker              splitMarker(grid());
+
+            for (unsigned int n = 0; n < nGroup_; ++n)
+            {
+                marker[n] = Scalar(n);
+            }
+            Grid_split(marker, splitMarker);
+
+            return static_cast<unsigned int>(
+                std::round(real(TensorRemove(sum(splitMarker)))/grid()->gSites()));
+        }
+    private:
+        unsigned int                           nGroup_;
+        std::unique_ptr<GridCartesian>         full_, split_;
+        std::unique_ptr<GridRedBlackCartesian> splitRb_;
+    };
+
+    // reading ahead in the background communicates from two threads at 
+    // once, which needs MPI initialised with MPI_THREAD_MULTIPLE
+    inline bool readAheadSupported(void)
+    {
+#if defined(GRID_COMMS_MPI) || defined(GRID_COMMS_MPI3) || defined(GRID_COMMS_MPIT)
+        int level;
+
+        MPI_Query_thread(&level);
+
+        return (level == MPI_THREAD_MULTIPLE);
+#elif defined(GRID_COMMS_NONE)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    inline bool readAheadEnabled(const bool readAhead)
+    {
+        if (readAhead and !readAheadSupported())
+        {
+            LOG(Warning) << "eigenpack read-ahead needs MPI_THREAD_MULTIPLE, "
+                         << "reading sequentially" << std::endl;
+
+            return false;
+        }
+
+        return readAhead;
+    }
+
+    // each group reads one vector of a batch of ioGroups vectors on its
+    // sub-communicator, the batch is then redistributed with Grid_unsplit. 
+    // With readAhead, the next batch is read in the background while the 
+    // current one is converted, the conversion needs no communication.
+    template <typename T, typename TIo = T>
+    void readPackGroups(std::vector<T> &evec, std::vector<RealD> &eval,
+                        PackRecord &record, const std::string dirname, 
+                        const unsigned int size, GridBase *ioGrid,
+                        const unsigned int ioGroups, const bool readAhead)
+    {
+        IoGroups           groups(ioGrid, ioGroups);
+        unsigned int       g      = groups.index<TIo>(ioGrid);
+        unsigned int       nBatch = (size + ioGroups - 1)/ioGroups;
+        std::vector<TIo>   full(ioGroups, ioGrid), split(2, groups.grid());
+        std::vector<RealD> batchEval(ioGroups), groupEval(2);
+        std::future<void>  next;
+
+        auto readBatch = [&](const unsigned int b)
+        {
+            unsigned int k = b*ioGroups + g;
+
+            groupEval[b % 2] = 0.;
+            if (k < size)
+            {
+                ScidacReader binReader;
+
+                binReader.open(vecFilename(dirname, k));
+                readHeader(record, binReader);
+                readElement<TIo>(split[b % 2], groupEval[b % 2], k, binReader);
+                binReader.close();
+            }
+        };
+
+        LOG(Message) << "Reading with " << ioGroups << " I/O groups of " 
+                     << groups.grid()->ProcessorCount() << " process(es)" << std::endl;
+        if (readAhead)
+        {
+            next = std::async(std::launch::async, readBatch, 0);
+        }
+        for (unsigned int b = 0; b < nBatch; ++b)
+        {
+            if (readAhead)
+            {
+                next.get();
+            }
+            else
+            {
+                readBatch(b);
+            }
+            Grid_unsplit(full, split[b % 2]);
+            std::fill(batchEval.begin(), batchEval.end(), 0.);
+            if (groups.grid()->IsBoss())
+            {
+                batchEval[g] = groupEval[b % 2];
+            }
+            ioGrid->GlobalSumVector(batchEval.data(), ioGroups);
+            if (readAhead and (b + 1 < nBatch))
+            {
+                next = std::async(std::launch::async, readBatch, b + 1);
+            }
+            for (unsigned int n = 0; (n < ioGroups) and (b*ioGroups + n < size); ++n)
+            {
+                convert(evec[b*ioGroups + n], full[n]);
+                eval[b*ioGroups + n] = batchEval[n];
+            }
+        }
+    }
+
+    template <typename T, typename TIo = T>
+    void readVector(T &vec, RealD &ev, PackRecord &record, 
+                    const std::string filename, const unsigned int k, 
+                    const bool multiFile, ScidacReader &binReader,
+                    TIo *ioBuf = nullptr)
+    {
+        if (multiFile)
+        {
+            ScidacReader fileReader;
+
+            fileReader.open(vecFilename(filename, k));
+            readHeader(record, fileReader);
+            readElement(vec, ev, k, fileReader, ioBuf);
+            fileReader.close();
+        }
+        else
+        {
+            readElement(vec, ev, k, binReader, ioBuf);
+        }
+    }
+
+    // the vectors are read one after the other, unless ioGroups > 1 for a 
+    // multi-file pack (see readPackGroups). With readAhead and a different 
+    // I/O type, the next vector is read in the background while the current
+    // one is converted, if MPI supports it (see readAheadSupported).
     template <typename T, typename TIo = T>
     static void readPack(std::vector<T> &evec, std::vector<RealD> &eval,
                          PackRecord &record, const std::string filename, 
                          const unsigned int size, bool multiFile, 
-                         GridBase *gridIo = nullptr)
+                         GridBase *gridIo = nullptr, const unsigned int ioGroups = 1,
+                         const bool readAhead = false)
     {
-        std::unique_ptr<TIo> ioBuf{nullptr};
-        ScidacReader         binReader;
+        bool             convertIo = (typeHash<T>() != typeHash<TIo>());
+        bool             ahead     = readAheadEnabled(readAhead);
+        std::vector<TIo> ioBuf;
+        ScidacReader     binReader;
 
-        if (typeHash<T>() != typeHash<TIo>())
+        if (convertIo)
         {
             if (gridIo == nullptr)
             {
                 HADRONS_ERROR(Definition, 
                               "I/O type different from vector type but null I/O grid passed");
             }
-            ioBuf.reset(new TIo(gridIo));
         }
-        if (multiFile)
+        if (multiFile and (ioGroups > 1))
         {
-            std::string fullFilename;
+            readPackGroups<T, TIo>(evec, eval, record, filename, size, 
+                                   convertIo ? gridIo : evec[0].Grid(), ioGroups,
+                                   ahead);
 
+            return;
+        }
+        if (!multiFile)
+        {
+            binReader.open(filename);
+            readHeader(record, binReader);
+        }
+        if (ahead and convertIo and (size > 0))
+        {
+            std::future<void> next;
+
+            ioBuf.resize(2, gridIo);
+            next = std::async(std::launch::async, [&](void)
+            {
+                readVector(ioBuf[0], eval[0], record, filename, 0, multiFile, binReader);
+            });
             for(int k = 0; k < size; ++k) 
             {
-                fullFilename = filename + "/v" + std::to_string(k) + ".bin";
-                binReader.open(fullFilename);
-                readHeader(record, binReader);
-                readElement(evec[k], eval[k], k, binReader, ioBuf.get());
-                binReader.close();
+                next.get();
+                if (k + 1 < size)
+                {
+                    next = std::async(std::launch::async, [&, k](void)
+                    {
+                        readVector(ioBuf[(k + 1) % 2], eval[k + 1], record, filename,
+                                   k + 1, multiFile, binReader);
+                    });
+                }
+                precisionChange(evec[k], ioBuf[k % 2]);
             }
         }
         else
         {
-            binReader.open(filename);
-            readHeader(record, binReader);
+            if (convertIo)
+            {
+                ioBuf.resize(1, gridIo);
+            }
             for(int k = 0; k < size; ++k) 
             {
-                readElement(evec[k], eval[k], k, binReader, ioBuf.get());
+                readVector(evec[k], eval[k], record, filename, k, multiFile, 
+                           binReader, convertIo ? &ioBuf[0] : nullptr);
             }
+        }
+        if (!multiFile)
+        {
             binReader.close();
         }
     }
@@ -173,24 +443,86 @@ namespace EigenPackIo
         }   
     }
     
+    // each group writes one vector of a batch of ioGroups vectors on its 
+    // sub-communicator, after distributing the batch with Grid_split, the
+    // precision loss is checked when the batch is converted
+    template <typename T, typename TIo = T>
+    void writePackGroups(const std::string dirname, std::vector<T> &evec, 
+                         std::vector<RealD> &eval, PackRecord &record, 
+                         const unsigned int size, GridBase *ioGrid,
+                         const unsigned int ioGroups)
+    {
+        IoGroups           groups(ioGrid, ioGroups);
+        unsigned int       g      = groups.index<TIo>(ioGrid);
+        unsigned int       nBatch = (size + ioGroups - 1)/ioGroups;
+        std::vector<TIo>   full(ioGroups, ioGrid);
+        TIo                split(groups.grid());
+        std::unique_ptr<T> testBuf{nullptr};
+
+        if (typeHash<T>() != typeHash<TIo>())
+        {
+            testBuf.reset(new T(evec[0].Grid()));
+        }
+        LOG(Message) << "Writing with " << ioGroups << " I/O groups of " 
+                     << groups.grid()->ProcessorCount() << " process(es)" << std::endl;
+        makeFileDir(vecFilename(dirname, 0), evec[0].Grid());
+        for (unsigned int b = 0; b < nBatch; ++b)
+        {
+            unsigned int k = b*ioGroups + g;
+
+            for (unsigned int n = 0; (n < ioGroups) and (b*ioGroups + n < size); ++n)
+            {
+                convert(full[n], evec[b*ioGroups + n]);
+                if (testBuf)
+                {
+                    convert(*testBuf, full[n]);
+                    *testBuf -= evec[b*ioGroups + n];
+                    LOG(Message) << "Eigenvector " << b*ioGroups + n 
+                                 << " precision diff norm^2 " << norm2(*testBuf) << std::endl;
+                }
+            }
+            Grid_split(full, split);
+            if (k < size)
+            {
+                ScidacWriter binWriter(groups.grid()->IsBoss());
+
+                binWriter.open(vecFilename(dirname, k));
+                writeHeader(binWriter, record);
+                writeElement(binWriter, split, eval[k], k, static_cast<TIo *>(nullptr));
+                binWriter.close();
+            }
+        }
+    }
+    
     template <typename T, typename TIo = T>
     static void writePack(const std::string filename, std::vector<T> &evec, 
                           std::vector<RealD> &eval, PackRecord &record, 
                           const unsigned int size, bool multiFile, 
-                          GridBase *gridIo = nullptr)
+                          GridBase *gridIo = nullptr, const unsigned int ioGroups = 1)
     {
-        GridBase             *grid = evec[0].Grid();
+        GridBase *grid      = evec[0].Grid();
+        bool     convertIo = (typeHash<T>() != typeHash<TIo>());
+
+        if (convertIo and (gridIo == nullptr))
+        {
+            HADRONS_ERROR(Definition, 
+                          "I/O type different from vector type but null I/O grid passed");
+        }
+        if (multiFile and (ioGroups > 1))
+        {
+            writePackGroups<T, TIo>(filename, evec, eval, record, size, 
+                                    convertIo ? gridIo : grid, ioGroups);
+
+            return;
+        }
+
+        // sequential writes, through one I/O buffer if the types differ
         std::unique_ptr<TIo> ioBuf{nullptr}; 
         std::unique_ptr<T>   testBuf{nullptr};
         ScidacWriter         binWriter(grid->IsBoss());
 
-        if (typeHash<T>() != typeHash<TIo>())
+        if (convertIo)
         {
-            if (gridIo == nullptr)
-            {
-                HADRONS_ERROR(Definition, 
-                              "I/O type different from vector type but null I/O grid passed");
-            }
             ioBuf.reset(new TIo(gridIo));
             testBuf.reset(new T(grid));
         }
@@ -200,7 +532,7 @@ namespace EigenPackIo
 
             for(int k = 0; k < size; ++k) 
             {
-                fullFilename = filename + "/v" + std::to_string(k) + ".bin";
+                fullFilename = vecFilename(filename, k);
 
                 makeFileDir(fullFilename, grid);
                 binWriter.open(fullFilename);
@@ -274,7 +606,8 @@ public:
     {
         EigenPackIo::readPack<F, FIo>(this->evec, this->eval, this->record, 
                                       evecFilename(fileStem, traj, multiFile), 
-                                      this->evec.size(), multiFile, gridIo_);
+                                      this->evec.size(), multiFile, gridIo_, ioGroups_,
+                                      readAhead_);
         HADRONS_DUMP_EP_METADATA(this->record);
     }
 
@@ -282,7 +615,21 @@ public:
     {
         EigenPackIo::writePack<F, FIo>(evecFilename(fileStem, traj, multiFile), 
                                        this->evec, this->eval, this->record, 
-                                       this->evec.size(), multiFile, gridIo_);
+                                       this->evec.size(), multiFile, gridIo_, ioGroups_);
+    }
+
+    // number of process groups reading/writing multi-file packs concurrently,
+    // it must divide the processor grid
+    void setIoGroups(const unsigned int ioGroups)
+    {
+        ioGroups_ = std::max(ioGroups, 1u);
+    }
+
+    // read the next vector (or batch of vectors) in the background while 
+    // the current one is converted, only with MPI_THREAD_MULTIPLE
+    void setReadAhead(const bool readAhead)
+    {
+        readAhead_ = readAhead;
     }
 protected:
     std::string evecFilename(const std::string stem, const int traj, const bool multiFile)
@@ -299,7 +646,9 @@ protected:
         }
     }
 protected:
-    GridBase *gridIo_;
+    GridBase     *gridIo_;
+    unsigned int ioGroups_{1};
+    bool         readAhead_{false};
 };
 
 template <typename FineF, typename CoarseF, 
@@ -361,7 +710,8 @@ public:
 
         EigenPackIo::readPack<CoarseF, CoarseFIo>(evecCoarse, evalCoarse, dummy, 
                               this->evecFilename(fileStem + "_coarse", traj, multiFile), 
-                              evecCoarse.size(), multiFile, gridCoarseIo_);
+                              evecCoarse.size(), multiFile, gridCoarseIo_,
+                              this->ioGroups_, this->readAhead_);
     }
 
     virtual void read(const std::string fileStem, const bool multiFile, const int traj = -1)
@@ -379,7 +729,8 @@ public:
     {
         EigenPackIo::writePack<CoarseF, CoarseFIo>(this->evecFilename(fileStem + "_coarse", traj, multiFile), 
                                                    evecCoarse, evalCoarse, this->record, 
-                                                   evecCoarse.size(), multiFile, gridCoarseIo_);
+                                                   evecCoarse.size(), multiFile, gridCoarseIo_,
+                                                   this->ioGroups_);
     }
     
     virtual void write(const std::string fileStem, const bool multiFile, const int traj = -1)
@@ -138,6 +138,19 @@ void Environment::setObjectModule(const unsigned int objAddress,
     }
 }
 
+void Environment::addObjectUser(const unsigned int objAddress,
+                                const int modAddress)
+{
+    if (hasObject(objAddress))
+    {
+        object_[objAddress].users.insert(modAddress);
+    }
+    else
+    {
+        ERROR_NO_ADDRESS(objAddress);
+    }
+}
+
 unsigned int Environment::getMaxAddress(void) const
 {
     return object_.size();
@@ -283,6 +296,18 @@ unsigned int Environment::getObjectLs(const std::string name) const
     return getObjectLs(getObjectAddress(name));
 }
 
+const std::set<int> & Environment::getObjectUsers(const unsigned int address) const
+{
+    if (hasObject(address))
+    {
+        return object_[address].users;
+    }
+    else
+    {
+        ERROR_NO_ADDRESS(address);
+    }
+}
+
 bool Environment::hasObject(const unsigned int address) const
 {
     return (address < object_.size());
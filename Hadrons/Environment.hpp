@@ -29,6 +29,7 @@
 #define Hadrons_Environment_hpp_
 
 #include <Hadrons/Global.hpp>
+#include <Hadrons/MomentumPhase.hpp>
 
 BEGIN_HADRONS_NAMESPACE
 
@@ -74,7 +75,7 @@ public:
     typedef std::unique_ptr<GridRedBlackCartesian> GridRbPt;
     typedef std::unique_ptr<GridParallelRNG>       RngPt;
     typedef std::unique_ptr<GridSerialRNG>         SerialRngPt;
-    GRID_SERIALIZABLE_ENUM(Storage, undef, standard, 0, cache, 1, temporary, 2);
+    GRID_SERIALIZABLE_ENUM(Storage, undef, standard, 0, cache, 1, temporary, 2, shared, 3);
 private:
     struct ObjInfo
     {
@@ -84,6 +85,7 @@ private:
         const std::type_info    *type{nullptr}, *derivedType{nullptr};
         std::string             name;
         int                     module{-1};
+        std::set<int>           users;
         std::unique_ptr<Object> data{nullptr};
     };
     typedef std::pair<size_t, unsigned int>     FineGridKey;
@@ -132,6 +134,8 @@ public:
                                              const Environment::Storage storage);
     void                    setObjectModule(const unsigned int objAddress,
                                             const int modAddress);
+    void                    addObjectUser(const unsigned int objAddress,
+                                          const int modAddress);
     template <typename B, typename T>
     T *                     getDerivedObject(const unsigned int address) const;
     template <typename B, typename T>
@@ -155,6 +159,7 @@ public:
     int                     getObjectModule(const std::string name) const;
     unsigned int            getObjectLs(const unsigned int address) const;
     unsigned int            getObjectLs(const std::string name) const;
+    const std::set<int> &   getObjectUsers(const unsigned int address) const;
     bool                    hasObject(const unsigned int address) const;
     bool                    hasObject(const std::string name) const;
     bool                    hasCreatedObject(const unsigned int address) const;
@@ -171,6 +176,21 @@ public:
     void                    freeAll(void);
     void                    protectObjects(const bool protect);
     bool                    objectsProtected(void) const;
+    // momentum phases shared between modules
+    template <typename Field>
+    std::string             getMomentumPhaseName(const std::vector<Real> &p) const;
+    template <typename Field>
+    void                    createMomentumPhase(const std::vector<Real> &p,
+                                                const int moduleAddress = -1);
+    template <typename Field>
+    const Field &           getMomentumPhase(const std::vector<Real> &p);
+    template <typename Field>
+    std::string             getMomentumPhaseSetName(const std::vector<std::vector<Real>> &p) const;
+    template <typename Field>
+    void                    createMomentumPhaseSet(const std::vector<std::vector<Real>> &p,
+                                                   const int moduleAddress = -1);
+    template <typename Field>
+    const std::vector<Field> & getMomentumPhaseSet(const std::vector<std::vector<Real>> &p);
     // print environment content
     void                    printContent(void) const;
 private:
@@ -472,9 +492,11 @@ void Environment::createDerivedObject(const std::string name,
             MemoryProfiler::stats = nullptr;
         }
     }
-    // object already exists, no error if it is a cache, error otherwise
-    else if ((object_[address].storage               != Storage::cache) or 
-             (object_[address].storage               != storage)        or
+    // object already exists, no error if it is a cache or shared,
+    // error otherwise
+    else if (((object_[address].storage              != Storage::cache)  and
+              (object_[address].storage              != Storage::shared)) or 
+             (object_[address].storage               != storage)         or
              (object_[address].name                  != name)           or
              (typeHash(object_[address].type)        != typeHash<B>())  or
              (typeHash(object_[address].derivedType) != typeHash<T>()))
@@ -586,6 +608,83 @@ bool Environment::isObjectOfType(const std::string name) const
     return isObjectOfType<T>(getObjectAddress(name));
 }
 
+// momentum phases /////////////////////////////////////////////////////////////
+template <typename Field>
+std::string Environment::getMomentumPhaseName(const std::vector<Real> &p) const
+{
+    std::ostringstream name;
+
+    // phases are keyed by grid type and momentum (padded with zeros, so that
+    // spatial and space-time momenta with p_t = 0 share the same field)
+    name << "_momph_" << typeHash<typename Field::vector_type>();
+    for (unsigned int mu = 0; mu < getNd(); ++mu)
+    {
+        name << "_" << ((mu < p.size()) ? p[mu] : 0.);
+    }
+
+    return name.str();
+}
+
+template <typename Field>
+void Environment::createMomentumPhase(const std::vector<Real> &p,
+                                      const int moduleAddress)
+{
+    std::string name = getMomentumPhaseName<Field>(p);
+
+    createObject<MomentumPhase<Field>>(name, Storage::shared, 1,
+                                       getGrid<typename Field::vector_type>(), p);
+    if (moduleAddress >= 0)
+    {
+        addObjectUser(getObjectAddress(name), moduleAddress);
+    }
+}
+
+template <typename Field>
+const Field & Environment::getMomentumPhase(const std::vector<Real> &p)
+{
+    return getObject<MomentumPhase<Field>>(getMomentumPhaseName<Field>(p))->get();
+}
+
+template <typename Field>
+std::string Environment::getMomentumPhaseSetName(const std::vector<std::vector<Real>> &p) const
+{
+    std::ostringstream name;
+
+    // sets are keyed by grid type and ordered list of momenta (padded as 
+    // above), only modules using the same list share a set
+    name << "_momphset_" << typeHash<typename Field::vector_type>();
+    for (auto &pm: p)
+    {
+        name << "_";
+        for (unsigned int mu = 0; mu < getNd(); ++mu)
+        {
+            name << "_" << ((mu < pm.size()) ? pm[mu] : 0.);
+        }
+    }
+
+    return name.str();
+}
+
+template <typename Field>
+void Environment::createMomentumPhaseSet(const std::vector<std::vector<Real>> &p,
+                                         const int moduleAddress)
+{
+    std::string name = getMomentumPhaseSetName<Field>(p);
+
+    createObject<MomentumPhaseSet<Field>>(name, Storage::shared, 1,
+                                          getGrid<typename Field::vector_type>(), p);
+    if (moduleAddress >= 0)
+    {
+        addObjectUser(getObjectAddress(name), moduleAddress);
+    }
+}
+
+template <typename Field>
+const std::vector<Field> & Environment::getMomentumPhaseSet(const std::vector<std::vector<Real>> &p)
+{
+    return getObject<MomentumPhaseSet<Field>>(getMomentumPhaseSetName<Field>(p))->get();
+}
+
 END_HADRONS_NAMESPACE
 
 #endif // Hadrons_Environment_hpp_
@@ -134,6 +134,18 @@ envCache(type, name, Ls, envGetGrid(type, Ls))
 #define envCacheLat(...)\
 HADRONS_MACRO_REDIRECT_23(__VA_ARGS__, envCacheLat5, envCacheLat4)(__VA_ARGS__)
 
+#define envCacheMomentumPhase(latticeType, p)\
+env().template createMomentumPhase<latticeType>(p, vm().getCurrentModule())
+
+#define envGetMomentumPhase(latticeType, p)\
+env().template getMomentumPhase<latticeType>(p)
+
+#define envCacheMomentumPhaseSet(latticeType, p)\
+env().template createMomentumPhaseSet<latticeType>(p, vm().getCurrentModule())
+
+#define envGetMomentumPhaseSet(latticeType, p)\
+env().template getMomentumPhaseSet<latticeType>(p)
+
 #define envTmp(type, name, Ls, ...)\
 env().template createObject<type>(getName() + "_tmp_" + name,         \
                                   Environment::Storage::temporary, Ls, __VA_ARGS__)
@@ -109,6 +109,9 @@ public:
                                       FermionField, 
                                       A2AAslashFieldMetadata, 
                                       HADRONS_A2AM_IO_TYPE> Computation;
+    typedef A2AMatrixBlockTuner<Complex, 
+                                FermionField, 
+                                HADRONS_A2AM_IO_TYPE> Tuner;
     typedef AslashFieldKernel<Complex, FImpl> Kernel;
 public:
     // constructor
@@ -122,6 +125,8 @@ public:
     virtual void setup(void);
     // execution
     virtual void execute(void);
+private:
+    A2AMatrixBlockTuneState tuneState_;
 };
 
 MODULE_REGISTER_TMP(A2AAslashField, ARG(TA2AAslashField<FIMPL, PhotonR>), MContraction);
@@ -159,9 +164,20 @@ std::vector<std::string> TA2AAslashField<FImpl, PhotonImpl>::getOutput(void)
 template <typename FImpl, typename PhotonImpl>
 void TA2AAslashField<FImpl, PhotonImpl>::setup(void)
 {
+    // block sizes, 0 (auto) ones are taken from the application database if 
+    // already calibrated, otherwise the buffers are sized for the worst case
+    // and the calibration happens at execution
+    auto         &left  = envGet(std::vector<FermionField>, par().left);
+    auto         &right = envGet(std::vector<FermionField>, par().right);
+    unsigned int n      = std::min(left.size(), right.size());
+    Tuner        tuner(envGetGrid(FermionField), env().getNd() - 1, 
+                       par().emField.size(), 1, vm().getDatabase());
+
+    tuner.resolve(tuneState_, par().block, par().cacheBlock, 
+                  "AslashField", left.size(), right.size(), n);
     envTmp(Computation, "computation", 1, envGetGrid(FermionField), 
-           env().getNd() - 1, par().emField.size(), 1, par().block, 
-           par().cacheBlock, this);
+           env().getNd() - 1, par().emField.size(), 1, tuneState_.size.block, 
+           tuneState_.size.cacheBlock, this);
     envTmp(std::vector<ComplexField>, "B0", 1, 
            par().emField.size(), envGetGrid(ComplexField));
     envTmp(std::vector<ComplexField>, "B1", 1, 
@@ -181,8 +197,6 @@ void TA2AAslashField<FImpl, PhotonImpl>::execute(void)
     int N_i        = left.size();
     int N_j        = right.size();
     int nem        = par().emField.size();
-    int block      = par().block;
-    int cacheBlock = par().cacheBlock;
 
     LOG(Message) << "Computing all-to-all A-slash fields" << std::endl;
     LOG(Message) << "Left: '" << par().left << "' Right: '" << par().right << "'" << std::endl;
@@ -236,6 +250,17 @@ void TA2AAslashField<FImpl, PhotonImpl>::execute(void)
     Kernel kernel(B0, B1, envGetGrid(FermionField));
 
     envGetTmp(Computation, computation);
+    Tuner tuner(envGetGrid(FermionField), env().getNd() - 1, nem, 1,
+                vm().getDatabase());
+
+    startTimer("Block size tuning");
+    if (tuner.resolve(tuneState_, left, right, kernel))
+    {
+        computation.setBlockSize(tuneState_.size.block, tuneState_.size.cacheBlock);
+    }
+    stopTimer("Block size tuning");
+    LOG(Message) << "Block size: " << tuneState_.size.block << ", cache block size: "
+                 << tuneState_.size.cacheBlock << std::endl;
     computation.execute(left, right, kernel, ionameFn, filenameFn, metadataFn);
 #endif
 }
@@ -34,6 +34,11 @@
 #include <Hadrons/ModuleFactory.hpp>
 #include <Hadrons/A2AMatrix.hpp>
 
+// number of momenta from which the FFT kernel is used (0 to disable it)
+#ifndef HADRONS_A2AM_FFT_CROSSOVER
+#define HADRONS_A2AM_FFT_CROSSOVER 16
+#endif
+
 BEGIN_HADRONS_NAMESPACE
 
 /******************************************************************************
@@ -62,14 +67,17 @@ public:
                                     Gamma::Algebra, gamma);
 };
 
+// The momentum phases are the set shared in the environment, used without 
+// copies.
 template <typename T, typename FImpl>
 class MesonFieldKernel: public A2AKernel<T, typename FImpl::FermionField>
 {
 public:
     typedef typename FImpl::FermionField FermionField;
+    typedef typename FImpl::ComplexField ComplexField;
 public:
     MesonFieldKernel(const std::vector<Gamma::Algebra> &gamma,
-                     const std::vector<LatticeComplex> &mom,
+                     const std::vector<ComplexField> &mom,
                      GridBase *grid)
     : gamma_(gamma), mom_(mom), grid_(grid)
     {
@@ -100,11 +108,170 @@ public:
     }
 private:
     const std::vector<Gamma::Algebra> &gamma_;
-    const std::vector<LatticeComplex> &mom_;
+    const std::vector<ComplexField>   &mom_;
     GridBase                          *grid_;
     double                            vol_;
 };
 
+// Same contraction as MesonFieldKernel, with the momentum projection done by
+// a spatial FFT of the local bilinears. The cost is independent of the number
+// of momenta, which makes it faster for large momentum sets. It requires 
+// integer momenta and Grid to be compiled with FFTW.
+template <typename T, typename FImpl>
+class MesonFieldFftKernel: public A2AKernel<T, typename FImpl::FermionField>
+{
+public:
+    typedef typename FImpl::FermionField FermionField;
+    typedef typename FImpl::ComplexField ComplexField;
+private:
+    struct MomSite
+    {
+        unsigned int m, t;
+        Coordinate   lcoor;
+    };
+public:
+    MesonFieldFftKernel(const std::vector<Gamma::Algebra> &gamma,
+                        const std::vector<std::vector<Real>> &mom,
+                        GridCartesian *grid)
+    : gamma_(gamma), mom_(mom), grid_(grid), orthogDim_(grid->Nd() - 1)
+    {
+        vol_ = 1.;
+        for (auto &d: grid_->GlobalDimensions())
+        {
+            vol_ *= d;
+        }
+    }
+
+    virtual ~MesonFieldFftKernel(void) = default;
+
+    static bool isSupported(const std::vector<std::vector<Real>> &mom)
+    {
+#ifdef HAVE_FFTW
+        for (auto &p: mom)
+        for (auto pmu: p)
+        {
+            if (pmu != std::round(pmu))
+            {
+                return false;
+            }
+        }
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    virtual void operator()(A2AMatrixSet<T> &m, const FermionField *left, 
+                            const FermionField *right,
+                            const unsigned int orthogDim, double &t)
+    {
+        const unsigned int       next = m.dimension(0), nstr = m.dimension(1);
+        const unsigned int       ni   = m.dimension(3), nj   = m.dimension(4);
+        FFT                      fft(grid_);
+        FermionField             gRight(grid_);
+        ComplexField             bil(grid_), bilFt(grid_);
+        std::vector<int>         dMask(grid_->Nd(), 1);
+        typename ComplexField::scalar_object buf;
+
+        if (next != mom_.size())
+        {
+            HADRONS_ERROR(Size, "meson field has " + std::to_string(next) 
+                          + " momenta, kernel has " + std::to_string(mom_.size()));
+        }
+        t = -usecond();
+        makeSites(orthogDim);
+        dMask[orthogDim] = 0;
+        m.setZero();
+        for (unsigned int s = 0; s < nstr; ++s)
+        {
+            Gamma g(gamma_[s]);
+
+            for (unsigned int j = 0; j < nj; ++j)
+            {
+                gRight = g*right[j];
+                for (unsigned int i = 0; i < ni; ++i)
+                {
+                    // sum_x exp(i*p.x)*(left^dag G right)(x) 
+                    // = conj(FFT_forward[conj(left^dag G right)](p))
+                    bil = localInnerProduct(gRight, left[i]);
+                    fft.FFT_dim_mask(bilFt, bil, dMask, FFT::forward);
+                    for (auto &site: site_)
+                    {
+                        peekLocalSite(buf, bilFt, site.lcoor);
+                        m(site.m, s, site.t, i, j) = std::conj(TensorRemove(buf));
+                    }
+                }
+            }
+        }
+        grid_->GlobalSumVector(m.data(), m.size());
+        t += usecond();
+    }
+
+    virtual double flops(const unsigned int blockSizei, const unsigned int blockSizej)
+    {
+        double vs = vol_/grid_->GlobalDimensions()[orthogDim_];
+
+        return vol_*(8.0*12.0 + 5.0*std::log2(vs))*blockSizei*blockSizej*gamma_.size()
+               + vol_*(6.0*12.0)*blockSizej*gamma_.size();
+    }
+
+    virtual double bytes(const unsigned int blockSizei, const unsigned int blockSizej)
+    {
+        double vs = vol_/grid_->GlobalDimensions()[orthogDim_];
+
+        return vol_*(2.0*12.0*sizeof(T) + 4.0*sizeof(T)*std::log2(vs))
+               *blockSizei*blockSizej*gamma_.size();
+    }
+private:
+    // local lattice sites holding the momenta after the FFT
+    void makeSites(const unsigned int orthogDim)
+    {
+        if (sitesDone_ and (orthogDim == orthogDim_))
+        {
+            return;
+        }
+        
+        auto       dim = grid_->GlobalDimensions();
+        Coordinate gcoor(grid_->Nd()), pcoor(grid_->Nd());
+
+        orthogDim_ = orthogDim;
+        site_.clear();
+        for (unsigned int m = 0; m < mom_.size(); ++m)
+        {
+            for (unsigned int mu = 0; mu < grid_->Nd(); ++mu)
+            {
+                int p = (mu < mom_[m].size()) ? static_cast<int>(mom_[m][mu]) : 0;
+
+                gcoor[mu] = ((p % dim[mu]) + dim[mu]) % dim[mu];
+            }
+            for (unsigned int t = 0; t < dim[orthogDim]; ++t)
+            {
+                MomSite site;
+
+                gcoor[orthogDim] = t;
+                site.m           = m;
+                site.t           = t;
+                site.lcoor.resize(grid_->Nd());
+                grid_->GlobalCoorToProcessorCoorLocalCoor(pcoor, site.lcoor, gcoor);
+                if (grid_->RankFromProcessorCoor(pcoor) == grid_->ThisRank())
+                {
+                    site_.push_back(site);
+                }
+            }
+        }
+        sitesDone_ = true;
+    }
+private:
+    const std::vector<Gamma::Algebra>     &gamma_;
+    const std::vector<std::vector<Real>>  &mom_;
+    GridCartesian                         *grid_;
+    double                                vol_;
+    bool                                  sitesDone_{false};
+    unsigned int                          orthogDim_;
+    std::vector<MomSite>                  site_;
+};
+
 template <typename FImpl>
 class TA2AMesonField : public Module<A2AMesonFieldPar>
 {
@@ -114,7 +281,11 @@ public:
                                       FermionField, 
                                       A2AMesonFieldMetadata, 
                                       HADRONS_A2AM_IO_TYPE> Computation;
+    typedef A2AMatrixBlockTuner<Complex, 
+                                FermionField, 
+                                HADRONS_A2AM_IO_TYPE> Tuner;
     typedef MesonFieldKernel<Complex, FImpl> Kernel;
+    typedef MesonFieldFftKernel<Complex, FImpl> FftKernel;
 public:
     // constructor
     TA2AMesonField(const std::string name);
@@ -128,8 +299,8 @@ public:
     // execution
     virtual void execute(void);
 private:
-    bool                               hasPhase_{false};
-    std::string                        momphName_;
+    bool                               useFft_{false};
+    A2AMatrixBlockTuneState            tuneState_;
     std::vector<Gamma::Algebra>        gamma_;
     std::vector<std::vector<Real>>     mom_;
 };
@@ -143,7 +314,6 @@ MODULE_REGISTER(A2AMesonField, ARG(TA2AMesonField<FIMPL>), MContraction);
 template <typename FImpl>
 TA2AMesonField<FImpl>::TA2AMesonField(const std::string name)
 : Module<A2AMesonFieldPar>(name)
-, momphName_(name + "_momph")
 {
 }
 
@@ -207,12 +377,30 @@ void TA2AMesonField<FImpl>::setup(void)
         }
         mom_.push_back(p);
     }
-    envCache(std::vector<ComplexField>, momphName_, 1, 
-             par().mom.size(), envGetGrid(ComplexField));
-    envTmpLat(ComplexField, "coor");
+    // large momentum sets are projected using FFTs instead of phases
+    useFft_ = (HADRONS_A2AM_FFT_CROSSOVER > 0) 
+              and (mom_.size() >= HADRONS_A2AM_FFT_CROSSOVER)
+              and FftKernel::isSupported(mom_);
+    if (!useFft_)
+    {
+        envCacheMomentumPhaseSet(ComplexField, mom_);
+    }
+
+    // block sizes, 0 (auto) ones are taken from the application database if 
+    // already calibrated, otherwise the buffers are sized for the worst case
+    // and the calibration happens at execution
+    auto        &left  = envGet(std::vector<FermionField>, par().left);
+    auto        &right = envGet(std::vector<FermionField>, par().right);
+    unsigned int n     = std::min(left.size(), right.size());
+    Tuner       tuner(envGetGrid(FermionField), env().getNd() - 1, mom_.size(),
+                      gamma_.size(), vm().getDatabase());
+
+    tuner.resolve(tuneState_, par().block, par().cacheBlock, 
+                  useFft_ ? "MesonFieldFft" : "MesonField", 
+                  left.size(), right.size(), n);
     envTmp(Computation, "computation", 1, envGetGrid(FermionField), 
-           env().getNd() - 1, mom_.size(), gamma_.size(), par().block, 
-           par().cacheBlock, this);
+           env().getNd() - 1, mom_.size(), gamma_.size(), tuneState_.size.block, 
+           tuneState_.size.cacheBlock, this);
 }
 
 // execution ///////////////////////////////////////////////////////////////////
@@ -227,8 +415,7 @@ void TA2AMesonField<FImpl>::execute(void)
     int N_j        = right.size();
     int ngamma     = gamma_.size();
     int nmom       = mom_.size();
-    int block      = par().block;
-    int cacheBlock = par().cacheBlock;
+    int block      = tuneState_.size.block;
 
     if (N_i < block || N_j < block)
     {
@@ -251,26 +438,17 @@ void TA2AMesonField<FImpl>::execute(void)
                  << " (filesize " << sizeString(nt*N_i*N_j*sizeof(HADRONS_A2AM_IO_TYPE)) 
                  << "/momentum/bilinear)" << std::endl;
 
-    auto &ph = envGet(std::vector<ComplexField>, momphName_);
+    std::vector<ComplexField>       noPhase;
+    const std::vector<ComplexField> *ph = &noPhase;
 
-    if (!hasPhase_)
+    if (useFft_)
+    {
+        LOG(Message) << "Momentum projection using FFTs" << std::endl;
+    }
+    else
     {
         startTimer("Momentum phases");
-        for (unsigned int j = 0; j < nmom; ++j)
-        {
-            Complex           i(0.0,1.0);
-            std::vector<Real> p;
-
-            envGetTmp(ComplexField, coor);
-            ph[j] = Zero();
-            for(unsigned int mu = 0; mu < mom_[j].size(); mu++)
-            {
-                LatticeCoordinate(coor, mu);
-                ph[j] = ph[j] + (mom_[j][mu]/env().getDim(mu))*coor;
-            }
-            ph[j] = exp((Real)(2*M_PI)*i*ph[j]);
-        }
-        hasPhase_ = true;
+        ph = &envGetMomentumPhaseSet(ComplexField, mom_);
         stopTimer("Momentum phases");
     }
 
@@ -306,9 +484,23 @@ void TA2AMesonField<FImpl>::execute(void)
         return md;
     };
 
-    Kernel      kernel(gamma_, ph, envGetGrid(FermionField));
+    Kernel                           phKernel(gamma_, *ph, envGetGrid(FermionField));
+    FftKernel                        fftKernel(gamma_, mom_, envGetGrid(FermionField));
+    A2AKernel<Complex, FermionField> &kernel = useFft_ ? 
+        static_cast<A2AKernel<Complex, FermionField> &>(fftKernel) : phKernel;
 
     envGetTmp(Computation, computation);
+    Tuner tuner(envGetGrid(FermionField), env().getNd() - 1, nmom,
+                ngamma, vm().getDatabase());
+
+    startTimer("Block size tuning");
+    if (tuner.resolve(tuneState_, left, right, kernel))
+    {
+        computation.setBlockSize(tuneState_.size.block, tuneState_.size.cacheBlock);
+    }
+    stopTimer("Block size tuning");
+    LOG(Message) << "Block size: " << tuneState_.size.block << ", cache block size: "
+                 << tuneState_.size.cacheBlock << std::endl;
     computation.execute(left, right, kernel, ionameFn, filenameFn, metadataFn);
 }
 
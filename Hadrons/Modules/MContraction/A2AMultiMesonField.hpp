@@ -0,0 +1,370 @@
+/*
+ * A2AMultiMesonField.hpp, part of Hadrons (https://github.com/aportelli/Hadrons)
+ *
+ * Copyright (C) 2015 - 2020
+ *
+ * Author: Antonin Portelli <antonin.portelli@me.com>
+ *
+ * Hadrons is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Hadrons is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hadrons.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * See the full license in the file "LICENSE" in the top level distribution
+ * directory.
+ */
+
+/*  END LEGAL */
+#ifndef Hadrons_MContraction_A2AMultiMesonField_hpp_
+#define Hadrons_MContraction_A2AMultiMesonField_hpp_
+
+#include <Hadrons/Global.hpp>
+#include <Hadrons/Module.hpp>
+#include <Hadrons/ModuleFactory.hpp>
+#include <Hadrons/A2AMatrix.hpp>
+#include <Hadrons/Modules/MContraction/A2AMesonField.hpp>
+
+BEGIN_HADRONS_NAMESPACE
+
+/******************************************************************************
+ *        All-to-all meson field creation for several vector pairs           *
+ ******************************************************************************/
+// Pairs sharing the same left vectors are computed in a single blocked pass.
+// For each block position, the blocks of all the corresponding right sets are
+// computed one after the other against the same left block, with one kernel
+// call per right set.
+BEGIN_MODULE_NAMESPACE(MContraction)
+
+class A2AMesonFieldPairPar: Serializable
+{
+public:
+    GRID_SERIALIZABLE_CLASS_MEMBERS(A2AMesonFieldPairPar,
+                                    std::string, left,
+                                    std::string, right,
+                                    std::string, output);
+};
+
+class A2AMultiMesonFieldPar: Serializable
+{
+public:
+    GRID_SERIALIZABLE_CLASS_MEMBERS(A2AMultiMesonFieldPar,
+                                    int, cacheBlock,
+                                    int, block,
+                                    std::vector<A2AMesonFieldPairPar>, pair,
+                                    std::string, gammas,
+                                    std::vector<std::string>, mom);
+};
+
+template <typename FImpl>
+class TA2AMultiMesonField : public Module<A2AMultiMesonFieldPar>
+{
+public:
+    FERM_TYPE_ALIASES(FImpl,);
+    typedef A2AMatrixBlockComputation<Complex,
+                                      FermionField,
+                                      A2AMesonFieldMetadata,
+                                      HADRONS_A2AM_IO_TYPE> Computation;
+    typedef A2AMatrixBlockTuner<Complex,
+                                FermionField,
+                                HADRONS_A2AM_IO_TYPE> Tuner;
+    typedef MesonFieldKernel<Complex, FImpl> Kernel;
+    typedef MesonFieldFftKernel<Complex, FImpl> FftKernel;
+    typedef std::function<std::string(const unsigned int,
+                                      const unsigned int)> FilenameFn;
+    typedef std::pair<std::string, std::vector<unsigned int>> PairGroup;
+public:
+    // constructor
+    TA2AMultiMesonField(const std::string name);
+    // destructor
+    virtual ~TA2AMultiMesonField(void){};
+    // dependency relation
+    virtual std::vector<std::string> getInput(void);
+    virtual std::vector<std::string> getOutput(void);
+    // setup
+    virtual void setup(void);
+    // execution
+    virtual void execute(void);
+private:
+    bool                                                 useFft_{false};
+    unsigned int                                         tunePair_;
+    A2AMatrixBlockTuneState                              tuneState_;
+    std::vector<Gamma::Algebra>                          gamma_;
+    std::vector<std::vector<Real>>                       mom_;
+    std::vector<PairGroup>                               group_;
+};
+
+MODULE_REGISTER(A2AMultiMesonField, ARG(TA2AMultiMesonField<FIMPL>), MContraction);
+
+/******************************************************************************
+*                  TA2AMultiMesonField implementation                         *
+******************************************************************************/
+// constructor /////////////////////////////////////////////////////////////////
+template <typename FImpl>
+TA2AMultiMesonField<FImpl>::TA2AMultiMesonField(const std::string name)
+: Module<A2AMultiMesonFieldPar>(name)
+{
+}
+
+// dependencies/products ///////////////////////////////////////////////////////
+template <typename FImpl>
+std::vector<std::string> TA2AMultiMesonField<FImpl>::getInput(void)
+{
+    std::set<std::string> in;
+
+    for (auto &p: par().pair)
+    {
+        in.insert(p.left);
+        in.insert(p.right);
+    }
+
+    return std::vector<std::string>(in.begin(), in.end());
+}
+
+template <typename FImpl>
+std::vector<std::string> TA2AMultiMesonField<FImpl>::getOutput(void)
+{
+    std::vector<std::string> out = {};
+
+    return out;
+}
+
+// setup ///////////////////////////////////////////////////////////////////////
+template <typename FImpl>
+void TA2AMultiMesonField<FImpl>::setup(void)
+{
+    if (par().pair.empty())
+    {
+        HADRONS_ERROR(Size, "no left/right vector pair");
+    }
+    gamma_.clear();
+    mom_.clear();
+    group_.clear();
+    if (par().gammas == "all")
+    {
+        gamma_ = {
+            Gamma::Algebra::Gamma5,
+            Gamma::Algebra::Identity,
+            Gamma::Algebra::GammaX,
+            Gamma::Algebra::GammaY,
+            Gamma::Algebra::GammaZ,
+            Gamma::Algebra::GammaT,
+            Gamma::Algebra::GammaXGamma5,
+            Gamma::Algebra::GammaYGamma5,
+            Gamma::Algebra::GammaZGamma5,
+            Gamma::Algebra::GammaTGamma5,
+            Gamma::Algebra::SigmaXY,
+            Gamma::Algebra::SigmaXZ,
+            Gamma::Algebra::SigmaXT,
+            Gamma::Algebra::SigmaYZ,
+            Gamma::Algebra::SigmaYT,
+            Gamma::Algebra::SigmaZT
+        };
+    }
+    else
+    {
+        gamma_ = strToVec<Gamma::Algebra>(par().gammas);
+    }
+    for (auto &pstr: par().mom)
+    {
+        auto p = strToVec<Real>(pstr);
+
+        if (p.size() != env().getNd() - 1)
+        {
+            HADRONS_ERROR(Size, "Momentum has " + std::to_string(p.size())
+                                + " components instead of "
+                                + std::to_string(env().getNd() - 1));
+        }
+        mom_.push_back(p);
+    }
+    // large momentum sets are projected using FFTs instead of phases
+    useFft_ = (HADRONS_A2AM_FFT_CROSSOVER > 0)
+              and (mom_.size() >= HADRONS_A2AM_FFT_CROSSOVER)
+              and FftKernel::isSupported(mom_);
+    if (!useFft_)
+    {
+        envCacheMomentumPhaseSet(ComplexField, mom_);
+    }
+
+    // group the pairs by left vectors (in order of first appearance)
+    unsigned int n = 0;
+
+    for (unsigned int k = 0; k < par().pair.size(); ++k)
+    {
+        auto         &p  = par().pair[k];
+        auto         &l  = envGet(std::vector<FermionField>, p.left);
+        auto         &r  = envGet(std::vector<FermionField>, p.right);
+        unsigned int nlr = std::min(l.size(), r.size());
+        auto         it  = std::find_if(group_.begin(), group_.end(),
+                                        [&p](const PairGroup &g)
+                                        {
+                                            return (g.first == p.left);
+                                        });
+
+        if (it == group_.end())
+        {
+            group_.push_back({p.left, {k}});
+        }
+        else
+        {
+            it->second.push_back(k);
+        }
+        // the block sizes are tuned on the smallest pair, which bounds them
+        if ((k == 0) or (nlr < n))
+        {
+            n         = nlr;
+            tunePair_ = k;
+        }
+    }
+
+    // block sizes, 0 (auto) ones are taken from the application database if
+    // already calibrated, otherwise the buffers are sized for the worst case
+    // and the calibration happens at execution, the computation holds one
+    // block per right set of the largest group
+    unsigned int nRight = 1;
+
+    for (auto &g: group_)
+    {
+        nRight = std::max(nRight, static_cast<unsigned int>(g.second.size()));
+    }
+
+    Tuner tuner(envGetGrid(FermionField), env().getNd() - 1, mom_.size(),
+                gamma_.size(), vm().getDatabase(), HADRONS_A2AM_TUNE_MEM/nRight);
+
+    tuner.resolve(tuneState_, par().block, par().cacheBlock, 
+                  useFft_ ? "MultiMesonFieldFft" : "MultiMesonField", n, n, n);
+    if (tuneState_.size.block > n)
+    {
+        HADRONS_ERROR(Range, "blockSize must not exceed size of input vectors.");
+    }
+    envTmp(Computation, "computation", 1, envGetGrid(FermionField),
+           env().getNd() - 1, mom_.size(), gamma_.size(), tuneState_.size.block,
+           tuneState_.size.cacheBlock, this, nRight);
+}
+
+// execution ///////////////////////////////////////////////////////////////////
+template <typename FImpl>
+void TA2AMultiMesonField<FImpl>::execute(void)
+{
+    int nt     = env().getDim().back();
+    int ngamma = gamma_.size();
+    int nmom   = mom_.size();
+
+    LOG(Message) << "Computing all-to-all meson fields for "
+                 << par().pair.size() << " vector pair(s) sharing "
+                 << group_.size() << " left set(s)" << std::endl;
+    for (auto &p: par().pair)
+    {
+        auto &left  = envGet(std::vector<FermionField>, p.left);
+        auto &right = envGet(std::vector<FermionField>, p.right);
+
+        LOG(Message) << "  Left: '" << p.left << "' Right: '" << p.right
+                     << "' -> '" << p.output << "' (size " << nt << "*"
+                     << left.size() << "*" << right.size() << ")" << std::endl;
+    }
+    LOG(Message) << "Momenta:" << std::endl;
+    for (auto &p: mom_)
+    {
+        LOG(Message) << "  " << p << std::endl;
+    }
+    LOG(Message) << "Spin bilinears:" << std::endl;
+    for (auto &g: gamma_)
+    {
+        LOG(Message) << "  " << g << std::endl;
+    }
+
+    std::vector<ComplexField>       noPhase;
+    const std::vector<ComplexField> *ph = &noPhase;
+
+    if (useFft_)
+    {
+        LOG(Message) << "Momentum projection using FFTs" << std::endl;
+    }
+    else
+    {
+        startTimer("Momentum phases");
+        ph = &envGetMomentumPhaseSet(ComplexField, mom_);
+        stopTimer("Momentum phases");
+    }
+
+    auto ionameFn = [this](const unsigned int m, const unsigned int g)
+    {
+        std::stringstream ss;
+
+        ss << gamma_[g] << "_";
+        for (unsigned int mu = 0; mu < mom_[m].size(); ++mu)
+        {
+            ss << mom_[m][mu] << ((mu == mom_[m].size() - 1) ? "" : "_");
+        }
+
+        return ss.str();
+    };
+
+    auto metadataFn = [this](const unsigned int m, const unsigned int g)
+    {
+        A2AMesonFieldMetadata md;
+
+        for (auto pmu: mom_[m])
+        {
+            md.momentum.push_back(pmu);
+        }
+        md.gamma = gamma_[g];
+
+        return md;
+    };
+
+    Kernel                           phKernel(gamma_, *ph, envGetGrid(FermionField));
+    FftKernel                        fftKernel(gamma_, mom_, envGetGrid(FermionField));
+    A2AKernel<Complex, FermionField> &kernel = useFft_ ?
+        static_cast<A2AKernel<Complex, FermionField> &>(fftKernel) : phKernel;
+
+    envGetTmp(Computation, computation);
+    auto &tuneLeft  = envGet(std::vector<FermionField>, par().pair[tunePair_].left);
+    auto &tuneRight = envGet(std::vector<FermionField>, par().pair[tunePair_].right);
+    Tuner tuner(envGetGrid(FermionField), env().getNd() - 1, nmom,
+                ngamma, vm().getDatabase());
+
+    startTimer("Block size tuning");
+    if (tuner.resolve(tuneState_, tuneLeft, tuneRight, kernel))
+    {
+        computation.setBlockSize(tuneState_.size.block, tuneState_.size.cacheBlock);
+    }
+    stopTimer("Block size tuning");
+    LOG(Message) << "Block size: " << tuneState_.size.block << ", cache block size: "
+                 << tuneState_.size.cacheBlock << std::endl;
+    for (auto &g: group_)
+    {
+        auto                                    &left = envGet(std::vector<FermionField>, g.first);
+        std::vector<const std::vector<FermionField> *> right;
+        std::vector<FilenameFn>                 filenameFn;
+
+        LOG(Message) << "Left set '" << g.first << "' against "
+                     << g.second.size() << " right set(s)" << std::endl;
+        for (auto k: g.second)
+        {
+            std::string output = par().pair[k].output;
+
+            right.push_back(&envGet(std::vector<FermionField>, par().pair[k].right));
+            filenameFn.push_back([this, output, &ionameFn](const unsigned int m,
+                                                           const unsigned int s)
+            {
+                return output + "." + std::to_string(vm().getTrajectory())
+                       + "/" + ionameFn(m, s) + ".h5";
+            });
+        }
+        computation.execute(left, right, kernel, ionameFn, filenameFn, metadataFn);
+    }
+}
+
+END_MODULE_NAMESPACE
+
+END_HADRONS_NAMESPACE
+
+#endif // Hadrons_MContraction_A2AMultiMesonField_hpp_
@@ -47,7 +47,10 @@ public:
                                     std::string,  file,
                                     std::string,  dataset,
                                     std::string,  diskVectorDir,
-                                    int,  cacheSize);
+                                    int,  cacheSize,
+                                    std::string,  backend,
+                                    std::string,  codec,
+                                    unsigned int, writeBehind);
 };
 
 template <typename FImpl>
@@ -111,7 +114,50 @@ void TLoadA2AMatrixDiskVector<FImpl>::setup(void)
     bool clean = true;
     GridBase *grid = envGetGrid(FermionField);
 
-    envCreate(EigenDiskVector<ComplexD>, getName(), Ls, dvFile, nt, cacheSize, clean, grid);
+    // hdf5 backend: timeslices read from the file on cache miss, no staging
+    if (par().backend == "hdf5")
+    {
+        std::string file = par().file;
+
+        tokenReplace(file, "traj", vm().getTrajectory());
+        envCreateDerived(EigenDiskVector<ComplexD>, A2AMatrixDiskVector<ComplexD>, 
+                         getName(), Ls, file, dataset, nt, cacheSize, grid);
+    }
+    else if (par().backend.empty() or (par().backend == "file"))
+    {
+        envCreate(EigenDiskVector<ComplexD>, getName(), Ls, dvFile, nt, cacheSize, clean, grid);
+    }
+    // sharded backend: timeslices distributed over the processes, stored in
+    // diskVectorDir which can be node-local. Reads are still collective: on
+    // a cache miss the owner broadcasts the timeslice to all the processes,
+    // which must all read the same timeslices in the same order
+    else if (par().backend == "sharded")
+    {
+        envCreate(EigenDiskVector<ComplexD>, getName(), Ls, dvFile, nt, cacheSize, clean, grid, true);
+    }
+    // store backend: persistent disk vector converted by the first job, and
+    // opened read-only by the following ones. A store without manifest was
+    // left by an interrupted conversion and is converted again, unless it is
+    // locked by a job still converting it, which is an error.
+    else if (par().backend == "store")
+    {
+        struct stat s;
+        int         exists[2] = {stat(dvFile.c_str(), &s) == 0,
+                                 stat((dvFile + "/manifest").c_str(), &s) == 0};
+
+        grid->Broadcast(grid->BossRank(), exists, sizeof(exists));
+        if (exists[0] and !exists[1])
+        {
+            diskVectorRemoveStore(dvFile, grid);
+        }
+        DiskVectorMode mode = exists[1] ? DiskVectorMode::read : DiskVectorMode::create;
+        envCreate(EigenDiskVector<ComplexD>, getName(), Ls, dvFile, nt, cacheSize, false, grid, false, mode);
+    }
+    else
+    {
+        HADRONS_ERROR(Argument, "unknown disk vector backend '" + par().backend 
+                      + "' (expected file, hdf5, sharded or store)");
+    }
 }
 
 // execution ///////////////////////////////////////////////////////////////////
@@ -127,10 +173,40 @@ void TLoadA2AMatrixDiskVector<FImpl>::execute(void)
 
     int traj = vm().getTrajectory();
     tokenReplace(file, "traj", traj);
+    if (par().backend == "hdf5")
+    {
+        LOG(Message) << "-- Timeslices of '" << file << "' read on demand --" << std::endl;
+        return;
+    }
+    // reopened stores use the codec of their manifest
+    if (mesonFieldDV.getMode() == DiskVectorMode::read)
+    {
+        LOG(Message) << "-- Using stored meson field for '" << file << "' --" << std::endl;
+        return;
+    }
+    // stored elements are encoded with the codec, none if empty
+    mesonFieldDV.setCodec(makeDiskVectorCodec(par().codec));
     LOG(Message) << "-- Loading '" << file << "'-- " << std::endl;
     double t;
     A2AMatrixIo<HADRONS_A2AM_IO_TYPE> mfIO(file, dataset, nt);
+    // sharded saves need no communication, with writeBehind > 0 they run in
+    // the background during the load with a queue of this size, the queue
+    // is flushed at the end of the load so that write errors are reported
+    bool writeBehind = mesonFieldDV.isSharded() and (par().writeBehind > 0);
+
+    if (writeBehind)
+    {
+        mesonFieldDV.enableWriteBehind(par().writeBehind);
+    }
     mfIO.load(mesonFieldDV, &t, grid);
+    if (mesonFieldDV.isPersistent() or writeBehind)
+    {
+        mesonFieldDV.flush();
+    }
+    if (writeBehind)
+    {
+        mesonFieldDV.disableWriteBehind();
+    }
     LOG(Message) << "Read " << mfIO.getSize() << " bytes in " << t << " usec, " << mfIO.getSize() / t * 1.0e6 / 1024 / 1024 << " MB/s" << std::endl;
 }
 
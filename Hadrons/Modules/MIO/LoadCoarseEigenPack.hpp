@@ -47,7 +47,9 @@ public:
                                     unsigned int, sizeFine,
                                     unsigned int, sizeCoarse,
                                     unsigned int, Ls,
-                                    std::vector<int>, blockSize);
+                                    std::vector<int>, blockSize,
+                                    unsigned int, ioGroups,
+                                    bool, readAhead);
 };
 
 template <typename Pack>
@@ -137,6 +139,8 @@ void TLoadCoarseEigenPack<Pack>::execute(void)
     auto                 &epack = envGetDerived(BasePack, Pack, getName());
     Lattice<SiteComplex> dummy(cg);
 
+    epack.setIoGroups(par().ioGroups);
+    epack.setReadAhead(par().readAhead);
     epack.read(par().filestem, par().multiFile, vm().getTrajectory());
     LOG(Message) << "Block Gramm-Schmidt pass 1"<< std::endl;
     blockOrthogonalise(dummy, epack.evec);
@@ -48,7 +48,9 @@ public:
                                     bool, multiFile,
                                     unsigned int, size,
                                     unsigned int, Ls,
-                                    std::string, gaugeXform);
+                                    std::string, gaugeXform,
+                                    unsigned int, ioGroups,
+                                    bool, readAhead);
 };
 
 template <typename Pack, typename GImpl>
@@ -149,6 +151,8 @@ void TLoadEigenPack<Pack, GImpl>::execute(void)
 {
     auto &epack = envGetDerived(BasePack, Pack, getName());
 
+    epack.setIoGroups(par().ioGroups);
+    epack.setReadAhead(par().readAhead);
     epack.read(par().filestem, par().multiFile, vm().getTrajectory());
     epack.eval.resize(par().size);
 
@@ -99,6 +99,8 @@ void TBilinear<FImpl1, FImpl2>::setup(void)
 {
     //env().template registerLattice<LatticeSpinColourMatrix>(getName());
     //env().template registerObject<SpinColourMatrix>(getName());
+    envCacheMomentumPhase(LatticeComplex, strToVec<Real>(par().pin));
+    envCacheMomentumPhase(LatticeComplex, strToVec<Real>(par().pout));
 }
 
 // dependencies/products ///////////////////////////////////////////////////////
@@ -172,30 +174,18 @@ q = (p1-p2)
     // Propogators
     LatticeSpinColourMatrix     &Sin = *env().template getObject<LatticeSpinColourMatrix>(par().Sin);
     LatticeSpinColourMatrix     &Sout = *env().template getObject<LatticeSpinColourMatrix>(par().Sout);
-    LatticeComplex              pdotxin(env().getGrid()), pdotxout(env().getGrid()), coor(env().getGrid());
     // momentum on legs
     std::vector<Real>           pin  = strToVec<Real>(par().pin), pout = strToVec<Real>(par().pout);
-    std::vector<Real>           latt_size(pin.begin(), pin.end()); 
     //bilinears
     LatticeSpinColourMatrix     bilinear_x(env().getGrid());
     SpinColourMatrix            bilinear;
     Gamma                       g5(Gamma::Algebra::Gamma5);
     Result                      result;
-    Complex                     Ci(0.0,1.0);
 
     //
 
-    pdotxin=Zero();
-    pdotxout=Zero();
-    for (unsigned int mu = 0; mu < 4; ++mu)
-    {
-        Real TwoPiL =  M_PI * 2.0/ latt_size[mu];
-        LatticeCoordinate(coor,mu);
-        pdotxin = pdotxin +(TwoPiL * pin[mu]) * coor;
-        pdotxout= pdotxout +(TwoPiL * pout[mu]) * coor;
-    }
-    Sin = Sin*exp(-Ci*pdotxin); //phase corrections
-    Sout = Sout*exp(-Ci*pdotxout);
+    Sin  = Sin*conjugate(envGetMomentumPhase(LatticeComplex, pin)); //phase corrections
+    Sout = Sout*conjugate(envGetMomentumPhase(LatticeComplex, pout));
     
     ////Set up gamma vector//////////////////////////
     std::vector<Gamma> gammavector;
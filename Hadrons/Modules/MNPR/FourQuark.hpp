@@ -149,6 +149,8 @@ template <typename FImpl1, typename FImpl2>
 void TFourQuark<FImpl1, FImpl2>::setup(void)
 {
     envCreateLat(LatticeSpinColourMatrix, getName());
+    envCacheMomentumPhase(LatticeComplex, strToVec<Real>(par().pin));
+    envCacheMomentumPhase(LatticeComplex, strToVec<Real>(par().pout));
 }
 
 // execution ///////////////////////////////////////////////////////////////////
@@ -196,28 +198,16 @@ We have up to 256 of these including the offdiag (G1 != G2).
     bool                                        fullbasis = par().fullbasis;
     Gamma                                       g5(Gamma::Algebra::Gamma5);
     Result                                      result;
-    std::vector<Real>                           latt_size(pin.begin(), pin.end());
-    LatticeComplex                              pdotxin(env().getGrid()), pdotxout(env().getGrid()), coor(env().getGrid());
     LatticeSpinColourMatrix                     bilinear_mu(env().getGrid()), bilinear_nu(env().getGrid());
     LatticeSpinColourSpinColourMatrix           lret(env().getGrid()); 
-    Complex                         Ci(0.0,1.0);
 
     //Phase propagators
     //Sin = Grid::QCD::PropUtils::PhaseProps(Sin,pin);
     //Sout = Grid::QCD::PropUtils::PhaseProps(Sout,pout);
     
-    //find p.x for in and out so phase can be accounted for in propagators
-    pdotxin=Zero();
-    pdotxout=Zero();
-    for (unsigned int mu = 0; mu < 4; ++mu)
-    {
-        Real TwoPiL =  M_PI * 2.0/ latt_size[mu];
-        LatticeCoordinate(coor,mu);
-        pdotxin = pdotxin +(TwoPiL * pin[mu]) * coor;
-        pdotxout= pdotxout +(TwoPiL * pout[mu]) * coor;
-    }
-    Sin = Sin*exp(-Ci*pdotxin); //phase corrections
-    Sout = Sout*exp(-Ci*pdotxout);
+    //phase corrections
+    Sin  = Sin*conjugate(envGetMomentumPhase(LatticeComplex, pin));
+    Sout = Sout*conjugate(envGetMomentumPhase(LatticeComplex, pout));
 
     //Set up Gammas 
     std::vector<Gamma> gammavector;
@@ -68,8 +68,7 @@ protected:
     // execution
     virtual void execute(void);
 private:
-    bool        hasPhase_{false}; 
-    std::string momphName_;
+    std::vector<Real> mom_;
 };
 
 MODULE_REGISTER_TMP(Point,       TPoint<FIMPL>,        MSink);
@@ -82,7 +81,6 @@ MODULE_REGISTER_TMP(ScalarPoint, TPoint<ScalarImplCR>, MSink);
 template <typename FImpl>
 TPoint<FImpl>::TPoint(const std::string name)
 : Module<PointPar>(name)
-, momphName_ (name + "_momph")
 {}
 
 // dependencies/products ///////////////////////////////////////////////////////
@@ -106,8 +104,8 @@ std::vector<std::string> TPoint<FImpl>::getOutput(void)
 template <typename FImpl>
 void TPoint<FImpl>::setup(void)
 {
-    envTmpLat(LatticeComplex, "coor");
-    envCacheLat(LatticeComplex, momphName_);
+    mom_ = strToVec<Real>(par().mom);
+    envCacheMomentumPhase(LatticeComplex, mom_);
     envCreate(SinkFn, getName(), 1, nullptr);
 }
 
@@ -118,28 +116,10 @@ void TPoint<FImpl>::execute(void)
     LOG(Message) << "Setting up point sink function for momentum ["
                  << par().mom << "]" << std::endl;
 
-    auto &ph = envGet(LatticeComplex, momphName_);
-    
-    if (!hasPhase_)
-    {
-        Complex           i(0.0,1.0);
-        std::vector<Real> p;
-
-        envGetTmp(LatticeComplex, coor);
-        p  = strToVec<Real>(par().mom);
-        ph = Zero();
-        for(unsigned int mu = 0; mu < p.size(); mu++)
-        {
-            LatticeCoordinate(coor, mu);
-            ph = ph + (p[mu]/env().getDim(mu))*coor;
-        }
-        ph = exp((Real)(2*M_PI)*i*ph);
-        hasPhase_ = true;
-    }
     auto sink = [this](const PropagatorField &field)
     {
         SlicedPropagator res;
-        auto             &ph = envGet(LatticeComplex, momphName_);
+        auto             &ph = envGetMomentumPhase(LatticeComplex, mom_);
         PropagatorField  tmp = ph*field;
         
         sliceSum(tmp, res, Tp);
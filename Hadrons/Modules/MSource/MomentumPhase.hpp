@@ -77,8 +77,7 @@ protected:
     // execution
     virtual void execute(void);
 private:
-    bool        hasPhase_{false};
-    std::string momphName_, tName_;
+    std::vector<Real> mom_;
 };
 
 MODULE_REGISTER_TMP(MomentumPhase, TMomentumPhase<FIMPL>, MSource);
@@ -91,8 +90,6 @@ MODULE_REGISTER_TMP(ZMomentumPhase, TMomentumPhase<ZFIMPL>, MSource);
 template <typename FImpl>
 TMomentumPhase<FImpl>::TMomentumPhase(const std::string name)
 : Module<MomentumPhasePar>(name)
-, momphName_ (name + "_momph")
-, tName_ (name + "_t")
 {}
 
 // dependencies/products ///////////////////////////////////////////////////////
@@ -117,9 +114,8 @@ template <typename FImpl>
 void TMomentumPhase<FImpl>::setup(void)
 {
     envCreateLat(PropagatorField, getName());
-    envCache(Lattice<iScalar<vInteger>>, tName_, 1, envGetGrid(LatticeComplex));
-    envCacheLat(LatticeComplex, momphName_);
-    envTmpLat(LatticeComplex, "coor");
+    mom_ = strToVec<Real>(par().mom);
+    envCacheMomentumPhase(LatticeComplex, mom_);
 }
 
 // execution ///////////////////////////////////////////////////////////////////
@@ -131,26 +127,8 @@ void TMomentumPhase<FImpl>::execute(void)
                  << par().mom << std::endl;
     auto  &out = envGet(PropagatorField, getName());
     auto  &src   = envGet(PropagatorField, par().src);
-    auto  &ph  = envGet(LatticeComplex, momphName_);
-    auto  &t   = envGet(Lattice<iScalar<vInteger>>, tName_);
-    
-    if (!hasPhase_)
-    {
-        Complex           i(0.0,1.0);
-        std::vector<Real> p;
-
-        envGetTmp(LatticeComplex, coor);
-        p  = strToVec<Real>(par().mom);
-        ph = Zero();
-        for(unsigned int mu = 0; mu < env().getNd(); mu++)
-        {
-            LatticeCoordinate(coor, mu);
-            ph = ph + (p[mu]/env().getDim(mu))*coor;
-        }
-        ph = exp((Real)(2*M_PI)*i*ph);
-        LatticeCoordinate(t, Tp);
-        hasPhase_ = true;
-    }
+    auto  &ph  = envGetMomentumPhase(LatticeComplex, mom_);
+
     out = ph*src;
 }
 
@@ -88,8 +88,9 @@ protected:
 private:
     void makeSource(PropagatorField &src, const PropagatorField &q);
 private:
-    bool        hasPhase_{false};
-    std::string momphName_, tName_;
+    bool              hasT_{false};
+    std::string       tName_;
+    std::vector<Real> mom_;
 };
 
 MODULE_REGISTER_TMP(SeqGamma, TSeqGamma<FIMPL>, MSource);
@@ -102,7 +103,6 @@ MODULE_REGISTER_TMP(ZSeqGamma, TSeqGamma<ZFIMPL>, MSource);
 template <typename FImpl>
 TSeqGamma<FImpl>::TSeqGamma(const std::string name)
 : Module<SeqGammaPar>(name)
-, momphName_ (name + "_momph")
 , tName_ (name + "_t")
 {}
 
@@ -146,8 +146,8 @@ void TSeqGamma<FImpl>::setup(void)
                           + ")", env().getObjectAddress(par().q))
     }
     envCache(Lattice<iScalar<vInteger>>, tName_, 1, envGetGrid(LatticeComplex));
-    envCacheLat(LatticeComplex, momphName_);
-    envTmpLat(LatticeComplex, "coor");
+    mom_ = strToVec<Real>(par().mom);
+    envCacheMomentumPhase(LatticeComplex, mom_);
 }
 
 // execution ///////////////////////////////////////////////////////////////////
@@ -155,26 +155,14 @@ template <typename FImpl>
 void TSeqGamma<FImpl>::makeSource(PropagatorField &src, 
                                   const PropagatorField &q)
 {
-    auto  &ph  = envGet(LatticeComplex, momphName_);
+    auto  &ph  = envGetMomentumPhase(LatticeComplex, mom_);
     auto  &t   = envGet(Lattice<iScalar<vInteger>>, tName_);
     Gamma g(par().gamma);
     
-    if (!hasPhase_)
+    if (!hasT_)
     {
-        Complex           i(0.0,1.0);
-        std::vector<Real> p;
-
-        envGetTmp(LatticeComplex, coor);
-        p  = strToVec<Real>(par().mom);
-        ph = Zero();
-        for(unsigned int mu = 0; mu < env().getNd(); mu++)
-        {
-            LatticeCoordinate(coor, mu);
-            ph = ph + (p[mu]/env().getDim(mu))*coor;
-        }
-        ph = exp((Real)(2*M_PI)*i*ph);
         LatticeCoordinate(t, Tp);
-        hasPhase_ = true;
+        hasT_ = true;
     }
     src = where((t >= par().tA) and (t <= par().tB), ph*(g*q), 0.*q);
 }
@@ -0,0 +1,175 @@
+/*
+ * MomentumPhase.hpp, part of Hadrons (https://github.com/aportelli/Hadrons)
+ *
+ * Copyright (C) 2015 - 2020
+ *
+ * Author: Antonin Portelli <antonin.portelli@me.com>
+ *
+ * Hadrons is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Hadrons is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hadrons.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * See the full license in the file "LICENSE" in the top level distribution 
+ * directory.
+ */
+
+/*  END LEGAL */
+#ifndef Hadrons_MomentumPhase_hpp_
+#define Hadrons_MomentumPhase_hpp_
+
+#include <Hadrons/Global.hpp>
+
+BEGIN_HADRONS_NAMESPACE
+
+/******************************************************************************
+ *              Lazily computed momentum phase exp(2*pi*i*p.x/L)              *
+ ******************************************************************************/
+template <typename Field>
+class MomentumPhase
+{
+public:
+    // constructor
+    MomentumPhase(GridBase *grid, const std::vector<Real> &p);
+    // destructor
+    virtual ~MomentumPhase(void) = default;
+    // access (the phase is computed at first call)
+    const Field &             get(void);
+    const std::vector<Real> & getMomentum(void) const;
+    // phase computation
+    static void compute(Field &ph, const std::vector<Real> &p);
+private:
+    Field             ph_;
+    std::vector<Real> p_;
+    bool              computed_{false};
+};
+
+/******************************************************************************
+ *          Lazily computed phases of a momentum set, in a vector             *
+ ******************************************************************************/
+// for kernels taking all the phases at once (e.g. A2Autils::MesonField)
+template <typename Field>
+class MomentumPhaseSet
+{
+public:
+    // constructor
+    MomentumPhaseSet(GridBase *grid, const std::vector<std::vector<Real>> &p);
+    // destructor
+    virtual ~MomentumPhaseSet(void) = default;
+    // access (the phases are computed at first call)
+    const std::vector<Field> &             get(void);
+    const std::vector<std::vector<Real>> & getMomenta(void) const;
+private:
+    std::vector<Field>             ph_;
+    std::vector<std::vector<Real>> p_;
+    bool                           computed_{false};
+};
+
+/******************************************************************************
+ *                   MomentumPhase template implementation                    *
+ ******************************************************************************/
+// constructor /////////////////////////////////////////////////////////////////
+template <typename Field>
+MomentumPhase<Field>::MomentumPhase(GridBase *grid, const std::vector<Real> &p)
+: ph_(grid), p_(p)
+{
+    if (p_.size() > grid->Nd())
+    {
+        HADRONS_ERROR(Size, "momentum has " + std::to_string(p_.size())
+                      + " components, lattice has only " 
+                      + std::to_string(grid->Nd()) + " dimensions");
+    }
+}
+
+// access //////////////////////////////////////////////////////////////////////
+template <typename Field>
+const Field & MomentumPhase<Field>::get(void)
+{
+    if (!computed_)
+    {
+        compute(ph_, p_);
+        computed_ = true;
+    }
+
+    return ph_;
+}
+
+template <typename Field>
+const std::vector<Real> & MomentumPhase<Field>::getMomentum(void) const
+{
+    return p_;
+}
+
+// phase computation ///////////////////////////////////////////////////////////
+template <typename Field>
+void MomentumPhase<Field>::compute(Field &ph, const std::vector<Real> &p)
+{
+    Complex i(0.0,1.0);
+    Field   coor(ph.Grid());
+    auto    dim = ph.Grid()->GlobalDimensions();
+
+    ph = Zero();
+    for(unsigned int mu = 0; mu < p.size(); mu++)
+    {
+        if (p[mu] != 0.)
+        {
+            LatticeCoordinate(coor, mu);
+            ph = ph + (p[mu]/dim[mu])*coor;
+        }
+    }
+    ph = exp((Real)(2*M_PI)*i*ph);
+}
+
+/******************************************************************************
+ *                  MomentumPhaseSet template implementation                  *
+ ******************************************************************************/
+// constructor /////////////////////////////////////////////////////////////////
+template <typename Field>
+MomentumPhaseSet<Field>::MomentumPhaseSet(GridBase *grid, 
+                                          const std::vector<std::vector<Real>> &p)
+: ph_(p.size(), grid), p_(p)
+{
+    for (auto &pm: p_)
+    {
+        if (pm.size() > grid->Nd())
+        {
+            HADRONS_ERROR(Size, "momentum has " + std::to_string(pm.size())
+                          + " components, lattice has only " 
+                          + std::to_string(grid->Nd()) + " dimensions");
+        }
+    }
+}
+
+// access //////////////////////////////////////////////////////////////////////
+template <typename Field>
+const std::vector<Field> & MomentumPhaseSet<Field>::get(void)
+{
+    if (!computed_)
+    {
+        for (unsigned int m = 0; m < p_.size(); ++m)
+        {
+            MomentumPhase<Field>::compute(ph_[m], p_[m]);
+        }
+        computed_ = true;
+    }
+
+    return ph_;
+}
+
+template <typename Field>
+const std::vector<std::vector<Real>> & MomentumPhaseSet<Field>::getMomenta(void) const
+{
+    return p_;
+}
+
+END_HADRONS_NAMESPACE
+
+#endif // Hadrons_MomentumPhase_hpp_
@@ -101,6 +101,15 @@ void VirtualMachine::dbRestoreMemoryProfile(void)
                 assert(env().getObjectAddress(e.name) == e.objectId);
                 env().setObjectStorage(e.objectId, e.storageType);
             }
+            if (db_->tableExists("objectUsers"))
+            {
+                auto userTable = db_->getTable<ObjectUserEntry>("objectUsers");
+
+                for (auto &e: userTable)
+                {
+                    env().addObjectUser(e.objectId, e.moduleId);
+                }
+            }
             memoryProfileOutdated_ = false;
         }
     }
@@ -184,6 +193,11 @@ VirtualMachine::Program VirtualMachine::dbRestoreSchedule(void)
     return program;
 }
 
+Database * VirtualMachine::getDatabase(void) const
+{
+    return hasDatabase() ? db_ : nullptr;
+}
+
 bool VirtualMachine::hasDatabase(void) const
 {
     return ((db_ != nullptr) and db_->isConnected());
@@ -225,6 +239,12 @@ void VirtualMachine::initDatabase(void)
         LOG(Message) << "The object table in '" << db_->getFilename() << "' is not empty, it will not be altered" << std::endl;
         makeObjectDb_ = false;
     }
+    if (!db_->tableExists("objectUsers"))
+    {
+        db_->createTable<ObjectUserEntry>("objectUsers", "PRIMARY KEY(objectId, moduleId),"
+            "FOREIGN KEY(objectId) REFERENCES objects(objectId),"
+            "FOREIGN KEY(moduleId) REFERENCES modules(moduleId)");
+    }
     if (!db_->tableExists("schedule"))
     {
         db_->createTable<ScheduleEntry>("schedule", "PRIMARY KEY(step)," 
@@ -698,6 +718,14 @@ void VirtualMachine::makeMemoryProfile(void)
             o.moduleId     = profile_.object[i].module;
             o.storageType  = profile_.object[i].storage;
             db_->insert("objects", o);
+            for (auto m: env().getObjectUsers(i))
+            {
+                ObjectUserEntry u;
+
+                u.objectId = i;
+                u.moduleId = m;
+                db_->insert("objectUsers", u);
+            }
         }
     }
 }
@@ -834,6 +862,39 @@ VirtualMachine::makeGarbageSchedule(const Program &p) const
                 freeProg[std::distance(it, p.rend()) - 1].insert(a);
             }
         }
+        // shared objects are reference-counted by their user modules, they
+        // live until the last user or the last module reading an output of
+        // a user (e.g. a sink function calling back into the shared object),
+        // if no user is known (e.g. profile restored from a database without
+        // user table), the object is never freed
+        else if ((env().getObjectStorage(a) == Environment::Storage::shared)
+                 and !env().getObjectUsers(a).empty())
+        {
+            auto &users = env().getObjectUsers(a);
+            auto pred   = [a, &users, this](const unsigned int b)
+            {
+                if ((users.find(b) != users.end()) or (b == env().getObjectModule(a)))
+                {
+                    return true;
+                }
+                for (auto &in: module_[b].input)
+                {
+                    int inm = env().getObjectModule(in);
+
+                    if ((inm >= 0) and (users.find(inm) != users.end()))
+                    {
+                        return true;
+                    }
+                }
+
+                return false;
+            };
+            auto it = std::find_if(p.rbegin(), p.rend(), pred);
+            if (it != p.rend())
+            {
+                freeProg[std::distance(it, p.rend()) - 1].insert(a);
+            }
+        }
     }
 
     return freeProg;
@@ -110,6 +110,12 @@ public:
                            SqlNotNull<unsigned int>           , moduleId);
     };
 
+    struct ObjectUserEntry: SqlEntry
+    {
+        HADRONS_SQL_FIELDS(SqlNotNull<unsigned int>, objectId,
+                           SqlNotNull<unsigned int>, moduleId);
+    };
+
     struct ObjectTypeEntry: SqlEntry
     {
         HADRONS_SQL_FIELDS(SqlUnique<unsigned int>           , objectTypeId,
@@ -140,6 +146,7 @@ public:
     std::string         getRunId(void) const;
     // database
     void                setDatabase(Database &db);
+    Database *          getDatabase(void) const;
     void                dbRestoreMemoryProfile(void);
     void                dbRestoreModules(void);
     Program             dbRestoreSchedule(void);
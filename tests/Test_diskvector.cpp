@@ -46,6 +46,46 @@ typedef BinaryReader TestReader;
 typedef BinaryWriter TestWriter;
 #endif
 
+typedef EigenDiskVectorMat<ComplexD> Mat;
+
+void check(const std::string what, const bool pass, bool &ok)
+{
+    LOG(Message) << what << " correct? " << (pass ? "yes" : "no") << std::endl;
+    ok = ok and pass;
+}
+
+bool caught(const std::function<void(void)> &f)
+{
+    try
+    {
+        f();
+    }
+    catch (std::exception &e)
+    {
+        LOG(Message) << "expected error: " << e.what() << std::endl;
+
+        return true;
+    }
+
+    return false;
+}
+
+// version 1 element file: checksum, dimensions and raw data, no header
+void writeVersion1(const std::string filename, const Mat &m)
+{
+    std::ofstream f(filename, std::ios::binary);
+    Eigen::Index  dim[2] = {m.rows(), m.cols()};
+#ifdef USE_IPP
+    uint32_t      crc    = GridChecksum::crc32c(m.data(), m.size()*sizeof(ComplexD));
+#else
+    uint32_t      crc    = GridChecksum::crc32(m.data(), m.size()*sizeof(ComplexD));
+#endif
+
+    f.write(reinterpret_cast<const char *>(&crc), sizeof(crc));
+    f.write(reinterpret_cast<const char *>(dim), sizeof(dim));
+    f.write(reinterpret_cast<const char *>(m.data()), m.size()*sizeof(ComplexD));
+}
+
 int main(int argc, char *argv[])
 {
     Grid_init(&argc, &argv);
@@ -106,7 +146,125 @@ int main(int argc, char *argv[])
                  << ((m == n) ? "yes" : "no" ) << std::endl;
     LOG(Message) << "hit ratio " << w.hitRatio() << std::endl;
 
+    const unsigned int nElem = 16;
+    std::vector<Mat>   ref(nElem);
+    bool               ok = true;
+
+    for (unsigned int i = 0; i < nElem; ++i)
+    {
+        ref[i] = Mat::Random(40, 30 + i % 3);
+    }
+
+    // prefetch with a strided access pattern
+    {
+        EigenDiskVector<ComplexD>       f("pfdiskvector_test", nElem, 6);
+        const EigenDiskVector<ComplexD> &cf = f;
+        bool                            pass = true;
+
+        for (unsigned int i = 0; i < nElem; ++i)
+        {
+            f[i] = ref[i];
+        }
+        f.enablePrefetch(2);
+        for (unsigned int rep = 0; rep < 4; ++rep)
+        for (unsigned int k = 0; k < nElem; ++k)
+        {
+            unsigned int i = (3*k + rep) % nElem;
+
+            pass = pass and (cf[i] == ref[i]);
+        }
+        LOG(Message) << "prefetch hit ratio " << f.prefetchHitRatio() << std::endl;
+        check("strided prefetch", pass, ok);
+    }
+
+    // write-behind: elements re-read right after being written can come
+    // from the write queue
+    {
+        EigenDiskVector<ComplexD>       b("wbdiskvector_test", nElem, 2);
+        const EigenDiskVector<ComplexD> &cb = b;
+        bool                            pass = true;
+
+        b.enableWriteBehind(4);
+        for (unsigned int i = 0; i < nElem; ++i)
+        {
+            b[i] = ref[i];
+        }
+        for (unsigned int i = nElem; i > 0; --i)
+        {
+            pass = pass and (cb[i - 1] == ref[i - 1]);
+        }
+        b.flush();
+        check("write-behind re-read", pass, ok);
+    }
+
+    // persistent store reopened read-only, writes are refused
+    diskVectorRemoveDir("storediskvector_test", nullptr);
+    {
+        EigenDiskVector<ComplexD> s("storediskvector_test", nElem, 2, false);
+
+        for (unsigned int i = 0; i < nElem; ++i)
+        {
+            s[i] = ref[i];
+        }
+    }
+    {
+        EigenDiskVector<ComplexD>       s("storediskvector_test", 0, 2, true, nullptr, 
+                                          false, DiskVectorMode::read);
+        const EigenDiskVector<ComplexD> &cs = s;
+        bool                            pass = (s.getSize() == nElem);
+
+        for (unsigned int i = 0; i < nElem; ++i)
+        {
+            pass = pass and (cs[i] == ref[i]);
+        }
+        check("reopened store", pass, ok);
+        check("read-only store write refused", caught([&s, &ref](void)
+        {
+            s[0] = ref[1];
+        }), ok);
+    }
+    diskVectorRemoveDir("storediskvector_test", nullptr);
+
+    // codecs: lossless round-trip, truncation within its relative error bound
+    for (std::string spec: {"zstd", "truncate:20"})
+    {
+#ifndef USE_ZSTD
+        if (spec == "zstd")
+        {
+            continue;
+        }
+#endif
+        auto                            codec = makeDiskVectorCodec(spec);
+        EigenDiskVector<ComplexD>       c("codecdiskvector_test", nElem, 2);
+        const EigenDiskVector<ComplexD> &cc = c;
+        double                          err = 0.;
+
+        c.setCodec(codec);
+        for (unsigned int i = 0; i < nElem; ++i)
+        {
+            c[i] = ref[i];
+        }
+        for (unsigned int i = 0; i < nElem; ++i)
+        {
+            err = std::max(err, ((cc[i] - ref[i]).cwiseAbs().array()
+                                 /ref[i].cwiseAbs().array()).maxCoeff());
+        }
+        LOG(Message) << spec << " max relative error " << err << std::endl;
+        check(spec + " round-trip", codec->lossless() ? (err == 0.) : (err < 1./(1 << 20)), ok);
+    }
+
+    // version 1 element files are still read
+    {
+        EigenDiskVector<ComplexD>       u("v1diskvector_test", 2, 1);
+        const EigenDiskVector<ComplexD> &cu = u;
+
+        u[0] = ref[0];
+        u[1] = ref[1];
+        writeVersion1("v1diskvector_test/elem_0", ref[2]);
+        check("version 1 file", (cu[1] == ref[1]) and (cu[0] == ref[2]), ok);
+    }
+
     Grid_finalize();
     
-    return EXIT_SUCCESS;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
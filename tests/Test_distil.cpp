@@ -244,7 +244,8 @@ void test_MesonSink(Application &application)
 /////////////////////////////////////////////////////////////
 
 void test_MesonField(Application &application, const char * pszFileSuffix,
-                     const char * pszObjectLeft = nullptr, const char * pszObjectRight = nullptr )
+                     const char * pszObjectLeft = nullptr, const char * pszObjectRight = nullptr,
+                     int block = 4, int cacheBlock = 2 )
 {
   // DistilVectors parameters
   if( pszObjectLeft == nullptr )
@@ -260,8 +261,8 @@ void test_MesonField(Application &application, const char * pszFileSuffix,
   A2AMesonFieldPar.output.append( pszFileSuffix );
   A2AMesonFieldPar.gammas="Identity";
   A2AMesonFieldPar.mom={"0 0 0"};
-  A2AMesonFieldPar.cacheBlock=2;
-  A2AMesonFieldPar.block=4;
+  A2AMesonFieldPar.cacheBlock=cacheBlock;
+  A2AMesonFieldPar.block=block;
   std::string sObjectName{"DistilMesonField"};
   sObjectName.append( pszFileSuffix );
   application.createModule<MContraction::A2AMesonField>(sObjectName, A2AMesonFieldPar);
@@ -349,6 +350,8 @@ int main(int argc, char *argv[])
       test_DistilVectors( application );
       test_MesonField( application, "Phi", "phi" );
       test_MesonField( application, "Rho", "rho" );
+      // block sizes 0 (auto) calibrated at execution
+      test_MesonField( application, "PhiAuto", "phi", "phi", 0, 0 );
       break;
     case 1:
       LOG(Message) << "Computing Meson 2pt-function by loading perambulators" << std::endl;
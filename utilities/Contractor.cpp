@@ -28,12 +28,64 @@
 #include <Hadrons/DiskVector.hpp>
 #include <Hadrons/Module.hpp>
 #include <Hadrons/TimerArray.hpp>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
 
 using namespace Grid;
 using namespace Hadrons;
 
 #define TIME_MOD(t) (((t) + par.global.nt) % par.global.nt)
 
+// memory budget (in MB) for the memoised partial products of a contraction
+#ifndef HADRONS_CONTRACTOR_PREFIX_MEM
+#define HADRONS_CONTRACTOR_PREFIX_MEM 1024
+#endif
+
+// maximum number of steps evaluated together (0: number of translations) and
+// matrix size below which the products of a batch are always run concurrently
+#ifndef HADRONS_CONTRACTOR_BATCH
+#define HADRONS_CONTRACTOR_BATCH 0
+#endif
+#ifndef HADRONS_CONTRACTOR_SMALL_N
+#define HADRONS_CONTRACTOR_SMALL_N 128
+#endif
+
+// default memory budget (in MB) for the transposed last terms kept across 
+// products, used when the trCacheMem global parameter is not set
+#ifndef HADRONS_CONTRACTOR_TR_CACHE_MEM
+#define HADRONS_CONTRACTOR_TR_CACHE_MEM 256
+#endif
+
+// number of timeslices loaded ahead by the disk vector background loader 
+// (0: disabled), only used with a cache size of at least this plus 2
+#ifndef HADRONS_CONTRACTOR_PREFETCH
+#define HADRONS_CONTRACTOR_PREFETCH 2
+#endif
+
+// number of evicted timeslices queued for saving by the disk vector 
+// background writer while loading the matrices (0: synchronous saves)
+#ifndef HADRONS_CONTRACTOR_WRITE_BEHIND
+#define HADRONS_CONTRACTOR_WRITE_BEHIND 2
+#endif
+
+#ifdef GRID_COMMS_MPI3
+#define INIT() MPI_Init(NULL, NULL)
+#define FINALIZE() MPI_Finalize()
+#define GET_RANK(rank, nMpi) \
+MPI_Comm_size(MPI_COMM_WORLD, &(nMpi));\
+MPI_Comm_rank(MPI_COMM_WORLD, &(rank))
+#define SUM_COMPLEXD(buf, n) \
+MPI_Allreduce(MPI_IN_PLACE, (buf), 2*(n), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD)
+#else
+#define INIT()
+#define FINALIZE()
+#define GET_RANK(rank, nMpi) (nMpi) = 1; (rank) = 0
+#define SUM_COMPLEXD(buf, n)
+#endif
+
 namespace Contractor
 {
     class TrajRange: Serializable
@@ -52,7 +104,12 @@ namespace Contractor
                                         TrajRange, trajCounter,
                                         unsigned int, nt,
                                         std::string, diskVectorDir,
-                                        std::string, output);
+                                        std::string, diskVectorBackend,
+                                        double, cacheBudget,
+                                        double, trCacheMem,
+                                        std::string, output,
+                                        std::string, outputMode,
+                                        std::string, precision);
     };
 
     class A2AMatrixPar: Serializable
@@ -84,6 +141,17 @@ namespace Contractor
                                         std::vector<unsigned int>, times,
                                         std::vector<ComplexD>, correlator);
     };
+
+    class CorrelatorIndex: Serializable
+    {
+    public:
+        GRID_SERIALIZABLE_CLASS_MEMBERS(CorrelatorIndex,
+                                        std::string, name,
+                                        std::string, terms,
+                                        std::vector<unsigned int>, times,
+                                        unsigned int, dt,
+                                        bool, translationAverage);
+    };
 }
 
 struct ContractorPar
@@ -120,21 +188,30 @@ void makeTimeSeq(std::vector<std::vector<unsigned int>> &timeSeq,
     makeTimeSeq(timeSeq, times, current, times.size());
 }
 
-void saveCorrelator(const Contractor::CorrelatorResult &result, const std::string dir, 
-                    const unsigned int dt, const unsigned int traj)
+std::string correlatorName(const Contractor::CorrelatorResult &result, 
+                           const unsigned int dt)
 {
-    std::string              fileStem = "", filename;
+    std::string              name = "";
     std::vector<std::string> terms = strToVec<std::string>(result.contraction.terms);
 
     for (unsigned int i = 0; i < terms.size() - 1; i++)
     {
-        fileStem += terms[i] + "_" + std::to_string(result.times[i]) + "_";
+        name += terms[i] + "_" + std::to_string(result.times[i]) + "_";
     }
-    fileStem += terms.back();
+    name += terms.back();
     if (!result.contraction.translationAverage)
     {
-        fileStem += "_dt_" + std::to_string(dt);
+        name += "_dt_" + std::to_string(dt);
     }
+
+    return name;
+}
+
+void saveCorrelator(const Contractor::CorrelatorResult &result, const std::string dir, 
+                    const unsigned int dt, const unsigned int traj)
+{
+    std::string fileStem = correlatorName(result, dt), filename;
+
     filename = dir + "/" + ModuleBase::resultFilename(fileStem, traj);
     std::cout << "Saving correlator to '" << filename << "'" << std::endl;
     makeFileDir(dir);
@@ -142,6 +219,104 @@ void saveCorrelator(const Contractor::CorrelatorResult &result, const std::strin
     write(writer, fileStem, result);
 }
 
+// all the correlators of a trajectory in a single result file, followed by 
+// an index of their names, times and translations, write() only queues the 
+// correlator which is written by a background thread, close() waits for the 
+// queue to be written and closes the file, without async the queue is written
+// by close() (HDF5 calls must not overlap with reads from another thread)
+class CorrelatorFileWriter
+{
+public:
+    CorrelatorFileWriter(const std::string filename, const bool async = true)
+    : filename_(filename)
+    {
+        std::cout << "Saving correlators to '" << filename_ << "'" << std::endl;
+        makeFileDir(filename_);
+        if (async)
+        {
+            thread_ = std::thread(&CorrelatorFileWriter::run, this);
+        }
+    }
+
+    ~CorrelatorFileWriter(void)
+    {
+        close();
+    }
+
+    void write(const Contractor::CorrelatorResult &result, const unsigned int dt)
+    {
+        Contractor::CorrelatorIndex ind;
+
+        ind.name               = correlatorName(result, dt);
+        ind.terms              = result.contraction.terms;
+        ind.times              = result.times;
+        ind.dt                 = dt;
+        ind.translationAverage = result.contraction.translationAverage;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            index_.push_back(ind);
+            queue_.push_back(std::make_pair(ind.name, result));
+        }
+        cv_.notify_one();
+    }
+
+    void close(void)
+    {
+        if (done_)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            done_ = true;
+        }
+        if (thread_.joinable())
+        {
+            cv_.notify_one();
+            thread_.join();
+        }
+        else
+        {
+            run();
+        }
+        std::cout << index_.size() << " correlator(s) saved to '" 
+                  << filename_ << "'" << std::endl;
+    }
+private:
+    void run(void)
+    {
+        ResultWriter writer(filename_);
+
+        while (true)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+
+            cv_.wait(lock, [this](){return done_ or !queue_.empty();});
+            if (queue_.empty())
+            {
+                break;
+            }
+
+            auto entry = std::move(queue_.front());
+
+            queue_.pop_front();
+            lock.unlock();
+            Grid::write(writer, entry.first, entry.second);
+        }
+        Grid::write(writer, "index", index_);
+    }
+private:
+    std::string                                                      filename_;
+    std::deque<std::pair<std::string, Contractor::CorrelatorResult>> queue_;
+    std::vector<Contractor::CorrelatorIndex>                         index_;
+    std::mutex                                                       mutex_;
+    std::condition_variable                                          cv_;
+    bool                                                             done_{false};
+    std::thread                                                      thread_;
+};
+
 std::set<unsigned int> parseTimeRange(const std::string str, const unsigned int nt)
 {
     std::regex               rex("([0-9]+)|(([0-9]+)\\.\\.([0-9]+))");
@@ -183,6 +358,141 @@ std::set<unsigned int> parseTimeRange(const std::string str, const unsigned int
     return tSet;
 }
 
+// (time sequence, translation) pairs of a product, key holds the times of the
+// factors A0*A1*...*An-1 after translation, dti is the index of the translation
+// and reuse is the number of leading factors shared with the previous step of 
+// the schedule
+struct ProductStep
+{
+    unsigned int              seq, dt, dti, reuse;
+    std::vector<unsigned int> key;
+};
+
+// sorting the steps by key walks the prefix trie of all the products in 
+// depth-first order, so that a product prefix is computed once and reused by 
+// all the consecutive steps sharing it
+std::vector<ProductStep> makeProductSchedule(const std::vector<std::vector<unsigned int>> &timeSeq,
+                                             const std::set<unsigned int> &translations,
+                                             const unsigned int nt)
+{
+    std::vector<ProductStep> sched;
+
+    for (unsigned int i = 0; i < timeSeq.size(); ++i)
+    {
+        unsigned int dti = 0;
+
+        for (auto dt: translations)
+        {
+            ProductStep step;
+
+            step.seq   = i;
+            step.dt    = dt;
+            step.dti   = dti++;
+            step.reuse = 0;
+            for (auto t: timeSeq[i])
+            {
+                step.key.push_back((t + dt) % nt);
+            }
+            sched.push_back(step);
+        }
+    }
+    std::stable_sort(sched.begin(), sched.end(), 
+    [](const ProductStep &a, const ProductStep &b)
+    {
+        return (a.key < b.key);
+    });
+    for (unsigned int s = 1; s < sched.size(); ++s)
+    {
+        auto &prev = sched[s - 1].key, &key = sched[s].key;
+
+        while ((sched[s].reuse < key.size()) 
+               and (key[sched[s].reuse] == prev[sched[s].reuse]))
+        {
+            sched[s].reuse++;
+        }
+    }
+
+    return sched;
+}
+
+// number of A*B needed by a step of a product with nFac factors in the 
+// matrix product, given the number of leading factors shared with the 
+// previous step and the number of memoised prefixes
+unsigned int stepMulCount(const unsigned int nFac, const unsigned int reuse,
+                          const unsigned int nMemo)
+{
+    if (reuse >= nFac)
+    {
+        return 0;
+    }
+    else
+    {
+        return nFac - 1 - std::min(std::max(reuse, 1u) - 1, nMemo);
+    }
+}
+
+// contraction of a product, steps [begin, end) of the schedule are run by
+// the current process
+struct ProductPlan
+{
+    std::vector<std::string>               term;
+    std::vector<std::vector<unsigned int>> timeSeq;
+    std::set<unsigned int>                 translations;
+    std::vector<ProductStep>               sched;
+    std::vector<double>                    cost;
+    unsigned int                           nMemo{0}, begin{0}, end{0};
+};
+
+// run the independent products of a batch level concurrently, one thread 
+// each, if there are enough of them to occupy all threads or if the matrices
+// are too small for a threaded product to scale
+bool batchParallel(const unsigned int nProd, const unsigned int n)
+{
+    unsigned int nThread = 1;
+
+#ifdef GRID_OMP
+    nThread = omp_get_max_threads();
+#endif
+
+    return (nProd > 1) and ((nProd >= nThread) or (n <= HADRONS_CONTRACTOR_SMALL_N));
+}
+
+// split the schedules of all products in contiguous chunks of similar 
+// estimated cost, contiguity preserves the prefix reuse within a chunk
+void partitionProducts(std::vector<ProductPlan> &plan, const int rank, 
+                       const int nMpi, std::vector<double> &rankCost,
+                       std::vector<unsigned int> &rankStep)
+{
+    double total = 0., cum = 0.;
+
+    rankCost.assign(nMpi, 0.);
+    rankStep.assign(nMpi, 0);
+    for (auto &pl: plan)
+    for (auto c: pl.cost)
+    {
+        total += c;
+    }
+    for (auto &pl: plan)
+    {
+        pl.begin = pl.sched.size();
+        pl.end   = pl.sched.size();
+        for (unsigned int s = 0; s < pl.sched.size(); ++s)
+        {
+            int r = (total > 0.) ? (cum + pl.cost[s]/2.)/total*nMpi : 0;
+
+            r    = std::min(r, nMpi - 1);
+            cum += pl.cost[s];
+            rankCost[r] += pl.cost[s];
+            rankStep[r]++;
+            if (r == rank)
+            {
+                pl.begin = std::min(pl.begin, s);
+                pl.end   = s + 1;
+            }
+        }
+    }
+}
+
 struct Sec
 {
     Sec(const double usec)
@@ -234,10 +544,403 @@ inline std::ostream & operator<< (std::ostream& s, const Bytes &&b)
     return s;
 }
 
+// transposed copies of the last terms of the products, kept across products
+// within a trajectory and evicted in least recently used order when they 
+// exceed the memory budget (in bytes); the cache is a client of the disk 
+// vector cache manager, so that with a process-wide budget the transposes 
+// are counted and evicted together with the disk vector caches, the entry
+// returned by the last call to get is never evicted
+template <typename T>
+class TransposeCache: public DiskVectorCacheClient
+{
+public:
+    typedef std::vector<A2AMatrixTr<T>> Entry;
+public:
+    TransposeCache(const std::string name, const double maxBytes)
+    : name_(name), maxBytes_(maxBytes)
+    {
+        DiskVectorCacheManager::getInstance().registerClient(this);
+    }
+
+    virtual ~TransposeCache(void)
+    {
+        DiskVectorCacheManager::getInstance().unregisterClient(this);
+    }
+
+    void clear(void)
+    {
+        entry_.clear();
+        stamp_.clear();
+        lru_.clear();
+        bytes_ = 0.;
+    }
+
+    template <typename Vec>
+    const Entry & get(const std::string &name, const Vec &vec,
+                      const unsigned int nt, TimerArray &tAr, std::ostream &out)
+    {
+        auto &manager = DiskVectorCacheManager::getInstance();
+        auto it       = entry_.find(name);
+
+        if (it != entry_.end())
+        {
+            out << "* Transposed last term found in cache" << std::endl;
+            lru_.remove(name);
+            lru_.push_front(name);
+            stamp_[name] = manager.tick();
+            hit_++;
+
+            return it->second;
+        }
+
+        Entry  &e = entry_[name];
+        double bytes, t0 = tAr.getDTimer("Transpose caching");
+
+        out << "* Caching transposed last term" << std::endl;
+        miss_++;
+        e.resize(nt);
+        for (unsigned int t = 0; t < nt; ++t)
+        {
+            tAr.startTimer("Disk vector overhead");
+            const auto &ref = vec[t];
+            tAr.stopTimer("Disk vector overhead");
+
+            tAr.startTimer("Transpose caching");
+            e[t].resize(ref.rows(), ref.cols());
+            thread_for( j,ref.cols(),{
+              for (unsigned int i = 0; i < ref.rows(); ++i)
+              {
+                  e[t](i, j) = ref(i, j);
+              }
+            });
+            tAr.stopTimer("Transpose caching");
+        }
+        bytes   = entryBytes(e);
+        bytes_ += bytes;
+        lru_.push_front(name);
+        stamp_[name] = manager.tick();
+        out << Sec(tAr.getDTimer("Transpose caching") - t0) << " " 
+            << Bytes(bytes, tAr.getDTimer("Transpose caching") - t0) << std::endl;
+        while ((bytes_ > maxBytes_) and (lru_.size() > 1))
+        {
+            cacheEvictLru();
+        }
+        manager.reserve();
+
+        return e;
+    }
+
+    // cache manager interface
+    virtual std::string cacheName(void) const
+    {
+        return name_;
+    }
+
+    virtual unsigned int cacheCount(void) const
+    {
+        return entry_.size();
+    }
+
+    virtual double cacheBytes(void) const
+    {
+        return bytes_;
+    }
+
+    virtual double hitCount(void) const
+    {
+        return hit_;
+    }
+
+    virtual double missCount(void) const
+    {
+        return miss_;
+    }
+
+    virtual bool cacheLruStamp(uint64_t &stamp) const
+    {
+        if (lru_.size() > 1)
+        {
+            stamp = stamp_.at(lru_.back());
+
+            return true;
+        }
+
+        return false;
+    }
+
+    virtual void cacheEvictLru(void) const
+    {
+        auto &old = entry_.at(lru_.back());
+
+        bytes_ -= entryBytes(old);
+        entry_.erase(lru_.back());
+        stamp_.erase(lru_.back());
+        lru_.pop_back();
+    }
+private:
+    static double entryBytes(const Entry &e)
+    {
+        return e.size()*e[0].rows()*e[0].cols()*sizeof(T);
+    }
+private:
+    std::string                             name_;
+    double                                  maxBytes_, hit_{0.}, miss_{0.};
+    mutable double                          bytes_{0.};
+    mutable std::map<std::string, Entry>    entry_;
+    mutable std::map<std::string, uint64_t> stamp_;
+    mutable std::list<std::string>          lru_;
+};
+
+// matrices by name, either staged in disk vectors or read directly from their
+// file (A2AMatrixDiskVector), or staged in memory-mapped disk vectors
+template <typename T, template <class> class Vec = EigenDiskVector>
+using A2AMatrixMap = std::map<std::string, std::unique_ptr<Vec<T>>>;
+
+// contract the steps of a product run by the current process with matrices
+// of type T, the traces are accumulated in double precision in corr, indexed 
+// by (time sequence, translation, time)
+template <typename T, template <class> class Vec>
+void contractProduct(std::vector<ComplexD> &corr, const ProductPlan &pl, 
+                     const Contractor::ProductPar &p, const ContractorPar &par,
+                     const A2AMatrixMap<T, Vec> &a2aMat,
+                     TransposeCache<T> &trCache, TimerArray &tAr, std::ostream &out)
+{
+    auto                                 &term         = pl.term;
+    auto                                 &timeSeq      = pl.timeSeq;
+    auto                                 &translations = pl.translations;
+    auto                                 &sched        = pl.sched;
+    const unsigned int                   nFac          = term.size() - 1;
+    const unsigned int                   nMemo         = pl.nMemo;
+    const unsigned int                   nCorrDt       = p.translationAverage ? 1 : translations.size();
+    const unsigned int                   nBatch        = (HADRONS_CONTRACTOR_BATCH > 0) ?
+                                                         HADRONS_CONTRACTOR_BATCH : translations.size();
+    A2AMatrix<T>                         buf, tmp;
+    // prefix[k] memoises the product of the first k + 2 factors, the
+    // last one being the full product, which is always kept
+    std::vector<A2AMatrix<T>>            prefix;
+    std::vector<unsigned int>            rootKey;
+    std::vector<A2AMatrix<T>>            lev, nextLev;
+    std::map<unsigned int, A2AMatrix<T>> operand;
+    unsigned int                         b0 = pl.begin, b1, nMul = 0;
+    double                               fusec, busec, flops, bytes;
+
+    if (pl.begin == pl.end)
+    {
+        return;
+    }
+
+    auto mat = [&a2aMat](const std::string &name) -> const Vec<T> &
+    {
+        return *a2aMat.at(name);
+    };
+
+    const auto &lastTerm = trCache.get(term.back(), *a2aMat.at(term.back()), 
+                                       par.global.nt, tAr, out);
+
+    // steps are evaluated in batches of consecutive steps sharing their
+    // first factor, the product of the factors common to the whole batch 
+    // (its root) reuses the memoised prefixes of the previous root, the 
+    // remaining products are evaluated level by level, running the 
+    // independent products of a level together
+    if (nFac > 1)
+    {
+        prefix.resize(nFac - 1);
+    }
+    while (b0 < pl.end)
+    {
+        unsigned int                      L = 0, c = 0;
+        int                               k0;
+        A2AMatrix<T>                      *root;
+        std::vector<unsigned int>         node;
+        std::vector<const A2AMatrix<T> *> leaf;
+
+        b1 = b0 + 1;
+        while ((b1 < pl.end) and (b1 - b0 < nBatch) 
+               and (sched[b1].key[0] == sched[b0].key[0]))
+        {
+            b1++;
+        }
+
+        auto &first = sched[b0].key, &last = sched[b1 - 1].key;
+
+        while ((L < nFac) and (first[L] == last[L]))
+        {
+            L++;
+        }
+        out << "* Steps " << b0 - pl.begin + 1 << "-" << b1 - pl.begin 
+            << "/" << pl.end - pl.begin << std::endl;
+        for (unsigned int s = b0; s < b1; ++s)
+        {
+            out << "  positions= " << timeSeq[sched[s].seq] << ", dt= " 
+                << sched[s].dt << std::endl;
+        }
+        if (nFac > 1)
+        {
+            out << std::setw(8) << "products";
+        }
+        flops  = 0.;
+        bytes  = 0.;
+        fusec  = tAr.getDTimer("A*B algebra");
+        busec  = tAr.getDTimer("A*B total");
+        tAr.startTimer("Linear algebra");
+
+        // root, deepest valid memoised prefix first
+        while ((c < rootKey.size()) and (rootKey[c] == first[c]))
+        {
+            c++;
+        }
+        k0 = std::min({static_cast<int>(c) - 2, static_cast<int>(nMemo) - 1, 
+                       static_cast<int>(L) - 2});
+        if ((c == rootKey.size()) and (c >= 2) and (c <= L))
+        {
+            k0 = std::max(k0, static_cast<int>(c) - 2);
+        }
+        k0 = std::max(k0, -1);
+        if (k0 < 0)
+        {
+            tAr.startTimer("Disk vector overhead");
+            buf  = mat(term[0])[first[0]];
+            tAr.stopTimer("Disk vector overhead");
+            root = &buf;
+        }
+        else
+        {
+            root = &prefix[k0];
+        }
+        for (unsigned int k = k0 + 1; k + 2 <= L; ++k)
+        {
+            tAr.startTimer("Disk vector overhead");
+            const auto &ref = mat(term[k + 1])[first[k + 1]];
+            tAr.stopTimer("Disk vector overhead");
+
+            tAr.startTimer("A*B total");
+            tAr.startTimer("A*B algebra");
+            A2AContraction::mul(tmp, *root, ref);
+            tAr.stopTimer("A*B algebra");
+            flops += A2AContraction::mulFlops(*root, ref);
+            if ((k < nMemo) or (k + 2 == L))
+            {
+                prefix[k].swap(tmp);
+                root = &prefix[k];
+            }
+            else
+            {
+                buf.swap(tmp);
+                root = &buf;
+            }
+            tAr.stopTimer("A*B total");
+            bytes += 3.*root->rows()*root->cols()*sizeof(T);
+            nMul++;
+        }
+        rootKey.assign(first.begin(), first.begin() + L);
+
+        // products below the root, one level per factor
+        node.assign(b1 - b0, 0);
+        for (unsigned int k = L - 1; k + 1 < nFac; ++k)
+        {
+            std::vector<unsigned int>         parent, time, child(b1 - b0);
+            std::vector<const A2AMatrix<T> *> left, right;
+
+            for (unsigned int s = b0; s < b1; ++s)
+            {
+                unsigned int i = s - b0;
+
+                if ((s == b0) or (node[i] != node[i - 1]) 
+                    or (sched[s].key[k + 1] != sched[s - 1].key[k + 1]))
+                {
+                    parent.push_back(node[i]);
+                    time.push_back(sched[s].key[k + 1]);
+                }
+                child[i] = parent.size() - 1;
+            }
+            node = child;
+            tAr.startTimer("Disk vector overhead");
+            operand.clear();
+            for (auto t: time)
+            {
+                if (operand.find(t) == operand.end())
+                {
+                    operand[t] = mat(term[k + 1])[t];
+                }
+            }
+            tAr.stopTimer("Disk vector overhead");
+            nextLev.resize(parent.size());
+            for (unsigned int n = 0; n < parent.size(); ++n)
+            {
+                left.push_back((k + 1 == L) ? root : &lev[parent[n]]);
+                right.push_back(&operand.at(time[n]));
+            }
+            tAr.startTimer("A*B total");
+            tAr.startTimer("A*B algebra");
+            if (batchParallel(parent.size(), root->rows()))
+            {
+                thread_for(n, parent.size(),
+                {
+                    A2AContraction::mul(nextLev[n], *left[n], *right[n]);
+                });
+            }
+            else
+            {
+                for (unsigned int n = 0; n < parent.size(); ++n)
+                {
+                    A2AContraction::mul(nextLev[n], *left[n], *right[n]);
+                }
+            }
+            tAr.stopTimer("A*B algebra");
+            for (unsigned int n = 0; n < parent.size(); ++n)
+            {
+                flops += A2AContraction::mulFlops(*left[n], *right[n]);
+                bytes += 3.*nextLev[n].rows()*nextLev[n].cols()*sizeof(T);
+            }
+            lev.swap(nextLev);
+            tAr.stopTimer("A*B total");
+            nMul += parent.size();
+        }
+        for (unsigned int i = 0; i < b1 - b0; ++i)
+        {
+            leaf.push_back((L == nFac) ? root : &lev[node[i]]);
+        }
+        if (nFac > 1)
+        {
+            out << Sec(tAr.getDTimer("A*B total") - busec) << " "
+                << Flops(flops, tAr.getDTimer("A*B algebra") - fusec) << " " 
+                << Bytes(bytes, tAr.getDTimer("A*B total") - busec) << std::endl;
+        }
+        out << std::setw(8) << "traces";
+        flops  = 0.;
+        bytes  = 0.;
+        fusec  = tAr.getDTimer("tr(A*B)");
+        busec  = tAr.getDTimer("tr(A*B)");
+        for (unsigned int s = b0; s < b1; ++s)
+        {
+            auto               &step = sched[s];
+            const A2AMatrix<T> &cur  = *leaf[s - b0];
+            ComplexD           *cr   = corr.data() 
+                + (step.seq*nCorrDt + (p.translationAverage ? 0 : step.dti))*par.global.nt;
+
+            for (unsigned int tLast = 0; tLast < par.global.nt; ++tLast)
+            {
+                tAr.startTimer("tr(A*B)");
+                A2AContraction::accTrMul(cr[TIME_MOD(tLast - step.dt)], cur, lastTerm[tLast]);
+                tAr.stopTimer("tr(A*B)");
+                flops += A2AContraction::accTrMulFlops(cur, lastTerm[tLast]);
+                bytes += 2.*cur.rows()*cur.cols()*sizeof(T);
+            }
+        }
+        tAr.stopTimer("Linear algebra");
+        out << Sec(tAr.getDTimer("tr(A*B)") - busec) << " "
+            << Flops(flops, tAr.getDTimer("tr(A*B)") - fusec) << " " 
+            << Bytes(bytes, tAr.getDTimer("tr(A*B)") - busec) << std::endl;
+        b0 = b1;
+    }
+    out << nMul << " A*B performed" << std::endl;
+}
+
 int main(int argc, char* argv[])
 {
     // parse command line
     std::string   parFilename;
+    int           nMpi, rank;
 
     if (argc != 2)
     {
@@ -247,6 +950,12 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
     parFilename = argv[1];
+    INIT();
+    GET_RANK(rank, nMpi);
+
+    // only the first process reports progress
+    std::ostream  nullStream(nullptr);
+    std::ostream  &out = (rank == 0) ? std::cout : nullStream;
 
     // parse parameter file
     ContractorPar par;
@@ -259,73 +968,343 @@ int main(int argc, char* argv[])
     //    nMat  = par.a2aMatrix.size();
     //    nCont = par.product.size();
 
-    // create diskvectors
-    std::map<std::string, EigenDiskVector<ComplexD>> a2aMat;
-    //    unsigned int                                     cacheSize;
+    // contraction precision: double (default), single, or validate (double
+    // precision results, with the deviation of the single precision ones)
+    bool useDouble, useSingle;
+
+    if (par.global.precision.empty())
+    {
+        par.global.precision = "double";
+    }
+    if ((par.global.precision != "double") and (par.global.precision != "single")
+        and (par.global.precision != "validate"))
+    {
+        HADRONS_ERROR(Argument, "unknown precision '" + par.global.precision 
+                      + "' (expected double, single or validate)");
+    }
+    useDouble = (par.global.precision != "single");
+    useSingle = (par.global.precision != "double");
+    out << "Contraction precision: " << par.global.precision << std::endl;
+
+    // output mode: one file per correlator (file, default) or one file per 
+    // trajectory written in the background (trajectory)
+    bool trajOutput;
+
+    if (par.global.outputMode.empty())
+    {
+        par.global.outputMode = "file";
+    }
+    if ((par.global.outputMode != "file") and (par.global.outputMode != "trajectory"))
+    {
+        HADRONS_ERROR(Argument, "unknown output mode '" + par.global.outputMode 
+                      + "' (expected file or trajectory)");
+    }
+    trajOutput = (par.global.outputMode == "trajectory");
+
+    // disk vector backend: file (default, matrices staged in diskVectorDir),
+    // hdf5 (timeslices read from the matrix files on cache miss) or mmap
+    // (matrices staged in diskVectorDir and used in place through memory 
+    // maps, the cache sizes are ignored)
+    bool hdf5Backend, mmapBackend;
+
+    if (par.global.diskVectorBackend.empty())
+    {
+        par.global.diskVectorBackend = "file";
+    }
+    if ((par.global.diskVectorBackend != "file") and (par.global.diskVectorBackend != "hdf5")
+        and (par.global.diskVectorBackend != "mmap"))
+    {
+        HADRONS_ERROR(Argument, "unknown disk vector backend '" + par.global.diskVectorBackend 
+                      + "' (expected file, hdf5 or mmap)");
+    }
+    hdf5Backend = (par.global.diskVectorBackend == "hdf5");
+    mmapBackend = (par.global.diskVectorBackend == "mmap");
+
+    // optional memory budget (in MB) shared by the disk vector caches of the
+    // process, the matrix cache sizes are then ignored
+    bool useBudget = (par.global.cacheBudget > 0.);
+
+    if (useBudget)
+    {
+        DiskVectorCacheManager::getInstance().setBudget(par.global.cacheBudget*1024.*1024.);
+        out << "Disk vector cache budget: " << par.global.cacheBudget << " MB" << std::endl;
+    }
+
+    // memory budget (in MB) for the transposed last terms, also counted in
+    // the cache budget when there is one
+    double trCacheBytes;
+
+    if (par.global.trCacheMem <= 0.)
+    {
+        par.global.trCacheMem = HADRONS_CONTRACTOR_TR_CACHE_MEM;
+    }
+    trCacheBytes = par.global.trCacheMem*1024.*1024.;
+    out << "Transpose cache budget: " << par.global.trCacheMem << " MB" << std::endl;
+
+    // matrix dimensions, read from the first trajectory
+    std::map<std::string, std::pair<unsigned int, unsigned int>> dim;
+
+    for (auto &p: par.a2aMatrix)
+    {
+        std::string filename = p.file;
+
+        tokenReplace(filename, "traj", par.global.trajCounter.start);
+
+        A2AMatrixIo<HADRONS_A2AM_IO_TYPE> a2aIo(filename, p.dataset, par.global.nt);
+
+        a2aIo.loadDimensions();
+        dim[p.name] = std::make_pair(a2aIo.getNi(), a2aIo.getNj());
+    }
+
+    // contraction schedules and work partitioning between processes
+    std::vector<ProductPlan>  plan(par.product.size());
+    std::vector<double>       rankCost;
+    std::vector<unsigned int> rankStep;
+
+    for (unsigned int iProd = 0; iProd < par.product.size(); ++iProd)
+    {
+        auto                                &p  = par.product[iProd];
+        auto                                &pl = plan[iProd];
+        std::vector<std::set<unsigned int>> times;
+        unsigned int                        nFac;
+        double                              ni, nj, matBytes;
+
+        pl.term = strToVec<std::string>(p.terms);
+        if (pl.term.size() != p.times.size() + 1)
+        {
+            HADRONS_ERROR(Size, "number of terms (" + std::to_string(pl.term.size()) 
+                        + ") different from number of times (" 
+                        + std::to_string(p.times.size() + 1) + ")");
+        }
+        for (auto &s: p.times)
+        {
+            times.push_back(parseTimeRange(s, par.global.nt));
+        }
+        pl.translations = parseTimeRange(p.translations, par.global.nt);
+        makeTimeSeq(pl.timeSeq, times);
+        pl.sched = makeProductSchedule(pl.timeSeq, pl.translations, par.global.nt);
+
+        // memoise as many intermediate prefixes as the budget allows
+        nFac     = pl.term.size() - 1;
+        ni       = dim.at(pl.term[0]).first;
+        nj       = dim.at(pl.term[0]).second;
+        matBytes = ni*dim.at(pl.term.back()).first
+                   *(useDouble ? sizeof(ComplexD) : sizeof(ComplexF));
+        if (nFac > 2)
+        {
+            pl.nMemo = std::min(static_cast<double>(nFac - 2),
+                                std::floor(HADRONS_CONTRACTOR_PREFIX_MEM*1024.*1024./matBytes));
+        }
+
+        // estimated flops of each step
+        for (unsigned int s = 0; s < pl.sched.size(); ++s)
+        {
+            unsigned int c = (s > 0) ? pl.sched[s].reuse : 0;
+
+            pl.cost.push_back(8.*stepMulCount(nFac, c, pl.nMemo)*ni*nj*nj
+                              + 8.*par.global.nt*ni*nj);
+        }
+    }
+    partitionProducts(plan, rank, nMpi, rankCost, rankStep);
+    out << nMpi << " process(es)" << std::endl;
+    for (int r = 0; r < nMpi; ++r)
+    {
+        out << "process " << std::setw(4) << r << ": " << std::setw(8) 
+            << rankStep[r] << " step(s), " << rankCost[r]/1.0e9 << " GFlop (estimated)"
+            << std::endl;
+    }
+
+    // timeslices needed by this process, the last term of a product is
+    // traced over all times
+    std::map<std::string, std::vector<bool>> tSel;
 
     for (auto &p: par.a2aMatrix)
     {
-        std::string dirName = par.global.diskVectorDir + "/" + p.name;
+        tSel[p.name].assign(par.global.nt, false);
+    }
+    for (auto &pl: plan)
+    {
+        if (pl.begin < pl.end)
+        {
+            tSel.at(pl.term.back()).assign(par.global.nt, true);
+        }
+        for (unsigned int s = pl.begin; s < pl.end; ++s)
+        {
+            for (unsigned int j = 0; j < pl.term.size() - 1; ++j)
+            {
+                tSel.at(pl.term[j])[pl.sched[s].key[j]] = true;
+            }
+        }
+    }
+
+    // create diskvectors, one directory per process, with the hdf5 backend
+    // they are created for each trajectory and read from the matrix files
+    A2AMatrixMap<ComplexD>                        a2aMat;
+    A2AMatrixMap<ComplexF>                        a2aMatSp;
+    A2AMatrixMap<ComplexD, MappedEigenDiskVector> a2aMap;
+    A2AMatrixMap<ComplexF, MappedEigenDiskVector> a2aMapSp;
+    TransposeCache<ComplexD>                      trCache("transposes", trCacheBytes);
+    TransposeCache<ComplexF>                      trCacheSp("transposes (single)", trCacheBytes);
+
+    // with a cache budget each matrix can use up to all its timeslices
+    auto cacheSize = [&par, useBudget](const Contractor::A2AMatrixPar &p) -> unsigned int
+    {
+        return useBudget ? par.global.nt : p.cacheSize;
+    };
 
-        a2aMat.emplace(p.name, EigenDiskVector<ComplexD>(dirName, par.global.nt, p.cacheSize));
+    if (!hdf5Backend)
+    {
+        for (auto &p: par.a2aMatrix)
+        {
+            std::string dirName = par.global.diskVectorDir + "/" + p.name;
+            std::string rankDir = (nMpi > 1) ? "/rank_" + std::to_string(rank) : "";
+
+            bool        prefetch = (HADRONS_CONTRACTOR_PREFETCH > 0) and 
+                                   (cacheSize(p) >= HADRONS_CONTRACTOR_PREFETCH + 2);
+
+            if (mmapBackend)
+            {
+                if (useDouble)
+                {
+                    a2aMap[p.name].reset(new MappedEigenDiskVector<ComplexD>(dirName + rankDir,
+                                                                             par.global.nt));
+                }
+                if (useSingle)
+                {
+                    a2aMapSp[p.name].reset(new MappedEigenDiskVector<ComplexF>(dirName + "_single" + rankDir,
+                                                                               par.global.nt));
+                }
+                continue;
+            }
+            if (useDouble)
+            {
+                a2aMat[p.name].reset(new EigenDiskVector<ComplexD>(dirName + rankDir, 
+                                                                   par.global.nt, cacheSize(p)));
+                if (HADRONS_CONTRACTOR_WRITE_BEHIND > 0)
+                {
+                    a2aMat[p.name]->enableWriteBehind(HADRONS_CONTRACTOR_WRITE_BEHIND);
+                }
+                if (prefetch)
+                {
+                    a2aMat[p.name]->enablePrefetch(HADRONS_CONTRACTOR_PREFETCH);
+                }
+            }
+            if (useSingle)
+            {
+                a2aMatSp[p.name].reset(new EigenDiskVector<ComplexF>(dirName + "_single" + rankDir, 
+                                                                     par.global.nt, cacheSize(p)));
+                if (HADRONS_CONTRACTOR_WRITE_BEHIND > 0)
+                {
+                    a2aMatSp[p.name]->enableWriteBehind(HADRONS_CONTRACTOR_WRITE_BEHIND);
+                }
+                if (prefetch)
+                {
+                    a2aMatSp[p.name]->enablePrefetch(HADRONS_CONTRACTOR_PREFETCH);
+                }
+            }
+        }
     }
 
     // trajectory loop
     for (unsigned int traj = par.global.trajCounter.start; 
          traj < par.global.trajCounter.end; traj += par.global.trajCounter.step)
     {
-        std::cout << ":::::::: Trajectory " << traj << std::endl;
+        out << ":::::::: Trajectory " << traj << std::endl;
 
         // load data
         for (auto &p: par.a2aMatrix)
         {
-            std::string filename = p.file;
-            double      t;
-	    //	    double  size;
+            std::string  filename = p.file;
+            double       t, size;
+            unsigned int nLoad = std::count(tSel.at(p.name).begin(), tSel.at(p.name).end(), true);
 
+            if (nLoad == 0)
+            {
+                continue;
+            }
             tokenReplace(filename, "traj", traj);
-            std::cout << "======== Loading '" << filename << "'" << std::endl;
+            if (hdf5Backend)
+            {
+                out << "======== Reading '" << filename << "' on demand" << std::endl;
+                if (useDouble)
+                {
+                    a2aMat[p.name].reset(new A2AMatrixDiskVector<ComplexD>(filename, 
+                        p.dataset, par.global.nt, cacheSize(p)));
+                }
+                if (useSingle)
+                {
+                    a2aMatSp[p.name].reset(new A2AMatrixDiskVector<ComplexF>(filename, 
+                        p.dataset, par.global.nt, cacheSize(p)));
+                }
+                continue;
+            }
+            out << "======== Loading '" << filename << "'" << std::endl;
 
             A2AMatrixIo<HADRONS_A2AM_IO_TYPE> a2aIo(filename, p.dataset, par.global.nt);
 
-            a2aIo.load(a2aMat.at(p.name), &t);
-            std::cout << "Read " << a2aIo.getSize() << " bytes in " << t/1.0e6 
-                    << " sec, " << a2aIo.getSize()/t*1.0e6/1024/1024 << " MB/s" << std::endl;
+            size = 0.;
+            if (useDouble)
+            {
+                if (mmapBackend)
+                {
+                    a2aIo.load(*a2aMap.at(p.name), tSel.at(p.name), &t);
+                }
+                else
+                {
+                    a2aIo.load(*a2aMat.at(p.name), tSel.at(p.name), &t);
+                }
+                size += static_cast<double>(a2aIo.getSize())*nLoad/par.global.nt;
+            }
+            if (useSingle)
+            {
+                double tSp;
+
+                if (mmapBackend)
+                {
+                    a2aIo.load(*a2aMapSp.at(p.name), tSel.at(p.name), &tSp);
+                }
+                else
+                {
+                    a2aIo.load(*a2aMatSp.at(p.name), tSel.at(p.name), &tSp);
+                }
+                size += static_cast<double>(a2aIo.getSize())*nLoad/par.global.nt;
+                t     = useDouble ? t + tSp : tSp;
+            }
+            out << "Read " << size << " bytes in " << t/1.0e6 
+                << " sec, " << size/t*1.0e6/1024/1024 << " MB/s" << std::endl;
         }
 
         // contract
-        EigenDiskVector<ComplexD>::Matrix buf;
+        std::unique_ptr<CorrelatorFileWriter> writer;
 
-        for (auto &p: par.product)
+        if ((rank == 0) and trajOutput)
+        {
+            writer.reset(new CorrelatorFileWriter(par.global.output + "/" 
+                + ModuleBase::resultFilename("correlators", traj), !hdf5Backend));
+        }
+        trCache.clear();
+        trCacheSp.clear();
+        for (unsigned int iProd = 0; iProd < par.product.size(); ++iProd)
         {
-            std::vector<std::string>               term = strToVec<std::string>(p.terms);
-            std::vector<std::set<unsigned int>>    times;
-            std::vector<std::vector<unsigned int>> timeSeq;
-            std::set<unsigned int>                 translations;
-            std::vector<A2AMatrixTr<ComplexD>>     lastTerm(par.global.nt);
-            A2AMatrix<ComplexD>                    prod, buf, tmp;
-            TimerArray                             tAr;
-            double                                 fusec, busec, flops, bytes;
-	    //	    double  tusec;
-            Contractor::CorrelatorResult           result;             
+            auto                         &p            = par.product[iProd];
+            auto                         &pl           = plan[iProd];
+            auto                         &term         = pl.term;
+            auto                         &timeSeq      = pl.timeSeq;
+            auto                         &translations = pl.translations;
+            const unsigned int           nFac          = term.size() - 1;
+            const unsigned int           nCorrDt       = p.translationAverage ? 1 : translations.size();
+            // correlators indexed by (time sequence, translation, time)
+            std::vector<ComplexD>        corr(timeSeq.size()*nCorrDt*par.global.nt, 0.), corrSp;
+            TimerArray                   tAr;
+            Contractor::CorrelatorResult result;             
 
             tAr.startTimer("Total");
-            std::cout << "======== Contraction tr(";
+            out << "======== Contraction tr(";
             for (unsigned int g = 0; g < term.size(); ++g)
             {
-                std::cout << term[g] << ((g == term.size() - 1) ? ')' : '*');
-            }
-            std::cout << std::endl;
-            if (term.size() != p.times.size() + 1)
-            {
-                HADRONS_ERROR(Size, "number of terms (" + std::to_string(term.size()) 
-                            + ") different from number of times (" 
-                            + std::to_string(p.times.size() + 1) + ")");
-            }
-            for (auto &s: p.times)
-            {
-                times.push_back(parseTimeRange(s, par.global.nt));
+                out << term[g] << ((g == term.size() - 1) ? ')' : '*');
             }
+            out << std::endl;
             for (auto &m: par.a2aMatrix)
             {
                 if (std::find(result.a2aMatrix.begin(), result.a2aMatrix.end(), m) == result.a2aMatrix.end())
@@ -335,122 +1314,117 @@ int main(int argc, char* argv[])
                 }
             }
             result.contraction = p;
-            result.correlator.resize(par.global.nt, 0.);
-
-            translations = parseTimeRange(p.translations, par.global.nt);
-            makeTimeSeq(timeSeq, times);
-            std::cout << timeSeq.size()*translations.size()*(term.size() - 2) << " A*B, "
-                    << timeSeq.size()*translations.size()*par.global.nt << " tr(A*B)"
-                    << std::endl;
-
-            std::cout << "* Caching transposed last term" << std::endl;
-            for (unsigned int t = 0; t < par.global.nt; ++t)
-            {
-                tAr.startTimer("Disk vector overhead");
-                const A2AMatrix<ComplexD> &ref = a2aMat.at(term.back())[t];
-                tAr.stopTimer("Disk vector overhead");
-
-                tAr.startTimer("Transpose caching");
-                lastTerm[t].resize(ref.rows(), ref.cols());
-                thread_for( j,ref.cols(),{
-                  for (unsigned int i = 0; i < ref.rows(); ++i)
-                  {
-                      lastTerm[t](i, j) = ref(i, j);
-                  }
-		});
-                tAr.stopTimer("Transpose caching");
-            }
-            bytes = par.global.nt*lastTerm[0].rows()*lastTerm[0].cols()*sizeof(ComplexD);
-            std::cout << Sec(tAr.getDTimer("Transpose caching")) << " " 
-                      << Bytes(bytes, tAr.getDTimer("Transpose caching")) << std::endl;
-            for (unsigned int i = 0; i < timeSeq.size(); ++i)
-            {
-                unsigned int dti = 0;
-                auto         &t = timeSeq[i];
-
-                result.times = t;
-                for (unsigned int tLast = 0; tLast < par.global.nt; ++tLast)
+            out << (pl.end - pl.begin)*(nFac - 1) << " A*B without prefix reuse (" 
+                << pl.nMemo << " memoised prefix(es)), " 
+                << (pl.end - pl.begin)*par.global.nt << " tr(A*B) on this process"
+                << std::endl;
+            if (useDouble and mmapBackend)
+            {
+                contractProduct(corr, pl, p, par, a2aMap, trCache, tAr, out);
+            }
+            else if (useDouble)
+            {
+                contractProduct(corr, pl, p, par, a2aMat, trCache, tAr, out);
+            }
+            if (useSingle)
+            {
+                auto &c = useDouble ? corrSp : corr;
+
+                c.assign(corr.size(), 0.);
+                if (useDouble)
                 {
-                    result.correlator[tLast] = 0.;
+                    out << "-- Single precision validation" << std::endl;
                 }
-                for (auto &dt: translations)
+                if (mmapBackend)
                 {
-                    std::cout << "* Step " << i*translations.size() + dti + 1
-                            << "/" << timeSeq.size()*translations.size()
-                            << " -- positions= " << t << ", dt= " << dt << std::endl;
-                    if (term.size() > 2)
-                    {
-                        std::cout << std::setw(8) << "products";
-                    }
-                    flops  = 0.;
-                    bytes  = 0.;
-                    fusec  = tAr.getDTimer("A*B algebra");
-                    busec  = tAr.getDTimer("A*B total");
-                    tAr.startTimer("Linear algebra");
-                    tAr.startTimer("Disk vector overhead");
-                    prod = a2aMat.at(term[0])[TIME_MOD(t[0] + dt)];
-                    tAr.stopTimer("Disk vector overhead");
-                    for (unsigned int j = 1; j < term.size() - 1; ++j)
-                    {
-                        tAr.startTimer("Disk vector overhead");
-                        const A2AMatrix<ComplexD> &ref = a2aMat.at(term[j])[TIME_MOD(t[j] + dt)];
-                        tAr.stopTimer("Disk vector overhead");
-                        
-                        tAr.startTimer("A*B total");
-                        tAr.startTimer("A*B algebra");
-                        A2AContraction::mul(tmp, prod, ref);
-                        tAr.stopTimer("A*B algebra");
-                        flops += A2AContraction::mulFlops(prod, ref);
-                        prod   = tmp;
-                        tAr.stopTimer("A*B total");
-                        bytes += 3.*tmp.rows()*tmp.cols()*sizeof(ComplexD);
-                    }
-                    if (term.size() > 2)
-                    {
-                        std::cout << Sec(tAr.getDTimer("A*B total") - busec) << " "
-                                << Flops(flops, tAr.getDTimer("A*B algebra") - fusec) << " " 
-                                << Bytes(bytes, tAr.getDTimer("A*B total") - busec) << std::endl;
-                    }
-                    std::cout << std::setw(8) << "traces";
-                    flops  = 0.;
-                    bytes  = 0.;
-                    fusec  = tAr.getDTimer("tr(A*B)");
-                    busec  = tAr.getDTimer("tr(A*B)");
-                    for (unsigned int tLast = 0; tLast < par.global.nt; ++tLast)
-                    {
-                        tAr.startTimer("tr(A*B)");
-                        A2AContraction::accTrMul(result.correlator[TIME_MOD(tLast - dt)], prod, lastTerm[tLast]);
-                        tAr.stopTimer("tr(A*B)");
-                        flops += A2AContraction::accTrMulFlops(prod, lastTerm[tLast]);
-                        bytes += 2.*prod.rows()*prod.cols()*sizeof(ComplexD);
-                    }
-                    tAr.stopTimer("Linear algebra");
-                    std::cout << Sec(tAr.getDTimer("tr(A*B)") - busec) << " "
-                            << Flops(flops, tAr.getDTimer("tr(A*B)") - fusec) << " " 
-                            << Bytes(bytes, tAr.getDTimer("tr(A*B)") - busec) << std::endl;
-                    if (!p.translationAverage)
-                    {
-                        saveCorrelator(result, par.global.output, dt, traj);
-                        for (unsigned int tLast = 0; tLast < par.global.nt; ++tLast)
-                        {
-                            result.correlator[tLast] = 0.;
-                        }
-                    }
-                    dti++;
+                    contractProduct(c, pl, p, par, a2aMapSp, trCacheSp, tAr, out);
+                }
+                else
+                {
+                    contractProduct(c, pl, p, par, a2aMatSp, trCacheSp, tAr, out);
+                }
+            }
+
+            // reduce the correlators over processes and save them
+            tAr.startTimer("Reduction");
+            SUM_COMPLEXD(corr.data(), corr.size());
+            if (useDouble and useSingle)
+            {
+                SUM_COMPLEXD(corrSp.data(), corrSp.size());
+            }
+            tAr.stopTimer("Reduction");
+            if (useDouble and useSingle)
+            {
+                double maxAbs = 0., maxDiff = 0.;
+
+                for (unsigned int i = 0; i < corr.size(); ++i)
+                {
+                    maxAbs  = std::max(maxAbs, std::abs(corr[i]));
+                    maxDiff = std::max(maxDiff, std::abs(corrSp[i] - corr[i]));
                 }
-                if (p.translationAverage)
+                out << "Single precision deviation: max |diff| = " << maxDiff
+                    << ", relative to max |corr| = " 
+                    << ((maxAbs > 0.) ? maxDiff/maxAbs : 0.) << std::endl;
+            }
+            auto save = [&](const unsigned int dt)
+            {
+                tAr.startTimer("Output");
+                if (writer)
+                {
+                    writer->write(result, dt);
+                }
+                else
                 {
-                    for (unsigned int tLast = 0; tLast < par.global.nt; ++tLast)
+                    saveCorrelator(result, par.global.output, dt, traj);
+                }
+                tAr.stopTimer("Output");
+            };
+
+            if (rank == 0)
+            {
+                for (unsigned int i = 0; i < timeSeq.size(); ++i)
+                {
+                    unsigned int dti = 0;
+
+                    result.times = timeSeq[i];
+                    for (auto dt: translations)
                     {
-                        result.correlator[tLast] /= translations.size();
+                        auto begin = corr.begin() + (i*nCorrDt + dti)*par.global.nt;
+
+                        result.correlator.assign(begin, begin + par.global.nt);
+                        if (p.translationAverage)
+                        {
+                            for (auto &c: result.correlator)
+                            {
+                                c /= translations.size();
+                            }
+                            save(0);
+                            break;
+                        }
+                        save(dt);
+                        dti++;
                     }
-                    saveCorrelator(result, par.global.output, 0, traj);
                 }
             }
             tAr.stopTimer("Total");
-            printTimeProfile(tAr.getTimings(), tAr.getTimer("Total"));
+            if (rank == 0)
+            {
+                printTimeProfile(tAr.getTimings(), tAr.getTimer("Total"));
+            }
+        }
+        // the result file must be complete before the next trajectory reads
+        // HDF5 files from this thread
+        if (writer)
+        {
+            writer->close();
+        }
+        if (useBudget)
+        {
+            out << "======== Disk vector caches" << std::endl;
+            DiskVectorCacheManager::getInstance().printStat(out);
         }
     }
+    FINALIZE();
     
     return EXIT_SUCCESS;
 }
@@ -25,6 +25,9 @@
 /*  END LEGAL */
 #include <Hadrons/Global.hpp>
 #include <Hadrons/A2AMatrix.hpp>
+#include <Hadrons/DiskVector.hpp>
+#include <numeric>
+#include <random>
 #ifdef USE_MKL
 #include "mkl.h"
 #include "mkl_cblas.h"
@@ -35,6 +38,19 @@ using namespace Hadrons;
 const int RowMajor = Eigen::RowMajor;
 const int ColMajor = Eigen::ColMajor;
 
+// available A2AContraction backends, the default one is restored after use
+std::vector<A2AContraction::Backend> availableBackends(void)
+{
+    std::vector<A2AContraction::Backend> backend = {A2AContraction::Backend::eigen};
+
+    if (A2AContraction::hasBlas())
+    {
+        backend.push_back(A2AContraction::Backend::blas);
+    }
+
+    return backend;
+}
+
 #ifdef GRID_COMMS_MPI3
 #define GET_RANK(rank, nMpi) \
 MPI_Comm_size(MPI_COMM_WORLD, &(nMpi));\
@@ -51,6 +67,334 @@ assert(rank<nMpi)
 #define FINALIZE()
 #endif
 
+#define GIGA (1024.*1024.*1024.)
+
+/******************************************************************************
+ *                     Benchmark results and baselines                        *
+ ******************************************************************************/
+struct BenchmarkRecord
+{
+    std::string  section, name;
+    unsigned int ni{0}, nj{0}, nThread{1};
+    double       time{0.}, gflops{0.}, gbps{0.}, intensity{0.}, roofline{0.};
+    double       latency{0.};
+};
+
+// collects the results of all the benchmarks, computes the roofline fraction
+// of each kernel from the measured machine ceilings, and compares against a
+// baseline produced by a previous run (CSV output)
+class BenchmarkLog
+{
+public:
+    void setContext(const std::string section, const unsigned int ni = 0,
+                    const unsigned int nj = 0)
+    {
+        section_ = section;
+        ni_      = ni;
+        nj_      = nj;
+    }
+
+    void setCeilings(const double peakGflops, const double bandwidthGbps)
+    {
+        peak_      = peakGflops;
+        bandwidth_ = bandwidthGbps;
+    }
+
+    double getPeak(void) const
+    {
+        return peak_;
+    }
+
+    double getBandwidth(void) const
+    {
+        return bandwidth_;
+    }
+
+    // t in microseconds, flops and bytes are totals for the timed region
+    BenchmarkRecord & add(const std::string name, const double t,
+                          const double flops, const double bytes)
+    {
+        BenchmarkRecord r;
+
+        r.section = section_;
+        r.name    = name;
+        r.ni      = ni_;
+        r.nj      = nj_;
+        r.nThread = currentThreads();
+        r.time    = t/1.0e6;
+        r.gflops  = (t > 0.) ? flops/t/1.0e3 : 0.;
+        r.gbps    = (t > 0.) ? bytes/t*1.0e6/GIGA : 0.;
+        if ((flops > 0.) and (bytes > 0.))
+        {
+            r.intensity = flops/bytes;
+            if ((peak_ > 0.) and (bandwidth_ > 0.))
+            {
+                double attainable = std::min(peak_, r.intensity*bandwidth_*GIGA/1.0e9);
+
+                r.roofline = r.gflops/attainable;
+            }
+        }
+        record_.push_back(r);
+
+        return record_.back();
+    }
+
+    // latency benchmark, t in microseconds for nOp operations
+    BenchmarkRecord & addLatency(const std::string name, const double t,
+                                 const double nOp)
+    {
+        BenchmarkRecord &r = add(name, t, 0., 0.);
+
+        r.latency = t*1.0e3/nOp;
+
+        return r;
+    }
+
+    void writeCsv(const std::string filename) const
+    {
+        std::ofstream f(filename);
+
+        if (!f.good())
+        {
+            HADRONS_ERROR(Io, "cannot open '" + filename + "'");
+        }
+        f << "section,name,ni,nj,threads,time_s,gflops,gbps,intensity,roofline,"
+          << "latency_ns" << std::endl;
+        f << std::setprecision(10);
+        for (auto &r: record_)
+        {
+            f << "\"" << r.section << "\",\"" << r.name << "\"," << r.ni << ","
+              << r.nj << "," << r.nThread << "," << r.time << "," << r.gflops
+              << "," << r.gbps << "," << r.intensity << "," << r.roofline
+              << "," << r.latency << std::endl;
+        }
+    }
+
+    void writeJson(const std::string filename) const
+    {
+        std::ofstream f(filename);
+
+        if (!f.good())
+        {
+            HADRONS_ERROR(Io, "cannot open '" + filename + "'");
+        }
+        f << std::setprecision(10);
+        f << "{" << std::endl;
+        f << "  \"peak_gflops\": " << peak_ << "," << std::endl;
+        f << "  \"bandwidth_gbps\": " << bandwidth_ << "," << std::endl;
+        f << "  \"results\": [" << std::endl;
+        for (unsigned int i = 0; i < record_.size(); ++i)
+        {
+            auto &r = record_[i];
+
+            f << "    {\"section\": \"" << escape(r.section)
+              << "\", \"name\": \"" << escape(r.name) << "\", \"ni\": " << r.ni
+              << ", \"nj\": " << r.nj << ", \"threads\": " << r.nThread
+              << ", \"time_s\": " << r.time << ", \"gflops\": " << r.gflops
+              << ", \"gbps\": " << r.gbps << ", \"intensity\": " << r.intensity
+              << ", \"roofline\": " << r.roofline << ", \"latency_ns\": "
+              << r.latency << "}"
+              << ((i + 1 < record_.size()) ? "," : "") << std::endl;
+        }
+        f << "  ]" << std::endl;
+        f << "}" << std::endl;
+    }
+
+    // compare against a baseline CSV file, the figure of merit is the GFlop/s
+    // for compute kernels, the GB/s for I/O and the inverse latency for latency
+    // benchmarks, a result is a regression if it is below (1 - tolerance) times
+    // the baseline, returns the number of regressions
+    unsigned int compare(const std::string filename, const double tolerance) const
+    {
+        std::map<std::string, BenchmarkRecord> base = readCsv(filename);
+        unsigned int                           nRegression = 0, nMatch = 0;
+
+        std::cout << "==== comparison with baseline '" << filename
+                  << "' (tolerance " << 100.*tolerance << "%)" << std::endl;
+        std::cout << std::endl;
+        for (auto &r: record_)
+        {
+            auto it = base.find(key(r));
+
+            if (it == base.end())
+            {
+                continue;
+            }
+
+            double cur = merit(r), ref = merit(it->second);
+
+            nMatch++;
+            if (ref <= 0.)
+            {
+                continue;
+            }
+            if (cur < (1. - tolerance)*ref)
+            {
+                nRegression++;
+                std::cout << "REGRESSION ";
+            }
+            else if (cur > (1. + tolerance)*ref)
+            {
+                std::cout << "improved   ";
+            }
+            else
+            {
+                std::cout << "ok         ";
+            }
+            std::cout << std::setw(12) << r.section << " " << std::setw(44) << r.name
+                      << " " << r.ni << "x" << r.nj << " " << r.nThread << "t: "
+                      << std::setw(10) << cur << " vs. " << std::setw(10) << ref
+                      << " (" << std::showpos << std::fixed << std::setprecision(1)
+                      << 100.*(cur/ref - 1.) << std::noshowpos << std::defaultfloat
+                      << std::setprecision(6) << "%)" << std::endl;
+        }
+        std::cout << std::endl << nMatch << " result(s) matched in the baseline, "
+                  << nRegression << " regression(s)" << std::endl << std::endl;
+
+        return nRegression;
+    }
+private:
+    static unsigned int currentThreads(void)
+    {
+#ifdef GRID_OMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    static std::string escape(const std::string str)
+    {
+        std::string res;
+
+        for (auto c: str)
+        {
+            if ((c == '"') or (c == '\\'))
+            {
+                res.push_back('\\');
+            }
+            res.push_back(c);
+        }
+
+        return res;
+    }
+
+    static std::string key(const BenchmarkRecord &r)
+    {
+        return r.section + "|" + r.name + "|" + std::to_string(r.ni) + "|"
+               + std::to_string(r.nj) + "|" + std::to_string(r.nThread);
+    }
+
+    static double merit(const BenchmarkRecord &r)
+    {
+        if (r.latency > 0.)
+        {
+            return 1./r.latency;
+        }
+
+        return (r.gflops > 0.) ? r.gflops : r.gbps;
+    }
+
+    // split a CSV line, fields may be quoted
+    static std::vector<std::string> splitCsv(const std::string line)
+    {
+        std::vector<std::string> field(1);
+        bool                     quoted = false;
+
+        for (auto c: line)
+        {
+            if (c == '"')
+            {
+                quoted = !quoted;
+            }
+            else if ((c == ',') and !quoted)
+            {
+                field.emplace_back();
+            }
+            else
+            {
+                field.back().push_back(c);
+            }
+        }
+
+        return field;
+    }
+
+    static std::map<std::string, BenchmarkRecord> readCsv(const std::string filename)
+    {
+        std::map<std::string, BenchmarkRecord> base;
+        std::ifstream                          f(filename);
+        std::string                            line;
+
+        if (!f.good())
+        {
+            HADRONS_ERROR(Io, "cannot open baseline '" + filename + "'");
+        }
+        std::getline(f, line);
+        while (std::getline(f, line))
+        {
+            auto field = splitCsv(line);
+
+            if (field.size() < 10)
+            {
+                continue;
+            }
+
+            BenchmarkRecord r;
+
+            r.section   = field[0];
+            r.name      = field[1];
+            r.ni        = std::stoul(field[2]);
+            r.nj        = std::stoul(field[3]);
+            r.nThread   = std::stoul(field[4]);
+            r.time      = std::stod(field[5]);
+            r.gflops    = std::stod(field[6]);
+            r.gbps      = std::stod(field[7]);
+            r.intensity = std::stod(field[8]);
+            r.roofline  = std::stod(field[9]);
+            r.latency   = (field.size() > 10) ? std::stod(field[10]) : 0.;
+            base[key(r)] = r;
+        }
+
+        return base;
+    }
+private:
+    std::string                  section_;
+    unsigned int                 ni_{0}, nj_{0};
+    double                       peak_{0.}, bandwidth_{0.};
+    std::vector<BenchmarkRecord> record_;
+};
+
+BenchmarkLog & benchLog(void)
+{
+    static BenchmarkLog log;
+
+    return log;
+}
+
+void printRecord(const BenchmarkRecord &r)
+{
+    std::cout << " " << std::setw(10) << r.time << " sec ";
+    if (r.latency > 0.)
+    {
+        std::cout << std::setw(10) << r.latency << " ns/op" << std::endl;
+
+        return;
+    }
+    if (r.gflops > 0.)
+    {
+        std::cout << std::setw(10) << r.gflops << " GFlop/s ";
+    }
+    std::cout << std::setw(10) << r.gbps << " GB/s ";
+    if (r.roofline > 0.)
+    {
+        std::cout << std::setw(6) << std::fixed << std::setprecision(1)
+                  << 100.*r.roofline << "% roofline" << std::defaultfloat
+                  << std::setprecision(6);
+    }
+    std::cout << std::endl;
+}
+
 template <typename Function, typename MatLeft, typename MatRight>
 inline void trBenchmark(const std::string name, const MatLeft &left,
                         const MatRight &right, const ComplexD ref, Function fn)
@@ -76,11 +420,8 @@ inline void trBenchmark(const std::string name, const MatLeft &left,
     if (rank == 0)
     {
         std::cout << std::setw(34) << name << ": diff= "
-                  << std::setw(12) << abs(buf-ref)
-                  << std::setw(10) << t/1.0e6 << " sec "
-                  << std::setw(10) << flops/t/1.0e3 << " GFlop/s " 
-                  << std::setw(10) << bytes/t*1.0e6/1024/1024/1024 << " GB/s "
-                  << std::endl;
+                  << std::setw(12) << abs(buf-ref);
+        printRecord(benchLog().add(name, t, flops, bytes));
     }
     ::sleep(1);
 }
@@ -112,11 +453,8 @@ inline void mulBenchmark(const std::string name, const MatV &left,
     if (rank == 0)
     {
         std::cout << std::setw(34) << name << ": diff= "
-                  << std::setw(12) << (buf-ref).squaredNorm()
-                  << std::setw(10) << t/1.0e6 << " sec "
-                  << std::setw(10) << flops/t/1.0e3 << " GFlop/s " 
-                  << std::setw(10) << bytes/t*1.0e6/1024/1024/1024 << " GB/s "
-                  << std::endl;
+                  << std::setw(12) << (buf-ref).squaredNorm();
+        printRecord(benchLog().add(name, t, flops, bytes));
     }
     ::sleep(1);
 }
@@ -183,6 +521,12 @@ static inline void zdotuCol(ComplexD &res, const unsigned int aCol,
 }
 #endif
 
+template <typename Mat>
+std::string orderingName(void)
+{
+    return (Mat::Options == RowMajor) ? "row" : "col";
+}
+
 template <typename MatLeft, typename MatRight>
 void fullTrBenchmark(const unsigned int ni, const unsigned int nj, const unsigned int nMat)
 {
@@ -195,6 +539,8 @@ void fullTrBenchmark(const unsigned int ni, const unsigned int nj, const unsigne
     left.resize(nMat, MatLeft::Random(ni, nj));
     right.resize(nMat, MatRight::Random(nj, ni));
     GET_RANK(rank, nMpi);
+    benchLog().setContext("tr " + orderingName<MatLeft>() + "*"
+                          + orderingName<MatRight>(), ni, nj);
     if (rank == 0)
     {
         std::cout << "==== tr(A*B) benchmarks" << std::endl;
@@ -220,12 +566,21 @@ void fullTrBenchmark(const unsigned int ni, const unsigned int nj, const unsigne
     }
     BARRIER();
     ref = (left.back()*right.back()).trace();
-    trBenchmark("Hadrons A2AContraction::accTrMul", left, right, ref,
-    [](ComplexD &res, const MatLeft &a, const MatRight &b)
-    { 
-        res = 0.;
-        A2AContraction::accTrMul(res, a, b);
-    });
+    for (auto backend: availableBackends())
+    {
+        auto defaultBackend = A2AContraction::getBackend();
+
+        A2AContraction::setBackend(backend);
+        trBenchmark("Hadrons A2AContraction::accTrMul [" 
+                    + A2AContraction::getBackendName(backend) + "]", 
+                    left, right, ref,
+        [](ComplexD &res, const MatLeft &a, const MatRight &b)
+        { 
+            res = 0.;
+            A2AContraction::accTrMul(res, a, b);
+        });
+        A2AContraction::setBackend(defaultBackend);
+    }
     trBenchmark("Naive loop rows first", left, right, ref,
     [](ComplexD &res, const MatLeft &a, const MatRight &b)
     { 
@@ -345,6 +700,76 @@ void fullTrBenchmark(const unsigned int ni, const unsigned int nj, const unsigne
     }
 }
 
+template <typename MatLeft, typename MatRight>
+void trScalingBenchmark(const unsigned int ni, const unsigned int nj, const unsigned int nMat)
+{
+    std::vector<MatLeft>  left;
+    std::vector<MatRight> right;
+    ComplexD              ref;
+    std::vector<int>      nThreadList;
+    int                   rank, nMpi, maxThread = 1;
+
+#ifdef GRID_OMP
+    maxThread = omp_get_max_threads();
+#endif
+    for (int nThread = 1; nThread < maxThread; nThread *= 2)
+    {
+        nThreadList.push_back(nThread);
+    }
+    nThreadList.push_back(maxThread);
+    left.resize(nMat, MatLeft::Random(ni, nj));
+    right.resize(nMat, MatRight::Random(nj, ni));
+    GET_RANK(rank, nMpi);
+    benchLog().setContext("tr scaling " + orderingName<MatLeft>() + "*"
+                          + orderingName<MatRight>(), ni, nj);
+    if (rank == 0)
+    {
+        std::cout << "==== tr(A*B) thread scaling (up to " << maxThread 
+                  << " threads)" << std::endl;
+        std::cout << std::endl;
+    }
+    BARRIER();
+    ref = (left.back()*right.back()).trace();
+    for (auto nThread: nThreadList)
+    {
+        std::string suffix = " (" + std::to_string(nThread) + " thread"
+                             + ((nThread > 1) ? "s)" : ")");
+
+#ifdef GRID_OMP
+        omp_set_num_threads(nThread);
+#endif
+        trBenchmark("A2AContraction::accTrMul" + suffix, left, right, ref,
+        [](ComplexD &res, const MatLeft &a, const MatRight &b)
+        { 
+            res = 0.;
+            A2AContraction::accTrMul(res, a, b);
+        });
+        trBenchmark("critical section rows" + suffix, left, right, ref,
+        [](ComplexD &res, const MatLeft &a, const MatRight &b)
+        {
+            res = 0.;
+            thread_for(r,a.rows(),
+            {
+                ComplexD tmp;
+
+                tmp = a.row(r).conjugate().dot(b.col(r));
+                thread_critical
+                {
+                    res += tmp;
+                }
+            });
+        });
+    }
+#ifdef GRID_OMP
+    omp_set_num_threads(maxThread);
+#endif
+    BARRIER();
+    if (rank == 0)
+    {
+        std::cout << std::endl;
+    }
+}
+
 template <typename Mat>
 void fullMulBenchmark(const unsigned int ni, const unsigned int nj, const unsigned int nMat)
 {
@@ -355,6 +780,7 @@ void fullMulBenchmark(const unsigned int ni, const unsigned int nj, const unsign
     left.resize(nMat, Mat::Random(ni, nj));
     right.resize(nMat, Mat::Random(nj, ni));
     GET_RANK(rank, nMpi);
+    benchLog().setContext("mul " + orderingName<Mat>(), ni, nj);
     if (rank == 0)
     {
         std::cout << "==== A*B benchmarks" << std::endl;
@@ -371,11 +797,20 @@ void fullMulBenchmark(const unsigned int ni, const unsigned int nj, const unsign
     }
     BARRIER();
     ref = left.back()*right.back();
-    mulBenchmark("Hadrons A2AContraction::mul", left, right, ref,
-    [](Mat &res, const Mat &a, const Mat &b)
-    { 
-        A2AContraction::mul(res, a, b);
-    });
+    for (auto backend: availableBackends())
+    {
+        auto defaultBackend = A2AContraction::getBackend();
+
+        A2AContraction::setBackend(backend);
+        mulBenchmark("Hadrons A2AContraction::mul [" 
+                     + A2AContraction::getBackendName(backend) + "]", 
+                     left, right, ref,
+        [](Mat &res, const Mat &a, const Mat &b)
+        { 
+            A2AContraction::mul(res, a, b);
+        });
+        A2AContraction::setBackend(defaultBackend);
+    }
     mulBenchmark("Eigen A*B", left, right, ref,
     [](Mat &res, const Mat &a, const Mat &b)
     { 
@@ -407,22 +842,580 @@ void fullMulBenchmark(const unsigned int ni, const unsigned int nj, const unsign
     }
 }
 
+template <typename Mat>
+void mulScalingBenchmark(const unsigned int ni, const unsigned int nj, const unsigned int nMat)
+{
+    std::vector<Mat> left, right;
+    Mat              ref;
+    std::vector<int> nThreadList;
+    int              rank, nMpi, maxThread = 1;
+
+#ifdef GRID_OMP
+    maxThread = omp_get_max_threads();
+#endif
+    for (int nThread = 1; nThread < maxThread; nThread *= 2)
+    {
+        nThreadList.push_back(nThread);
+    }
+    nThreadList.push_back(maxThread);
+    left.resize(nMat, Mat::Random(ni, nj));
+    right.resize(nMat, Mat::Random(nj, ni));
+    GET_RANK(rank, nMpi);
+    benchLog().setContext("mul scaling " + orderingName<Mat>(), ni, nj);
+    if (rank == 0)
+    {
+        std::cout << "==== A*B thread scaling (up to " << maxThread 
+                  << " threads)" << std::endl;
+        std::cout << std::endl;
+    }
+    BARRIER();
+    ref = left.back()*right.back();
+    for (auto nThread: nThreadList)
+    {
+        std::string suffix = " (" + std::to_string(nThread) + " thread"
+                             + ((nThread > 1) ? "s)" : ")");
+
+#ifdef GRID_OMP
+        omp_set_num_threads(nThread);
+#endif
+        mulBenchmark("A2AContraction::mul" + suffix, left, right, ref,
+        [](Mat &res, const Mat &a, const Mat &b)
+        { 
+            A2AContraction::mul(res, a, b);
+        });
+    }
+#ifdef GRID_OMP
+    omp_set_num_threads(maxThread);
+#endif
+    BARRIER();
+    if (rank == 0)
+    {
+        std::cout << std::endl;
+    }
+}
+
+// A2AContraction kernels for matrices of 1/4, 1/2 and 1 times the input size
+template <typename MatLeft, typename MatRight>
+void sizeSweepBenchmark(const unsigned int ni, const unsigned int nj, const unsigned int nMat)
+{
+    int rank, nMpi;
+
+    GET_RANK(rank, nMpi);
+    if (rank == 0)
+    {
+        std::cout << "==== size sweep" << std::endl;
+        std::cout << std::endl;
+    }
+    for (unsigned int div: {4, 2, 1})
+    {
+        unsigned int          si = std::max(1u, ni/div), sj = std::max(1u, nj/div);
+        std::vector<MatLeft>  left(nMat, MatLeft::Random(si, sj)), 
+                              leftT(nMat, MatLeft::Random(sj, si));
+        std::vector<MatRight> right(nMat, MatRight::Random(sj, si));
+        ComplexD              trRef  = (left.back()*right.back()).trace();
+        MatLeft               mulRef = left.back()*leftT.back();
+
+        benchLog().setContext("size sweep", si, sj);
+        if (rank == 0)
+        {
+            std::cout << "-- " << si << "x" << sj << std::endl;
+        }
+        BARRIER();
+        trBenchmark("A2AContraction::accTrMul", left, right, trRef,
+        [](ComplexD &res, const MatLeft &a, const MatRight &b)
+        { 
+            res = 0.;
+            A2AContraction::accTrMul(res, a, b);
+        });
+        mulBenchmark("A2AContraction::mul", left, leftT, mulRef,
+        [](MatLeft &res, const MatLeft &a, const MatLeft &b)
+        { 
+            A2AContraction::mul(res, a, b);
+        });
+    }
+    BARRIER();
+    if (rank == 0)
+    {
+        std::cout << std::endl;
+    }
+}
+
+// machine ceilings for the roofline model: the memory bandwidth is measured
+// with a STREAM-like triad, and the peak with a large A2AContraction::mul
+// (at least 1024x1024), kernels working in cache can exceed the roofline
+void ceilingBenchmark(const unsigned int n)
+{
+    const size_t        triadSize = 1 << 24;
+    const unsigned int  nRep = 5;
+    std::vector<double> a(triadSize, 0.), b(triadSize, 1.), c(triadSize, 2.);
+    A2AMatrix<ComplexD> ma = A2AMatrix<ComplexD>::Random(n, n),
+                        mb = A2AMatrix<ComplexD>::Random(n, n), mc(n, n);
+    double              s = 3., t, tTriad = 0., tMul = 0., bytes, flops;
+
+    std::cout << "==== machine ceilings" << std::endl;
+    std::cout << std::endl;
+    benchLog().setContext("ceiling", n, n);
+    for (unsigned int rep = 0; rep < nRep; ++rep)
+    {
+        t = -usecond();
+        thread_for(i, triadSize,
+        {
+            a[i] = b[i] + s*c[i];
+        });
+        t += usecond();
+        tTriad = (rep == 0) ? t : std::min(tTriad, t);
+    }
+    bytes = 3.*triadSize*sizeof(double);
+    std::cout << std::setw(34) << "triad bandwidth" << ": ";
+    auto triad = benchLog().add("triad bandwidth", tTriad, 0., bytes);
+    printRecord(triad);
+    for (unsigned int rep = 0; rep < nRep; ++rep)
+    {
+        t = -usecond();
+        A2AContraction::mul(mc, ma, mb);
+        t += usecond();
+        tMul = (rep == 0) ? t : std::min(tMul, t);
+    }
+    flops = A2AContraction::mulFlops(ma, mb);
+    std::cout << std::setw(34) << "A2AContraction::mul peak" << ": ";
+    auto peak = benchLog().add("A2AContraction::mul peak", tMul, flops, 0.);
+    printRecord(peak);
+    benchLog().setCeilings(peak.gflops, triad.gbps);
+    std::cout << std::endl;
+}
+
+#ifdef HAVE_HDF5
+class BenchmarkMetadata: Serializable
+{
+public:
+    GRID_SERIALIZABLE_CLASS_MEMBERS(BenchmarkMetadata,
+                                    unsigned int, chunkSize);
+};
+#endif
+
+// A2AMatrixIo write and read for different HDF5 chunk sizes, the reads are
+// done both for the full dataset and timeslice by timeslice in random order,
+// which is the access pattern of the hdf5 disk vector backend
+void ioBenchmark(const unsigned int ni, const unsigned int nj, 
+                 const unsigned int nt, const std::string dir)
+{
+    std::cout << "==== A2AMatrixIo benchmarks" << std::endl;
+    std::cout << std::endl;
+#ifdef HAVE_HDF5
+    typedef Eigen::Matrix<ComplexD, -1, 1> Buffer;
+
+    Buffer                    buf = Buffer::Random(static_cast<Eigen::Index>(nt)*ni*nj);
+    unsigned int              nMin = std::min(ni, nj);
+    std::vector<unsigned int> chunkSize;
+    std::vector<unsigned int> tOrder(nt);
+    double                    t, bytes = buf.size()*sizeof(ComplexD);
+    std::mt19937              gen(42);
+
+    for (unsigned int div: {8, 4, 2, 1})
+    {
+        unsigned int c = std::max(1u, nMin/div);
+
+        if (chunkSize.empty() or (chunkSize.back() != c))
+        {
+            chunkSize.push_back(c);
+        }
+    }
+    std::iota(tOrder.begin(), tOrder.end(), 0);
+    std::shuffle(tOrder.begin(), tOrder.end(), gen);
+    for (auto c: chunkSize)
+    {
+        std::string              filename = dir + "/io_" + std::to_string(c) + ".h5";
+        std::string              suffix   = " (chunk " + std::to_string(c) + ")";
+        A2AMatrixIo<ComplexD>    io(filename, "benchmark", nt, ni, nj);
+        BenchmarkMetadata        md;
+        A2AMatrix<ComplexD>      m;
+        double                   diff = 0.;
+
+        benchLog().setContext("io", ni, nj);
+        md.chunkSize = c;
+        t  = -usecond();
+        io.initFile(md, c);
+        io.saveBlock(buf.data(), 0, 0, ni, nj);
+        t += usecond();
+        std::cout << std::setw(34) << "write" + suffix << ": ";
+        printRecord(benchLog().add("write" + suffix, t, 0., bytes));
+        {
+            EigenDiskVector<ComplexD>       v(dir + "/io_dv", nt, nt);
+            const EigenDiskVector<ComplexD> &cv = v;
+
+            t  = -usecond();
+            io.load(v);
+            t += usecond();
+            diff = (cv[nt - 1] - Eigen::Map<A2AMatrix<ComplexD>>(
+                        buf.data() + static_cast<size_t>(nt - 1)*ni*nj, ni, nj)).norm();
+        }
+        std::cout << std::setw(34) << "read" + suffix << ": ";
+        printRecord(benchLog().add("read" + suffix, t, 0., bytes));
+        t = -usecond();
+        for (auto tr: tOrder)
+        {
+            io.loadTimeslice(m, tr);
+        }
+        t += usecond();
+        std::cout << std::setw(34) << "timeslice read" + suffix << ": ";
+        printRecord(benchLog().add("timeslice read" + suffix, t, 0., bytes));
+        if (diff > 0.)
+        {
+            std::cout << "warning: read-back difference " << diff << std::endl;
+        }
+        std::remove(filename.c_str());
+    }
+#else
+    std::cout << "Hadrons compiled without HDF5, skipped" << std::endl;
+#endif
+    std::cout << std::endl;
+}
+
+// EigenDiskVector with a cache of a quarter of the elements: assignment (the
+// evicted elements are written to disk), then two passes of sequential and
+// random reads, and sequential reads with the background loader
+void diskVectorBenchmark(const unsigned int ni, const unsigned int nj,
+                         const unsigned int nt, const std::string dir)
+{
+    const unsigned int              cacheSize = std::max(1u, nt/4), nPass = 2;
+    EigenDiskVector<ComplexD>       dv(dir + "/dv", nt, cacheSize);
+    const EigenDiskVector<ComplexD> &cdv = dv;
+    A2AMatrix<ComplexD>             m = A2AMatrix<ComplexD>::Random(ni, nj);
+    std::mt19937                    gen(42);
+    std::uniform_int_distribution<> dis(0, nt - 1);
+    double                          t, matBytes = m.size()*sizeof(ComplexD);
+    ComplexD                        sum = 0.;
+
+    std::cout << "==== disk vector benchmarks (" << nt << " elements, cache "
+              << cacheSize << ")" << std::endl;
+    std::cout << std::endl;
+    benchLog().setContext("disk vector", ni, nj);
+    t = -usecond();
+    for (unsigned int i = 0; i < nt; ++i)
+    {
+        dv[i] = m;
+    }
+    t += usecond();
+    std::cout << std::setw(34) << "assignment" << ": ";
+    printRecord(benchLog().add("assignment", t, 0., nt*matBytes));
+    // the flush also saves the cached elements, it is timed separately
+    {
+        EigenDiskVector<ComplexD> wdv(dir + "/dv_wb", nt, cacheSize);
+
+        wdv.enableWriteBehind(2);
+        t = -usecond();
+        for (unsigned int i = 0; i < nt; ++i)
+        {
+            wdv[i] = m;
+        }
+        t += usecond();
+        std::cout << std::setw(34) << "assignment (write-behind)" << ": ";
+        printRecord(benchLog().add("assignment (write-behind)", t, 0., nt*matBytes));
+        t = -usecond();
+        wdv.flush();
+        t += usecond();
+        std::cout << std::setw(34) << "flush (write-behind)" << ": ";
+        printRecord(benchLog().add("flush (write-behind)", t, 0., 0.));
+    }
+    dv.resetStat();
+    t = -usecond();
+    for (unsigned int p = 0; p < nPass; ++p)
+    for (unsigned int i = 0; i < nt; ++i)
+    {
+        sum += cdv[i](0, 0);
+    }
+    t += usecond();
+    std::cout << std::setw(34) << "sequential read" << ": hit= "
+              << std::setw(6) << dv.hitRatio();
+    printRecord(benchLog().add("sequential read", t, 0., nPass*nt*matBytes));
+    dv.resetStat();
+    t = -usecond();
+    for (unsigned int i = 0; i < nPass*nt; ++i)
+    {
+        sum += cdv[dis(gen)](0, 0);
+    }
+    t += usecond();
+    std::cout << std::setw(34) << "random read" << ": hit= "
+              << std::setw(6) << dv.hitRatio();
+    printRecord(benchLog().add("random read", t, 0., nPass*nt*matBytes));
+    if (cacheSize >= 3)
+    {
+        dv.enablePrefetch(std::min(2u, cacheSize - 2));
+        dv.resetStat();
+        t = -usecond();
+        for (unsigned int p = 0; p < nPass; ++p)
+        for (unsigned int i = 0; i < nt; ++i)
+        {
+            sum += cdv[i](0, 0);
+        }
+        t += usecond();
+        dv.disablePrefetch();
+        std::cout << std::setw(34) << "sequential read (prefetch)" << ": hit= "
+                  << std::setw(6) << dv.hitRatio();
+        printRecord(benchLog().add("sequential read (prefetch)", t, 0., 
+                                   nPass*nt*matBytes));
+    }
+
+    // memory-mapped store, the reads sum whole elements since a map only
+    // faults in the pages it touches, the first pass verifies the checksums
+    MappedEigenDiskVector<ComplexD>       mdv(dir + "/mdv", nt);
+    const MappedEigenDiskVector<ComplexD> &cmdv = mdv;
+
+    t = -usecond();
+    for (unsigned int i = 0; i < nt; ++i)
+    {
+        mdv[i] = m;
+    }
+    t += usecond();
+    std::cout << std::setw(34) << "mapped assignment" << ": ";
+    printRecord(benchLog().add("mapped assignment", t, 0., nt*matBytes));
+    t = -usecond();
+    for (unsigned int p = 0; p < nPass; ++p)
+    for (unsigned int i = 0; i < nt; ++i)
+    {
+        sum += cmdv[i].sum();
+    }
+    t += usecond();
+    std::cout << std::setw(34) << "mapped sequential read" << ": ";
+    printRecord(benchLog().add("mapped sequential read", t, 0., nPass*nt*matBytes));
+    t = -usecond();
+    for (unsigned int i = 0; i < nPass*nt; ++i)
+    {
+        sum += cmdv[dis(gen)].sum();
+    }
+    t += usecond();
+    std::cout << std::setw(34) << "mapped random read" << ": ";
+    printRecord(benchLog().add("mapped random read", t, 0., nPass*nt*matBytes));
+    if (sum != sum)
+    {
+        std::cout << "warning: NaN in disk vector data" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// EigenDiskVector hit-path latency as a function of the cache size, the
+// elements are 1x1 matrices and all the accesses are hits in random order, so
+// that the cache bookkeeping dominates
+void diskVectorHitBenchmark(const std::string dir)
+{
+    const unsigned int        nAccess = 1u << 22;
+    std::vector<unsigned int> order(nAccess);
+    std::mt19937              gen(42);
+    double                    t;
+    ComplexD                  sum = 0.;
+
+    std::cout << "==== EigenDiskVector hit latency" << std::endl;
+    std::cout << std::endl;
+    benchLog().setContext("disk vector hit", 1, 1);
+    for (unsigned int cacheSize: {1, 4, 16, 64, 256, 1024, 4096})
+    {
+        EigenDiskVector<ComplexD>       dv(dir + "/dv_hit", cacheSize, cacheSize);
+        const EigenDiskVector<ComplexD> &cdv = dv;
+        std::uniform_int_distribution<> dis(0, cacheSize - 1);
+        std::string                     name = "hit (cache " 
+                                               + std::to_string(cacheSize) + ")";
+
+        for (unsigned int i = 0; i < cacheSize; ++i)
+        {
+            dv[i] = A2AMatrix<ComplexD>::Constant(1, 1, 1.);
+        }
+        for (auto &i: order)
+        {
+            i = dis(gen);
+        }
+        dv.resetStat();
+        t = -usecond();
+        for (auto i: order)
+        {
+            sum += cdv[i](0, 0);
+        }
+        t += usecond();
+        std::cout << std::setw(34) << name << ": hit= " << std::setw(6) 
+                  << dv.hitRatio();
+        printRecord(benchLog().addLatency(name, t, nAccess));
+    }
+    if (sum != sum)
+    {
+        std::cout << "warning: NaN in disk vector data" << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+// Contractor-like product: corr(dt) = 1/nt sum_t tr(M_0(t + dt)M_1(t)...M_n(t))
+// for all dt, the terms alternate between Ni x Nj and Nj x Ni matrices and the
+// last one is transposed in advance, as done by the Contractor
+void productBenchmark(const unsigned int ni, const unsigned int nj, 
+                      const unsigned int nt, const unsigned int nTerm)
+{
+    typedef A2AMatrix<ComplexD>   Mat;
+    typedef A2AMatrixTr<ComplexD> MatTr;
+
+    std::vector<std::vector<Mat>> term(nTerm - 1);
+    std::vector<MatTr>            last(nt);
+    std::vector<ComplexD>         corr(nt);
+    Mat                           prod, tmp;
+    double                        t, flops = 0., bytes = 0.;
+    auto                          nr = [ni, nj](const unsigned int k)
+    {
+        return (k % 2 == 0) ? ni : nj;
+    };
+
+    std::cout << "==== Contractor-like " << nTerm << "-term product over "
+              << nt << " timeslices" << std::endl;
+    std::cout << std::endl;
+    benchLog().setContext("product", ni, nj);
+    for (unsigned int k = 0; k < nTerm - 1; ++k)
+    {
+        term[k].resize(nt, Mat::Random(nr(k), nr(k + 1)));
+    }
+    last.assign(nt, MatTr::Random(nr(nTerm - 1), nr(nTerm)));
+    // flops and bytes of a single trace evaluation
+    for (unsigned int k = 1; k < nTerm - 1; ++k)
+    {
+        double m = nr(0), l = nr(k), n = nr(k + 1);
+
+        flops += m*n*(6.*l + 2.*(l - 1.));
+        bytes += (m*l + l*n + m*n)*sizeof(ComplexD);
+    }
+    flops += 8.*nr(0)*nr(nTerm - 1);
+    bytes += 2.*nr(0)*nr(nTerm - 1)*sizeof(ComplexD);
+    flops *= nt*nt;
+    bytes *= nt*nt;
+    for (auto backend: availableBackends())
+    {
+        auto        defaultBackend = A2AContraction::getBackend();
+        std::string name = "product [" + A2AContraction::getBackendName(backend) + "]";
+
+        A2AContraction::setBackend(backend);
+        t = -usecond();
+        for (unsigned int dt = 0; dt < nt; ++dt)
+        {
+            corr[dt] = 0.;
+            for (unsigned int tt = 0; tt < nt; ++tt)
+            {
+                const Mat *left = &term[0][(tt + dt) % nt];
+
+                for (unsigned int k = 1; k < nTerm - 1; ++k)
+                {
+                    A2AContraction::mul(tmp, *left, term[k][tt]);
+                    std::swap(prod, tmp);
+                    left = &prod;
+                }
+                A2AContraction::accTrMul(corr[dt], *left, last[tt]);
+            }
+            corr[dt] /= nt;
+        }
+        t += usecond();
+        A2AContraction::setBackend(defaultBackend);
+        std::cout << std::setw(34) << name << ": ";
+        printRecord(benchLog().add(name, t, flops, bytes));
+    }
+    std::cout << std::endl;
+}
+
+std::vector<std::string> splitList(const std::string str)
+{
+    std::vector<std::string> list;
+    std::istringstream       stream(str);
+    std::string              item;
+
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            list.push_back(item);
+        }
+    }
+
+    return list;
+}
+
 int main(int argc, char *argv[])
 {
     // parse command line
-    Eigen::Index ni, nj, nMat;
-    int          nMpi, rank;
+    Eigen::Index             ni, nj, nMat;
+    unsigned int             nt = 8, nTerm = 4;
+    double                   tolerance = 0.1;
+    std::string              dir = "ContractorBenchmark.tmp", jsonFile, csvFile,
+                             baselineFile, arg;
+    std::vector<std::string> section = {"ceiling", "tr", "scaling", "mul", "sweep",
+                                        "io", "dv", "dvhit", "product"};
+    int                      nMpi, rank, status = EXIT_SUCCESS;
 
-    if (argc != 4)
+    if (argc < 4)
     {
-        std::cerr << "usage: " << argv[0] << " <Ni> <Nj> <#matrices>";
+        std::cerr << "usage: " << argv[0] << " <Ni> <Nj> <#matrices> [options]";
         std::cerr << std::endl;
+        std::cerr << "  --sections <list>  comma-separated list of sections among" << std::endl;
+        std::cerr << "                     ";
+        for (auto &s: section)
+        {
+            std::cerr << " " << s;
+        }
+        std::cerr << " (default: all)" << std::endl;
+        std::cerr << "  --nt <n>           number of timeslices for I/O and product (default: " 
+                  << nt << ")" << std::endl;
+        std::cerr << "  --terms <n>        number of terms of the product, even (default: " 
+                  << nTerm << ")" << std::endl;
+        std::cerr << "  --dir <dir>        scratch directory for I/O (default: " 
+                  << dir << ")" << std::endl;
+        std::cerr << "  --json <file>      write results in JSON format" << std::endl;
+        std::cerr << "  --csv <file>       write results in CSV format" << std::endl;
+        std::cerr << "  --baseline <file>  compare with a previous CSV output" << std::endl;
+        std::cerr << "  --tolerance <x>    relative slowdown flagged as regression (default: " 
+                  << tolerance << ")" << std::endl;
         
         return EXIT_FAILURE;
     }
     ni   = std::stoi(argv[1]);
     nj   = std::stoi(argv[2]);
     nMat = std::stoi(argv[3]);
+    if (GridCmdOptionExists(argv, argv + argc, "--sections"))
+    {
+        section = splitList(GridCmdOptionPayload(argv, argv + argc, "--sections"));
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--nt"))
+    {
+        arg = GridCmdOptionPayload(argv, argv + argc, "--nt");
+        nt  = std::stoi(arg);
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--terms"))
+    {
+        arg   = GridCmdOptionPayload(argv, argv + argc, "--terms");
+        nTerm = std::stoi(arg);
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--dir"))
+    {
+        dir = GridCmdOptionPayload(argv, argv + argc, "--dir");
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--json"))
+    {
+        jsonFile = GridCmdOptionPayload(argv, argv + argc, "--json");
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--csv"))
+    {
+        csvFile = GridCmdOptionPayload(argv, argv + argc, "--csv");
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--baseline"))
+    {
+        baselineFile = GridCmdOptionPayload(argv, argv + argc, "--baseline");
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--tolerance"))
+    {
+        arg       = GridCmdOptionPayload(argv, argv + argc, "--tolerance");
+        tolerance = std::stod(arg);
+    }
+    if ((nTerm < 2) or (nTerm % 2 != 0))
+    {
+        std::cerr << "error: the number of terms must be even and at least 2" << std::endl;
+
+        return EXIT_FAILURE;
+    }
+
+    auto run = [&section](const std::string name)
+    {
+        return (std::find(section.begin(), section.end(), name) != section.end());
+    };
 
     INIT();
     GET_RANK(rank, nMpi);
@@ -433,7 +1426,7 @@ int main(int argc, char *argv[])
 
         std::cout << nMpi << " MPI processes" << std::endl;
 #ifdef GRID_OMP
-	std::cout << omp_get_num_threads() << " threads\n" << std::endl; 
+	std::cout << omp_get_max_threads() << " threads\n" << std::endl; 
 #else
         std::cout << "Single-threaded\n" << std::endl; 
 #endif
@@ -445,16 +1438,89 @@ int main(int argc, char *argv[])
 #ifdef USE_MKL
         std::cout << "MKL   uses " << mkl_get_max_threads() << " threads" << std::endl;
 #endif
+        std::cout << "A2AContraction backends:";
+        for (auto backend: availableBackends())
+        {
+            std::cout << " " << A2AContraction::getBackendName(backend);
+        }
+        std::cout << " (default " 
+                  << A2AContraction::getBackendName(A2AContraction::getBackend())
+                  << ")" << std::endl;
         std::cout << std::endl;
     }
 
-    fullTrBenchmark<A2AMatrix<ComplexD>, A2AMatrix<ComplexD>>(ni, nj, nMat);
-    fullTrBenchmark<A2AMatrix<ComplexD>, A2AMatrixTr<ComplexD>>(ni, nj, nMat);
-    fullTrBenchmark<A2AMatrixTr<ComplexD>, A2AMatrix<ComplexD>>(ni, nj, nMat);
-    fullTrBenchmark<A2AMatrixTr<ComplexD>, A2AMatrixTr<ComplexD>>(ni, nj, nMat);
-    fullMulBenchmark<A2AMatrix<ComplexD>>(ni, nj, nMat);
-    fullMulBenchmark<A2AMatrixTr<ComplexD>>(ni, nj, nMat);
+    // machine ceilings and the single-node I/O benchmarks run on rank 0 only
+    if (run("ceiling") and (rank == 0))
+    {
+        ceilingBenchmark(std::max<Eigen::Index>(1024, std::max(ni, nj)));
+    }
+    BARRIER();
+    if (run("tr"))
+    {
+        fullTrBenchmark<A2AMatrix<ComplexD>, A2AMatrix<ComplexD>>(ni, nj, nMat);
+        fullTrBenchmark<A2AMatrix<ComplexD>, A2AMatrixTr<ComplexD>>(ni, nj, nMat);
+        fullTrBenchmark<A2AMatrixTr<ComplexD>, A2AMatrix<ComplexD>>(ni, nj, nMat);
+        fullTrBenchmark<A2AMatrixTr<ComplexD>, A2AMatrixTr<ComplexD>>(ni, nj, nMat);
+    }
+    if (run("scaling"))
+    {
+        trScalingBenchmark<A2AMatrix<ComplexD>, A2AMatrixTr<ComplexD>>(ni, nj, nMat);
+        trScalingBenchmark<A2AMatrixTr<ComplexD>, A2AMatrix<ComplexD>>(ni, nj, nMat);
+        mulScalingBenchmark<A2AMatrix<ComplexD>>(ni, nj, nMat);
+    }
+    if (run("mul"))
+    {
+        fullMulBenchmark<A2AMatrix<ComplexD>>(ni, nj, nMat);
+        fullMulBenchmark<A2AMatrixTr<ComplexD>>(ni, nj, nMat);
+    }
+    if (run("sweep"))
+    {
+        sizeSweepBenchmark<A2AMatrix<ComplexD>, A2AMatrixTr<ComplexD>>(ni, nj, nMat);
+    }
+    if (rank == 0)
+    {
+        if (run("io") or run("dv") or run("dvhit"))
+        {
+            Hadrons::mkdir(dir);
+        }
+        if (run("io"))
+        {
+            ioBenchmark(ni, nj, nt, dir);
+        }
+        if (run("dv"))
+        {
+            diskVectorBenchmark(ni, nj, nt, dir);
+        }
+        if (run("dvhit"))
+        {
+            diskVectorHitBenchmark(dir);
+        }
+        if (run("io") or run("dv") or run("dvhit"))
+        {
+            ::rmdir(dir.c_str());
+        }
+        if (run("product"))
+        {
+            productBenchmark(ni, nj, nt, nTerm);
+        }
+        if (!csvFile.empty())
+        {
+            benchLog().writeCsv(csvFile);
+            std::cout << "results written in '" << csvFile << "'" << std::endl;
+        }
+        if (!jsonFile.empty())
+        {
+            benchLog().writeJson(jsonFile);
+            std::cout << "results written in '" << jsonFile << "'" << std::endl;
+        }
+        std::cout << std::endl;
+        if (!baselineFile.empty() and (benchLog().compare(baselineFile, tolerance) > 0))
+        {
+            status = EXIT_FAILURE;
+        }
+    }
+    BARRIER();
     FINALIZE();
 
-    return EXIT_SUCCESS;
+    return status;
 }
@@ -0,0 +1,191 @@
+/*
+ * MesonFieldBenchmark.cpp, part of Hadrons (https://github.com/aportelli/Hadrons)
+ *
+ * Copyright (C) 2015 - 2020
+ *
+ * Author: Antonin Portelli <antonin.portelli@me.com>
+ *
+ * Hadrons is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Hadrons is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Hadrons.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * See the full license in the file "LICENSE" in the top level distribution
+ * directory.
+ */
+
+/*  END LEGAL */
+#include <Hadrons/Global.hpp>
+#include <Hadrons/A2AMatrix.hpp>
+#include <Hadrons/MomentumPhase.hpp>
+#include <Hadrons/Modules/MContraction/A2AMesonField.hpp>
+
+using namespace Grid;
+using namespace Hadrons;
+
+typedef FIMPL::FermionField                               FermionField;
+typedef MContraction::MesonFieldKernel<Complex, FIMPL>    PhaseKernel;
+typedef MContraction::MesonFieldFftKernel<Complex, FIMPL> FftKernel;
+
+// integer spatial momenta sorted by increasing |p|^2
+std::vector<std::vector<Real>> makeMomenta(const unsigned int nMom,
+                                           const unsigned int nd)
+{
+    std::vector<std::vector<Real>> mom;
+    int                            pMax = 0;
+
+    while (mom.size() < nMom)
+    {
+        std::vector<int> p(nd, -pMax);
+
+        mom.clear();
+        // all momenta with components in [-pMax, pMax]
+        while (p.back() <= pMax)
+        {
+            mom.push_back(std::vector<Real>(p.begin(), p.end()));
+            for (unsigned int mu = 0; mu < nd; ++mu)
+            {
+                if ((++p[mu] <= pMax) or (mu == nd - 1))
+                {
+                    break;
+                }
+                p[mu] = -pMax;
+            }
+        }
+        pMax++;
+    }
+    std::stable_sort(mom.begin(), mom.end(),
+    [](const std::vector<Real> &a, const std::vector<Real> &b)
+    {
+        Real a2 = 0., b2 = 0.;
+
+        for (auto pmu: a)
+        {
+            a2 += pmu*pmu;
+        }
+        for (auto pmu: b)
+        {
+            b2 += pmu*pmu;
+        }
+
+        return (a2 < b2);
+    });
+    mom.resize(nMom);
+
+    return mom;
+}
+
+int main(int argc, char *argv[])
+{
+    Grid_init(&argc, &argv);
+
+    unsigned int nVec = 8, maxMom = 64, nRep = 3;
+    std::string  arg;
+
+    if (GridCmdOptionExists(argv, argv + argc, "--nvec"))
+    {
+        arg  = GridCmdOptionPayload(argv, argv + argc, "--nvec");
+        nVec = std::stoi(arg);
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--maxmom"))
+    {
+        arg    = GridCmdOptionPayload(argv, argv + argc, "--maxmom");
+        maxMom = std::stoi(arg);
+    }
+    if (GridCmdOptionExists(argv, argv + argc, "--rep"))
+    {
+        arg  = GridCmdOptionPayload(argv, argv + argc, "--rep");
+        nRep = std::stoi(arg);
+    }
+
+    GridCartesian                *grid = SpaceTimeGrid::makeFourDimGrid(
+        GridDefaultLatt(), GridDefaultSimd(Nd, vComplex::Nsimd()), GridDefaultMpi());
+    GridParallelRNG              rng(grid);
+    std::vector<FermionField>    left(nVec, grid), right(nVec, grid);
+    std::vector<Gamma::Algebra>  gamma = {Gamma::Algebra::Gamma5};
+    unsigned int                 nt = grid->GlobalDimensions()[Nd - 1];
+    unsigned int                 crossover = 0;
+
+    LOG(Message) << "*** A2A MESON FIELD MOMENTUM PROJECTION BENCHMARK ***" << std::endl;
+    LOG(Message) << "lattice " << grid->GlobalDimensions() << ", " << nVec
+                 << "x" << nVec << " vector block, " << nRep << " repetition(s)"
+                 << std::endl;
+#ifndef HAVE_FFTW
+    LOG(Message) << "Grid compiled without FFTW, no FFT kernel available" << std::endl;
+    Grid_finalize();
+
+    return EXIT_SUCCESS;
+#endif
+    rng.SeedFixedIntegers({1, 2, 3, 4});
+    for (unsigned int i = 0; i < nVec; ++i)
+    {
+        gaussian(rng, left[i]);
+        gaussian(rng, right[i]);
+    }
+    LOG(Message) << std::setw(8) << "#mom" << std::setw(16) << "phase (s)"
+                 << std::setw(16) << "FFT (s)" << std::setw(12) << "speedup"
+                 << std::setw(16) << "max |diff|" << std::endl;
+    for (unsigned int nMom = 1; nMom <= maxMom; nMom *= 2)
+    {
+        auto                             mom = makeMomenta(nMom, Nd - 1);
+        MomentumPhaseSet<LatticeComplex> phase(grid, mom);
+        Vector<Complex>                  bufPh(nMom*gamma.size()*nt*nVec*nVec),
+                                         bufFft(nMom*gamma.size()*nt*nVec*nVec);
+        A2AMatrixSet<Complex>            mPh(bufPh.data(), nMom, gamma.size(), nt, nVec, nVec),
+                                         mFft(bufFft.data(), nMom, gamma.size(), nt, nVec, nVec);
+        double                           tPh = 0., tFft = 0., t, tk, diff = 0.;
+
+        PhaseKernel phKernel(gamma, phase.get(), grid);
+        FftKernel   fftKernel(gamma, mom, grid);
+
+        // warm-up, the FFT plans and site lists are made there
+        phKernel(mPh, left.data(), right.data(), Nd - 1, tk);
+        fftKernel(mFft, left.data(), right.data(), Nd - 1, tk);
+        for (unsigned int r = 0; r < nRep; ++r)
+        {
+            t     = -usecond();
+            phKernel(mPh, left.data(), right.data(), Nd - 1, tk);
+            t    += usecond();
+            tPh  += t;
+            t     = -usecond();
+            fftKernel(mFft, left.data(), right.data(), Nd - 1, tk);
+            t    += usecond();
+            tFft += t;
+        }
+        tPh  /= nRep;
+        tFft /= nRep;
+        for (unsigned int k = 0; k < bufPh.size(); ++k)
+        {
+            diff = std::max(diff, static_cast<double>(std::abs(bufPh[k] - bufFft[k])));
+        }
+        if ((crossover == 0) and (tFft < tPh))
+        {
+            crossover = nMom;
+        }
+        LOG(Message) << std::setw(8) << nMom << std::setw(16) << tPh/1.0e6
+                     << std::setw(16) << tFft/1.0e6 << std::setw(12) << tPh/tFft
+                     << std::setw(16) << diff << std::endl;
+    }
+    if (crossover > 0)
+    {
+        LOG(Message) << "FFT kernel faster from " << crossover << " momenta"
+                     << " (HADRONS_A2AM_FFT_CROSSOVER is "
+                     << HADRONS_A2AM_FFT_CROSSOVER << ")" << std::endl;
+    }
+    else
+    {
+        LOG(Message) << "FFT kernel slower up to " << maxMom << " momenta"
+                     << std::endl;
+    }
+    Grid_finalize();
+
+    return EXIT_SUCCESS;
+}